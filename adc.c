@@ -2,10 +2,12 @@
 
 #include <stdlib.h>
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include <util/atomic.h>
 
 #include "custom_math.h"
 #include "eeprom.h"
+#include "frame_timing.h"
 #include "main.h"
 #include "mcu_pins.h"
 
@@ -15,6 +17,17 @@
 
 #define ADC_MIDDLE_VALUE (1023 / 2)
 
+_Static_assert(ADC_FRAME_CYCLES == F_CPU / FRAME_TIMING_CYCLES_PER_TICK / 128
+  * FRAME_TIMING_CYCLES_PER_TICK, "ADC_FRAME_CYCLES does not match TIMER3");
+_Static_assert(ADC_TIMER1_PERIOD == F_CPU / 1000,
+  "ADC_TIMER1_PERIOD does not match the TIMER1 period");
+#ifdef ADC_PHASE_LOCKED
+// A conversion started by a trigger takes 13.5 ADC clocks of 128 CPU cycles.
+// One started late (see adc.S) must also leave time to catch up.
+_Static_assert(ADC_TRIGGER_PERIOD > 14 * 128 + ADC_TRIGGER_MIN_LEAD,
+  "ADC_TRIGGER_PERIOD is too short for a conversion");
+#endif
+
 // ADC sample indices
 enum ADCSensorIndex {
   ADC_ACCEL_X  = 0,
@@ -27,9 +40,90 @@ enum ADCSensorIndex {
   ADC_ACCEL_Z  = 7,
 };
 
+// The ADMUX channel of a sensor. The conversion pipeline (see adc.S) records
+// each sample two slots after its channel was selected, so the sensor indices
+// are 2 more than the channels.
+#define ADC_MUX(sensor) (((sensor) - 2) & (ADC_N_CHANNELS - 1))
+
+// The number of times that each sensor appears in adc_schedule_. A sensor with
+// an even share of the slots would appear EVEN_SHARE times. The gyros, which
+// the rate loop reads, take twice their share. The accelerometers give up half
+// of theirs, the pressure sensor 5/8 and the battery voltage 7/8 to make room.
+#define EVEN_SHARE (ADC_SCHEDULE_LENGTH / ADC_N_CHANNELS)  // 8
+#define GYRO_SCHEDULE_COUNT (16)
+#define ACCEL_SCHEDULE_COUNT (4)
+#define PRESSURE_SCHEDULE_COUNT (3)
+#define BATTERY_SCHEDULE_COUNT (1)
+
+static const uint8_t kScheduleCount[ADC_N_CHANNELS] = {
+  [ADC_ACCEL_X] = ACCEL_SCHEDULE_COUNT,
+  [ADC_ACCEL_Y] = ACCEL_SCHEDULE_COUNT,
+  [ADC_GYRO_Z] = GYRO_SCHEDULE_COUNT,
+  [ADC_GYRO_X] = GYRO_SCHEDULE_COUNT,
+  [ADC_GYRO_Y] = GYRO_SCHEDULE_COUNT,
+  [ADC_PRESSURE] = PRESSURE_SCHEDULE_COUNT,
+  [ADC_BATT_V] = BATTERY_SCHEDULE_COUNT,
+  [ADC_ACCEL_Z] = ACCEL_SCHEDULE_COUNT,
+};
+
+// The factor (in Q16) that scales the sum of a sensor that appears "count"
+// times in the schedule to ADC_N_SAMPLES samples, for a count that does not
+// divide EVEN_SHARE (see ScaledSum()).
+#define SCALED_SUM_Q16(count) \
+  ((uint32_t)((EVEN_SHARE * 65536UL + (count) / 2) / (count)))
+
+_Static_assert(3 * GYRO_SCHEDULE_COUNT + 3 * ACCEL_SCHEDULE_COUNT
+  + PRESSURE_SCHEDULE_COUNT + BATTERY_SCHEDULE_COUNT == ADC_SCHEDULE_LENGTH,
+  "The shares do not add up to the schedule length");
+// A scaled sum is at most 1023 * ADC_N_SAMPLES, and the product before the
+// rounding shift must fit in 32 bits.
+_Static_assert(ADC_N_SLOTS / ADC_SCHEDULE_LENGTH * PRESSURE_SCHEDULE_COUNT
+  * 1023UL * SCALED_SUM_Q16(PRESSURE_SCHEDULE_COUNT) < 0xFFFF8000UL,
+  "The scaled pressure sum overflows");
+_Static_assert(ADC_N_SLOTS >= ADC_SCHEDULE_LENGTH,
+  "ADC_N_SAMPLES is too small for the schedule");
+// The largest sum of the sample array must fit in 16 bits.
+_Static_assert(ADC_N_SLOTS / ADC_SCHEDULE_LENGTH * GYRO_SCHEDULE_COUNT * 1023L
+  < 65536L, "The gyro sums overflow");
+
+
 // The following are not declared static so that they will be visible to adc.S.
-volatile uint16_t samples_[ADC_N_SAMPLES][ADC_N_CHANNELS];
+volatile uint16_t samples_[ADC_N_SLOTS];
 volatile uint8_t samples_index_;
+volatile uint16_t sample_sums_[ADC_N_CHANNELS];  // By enum ADCSensorIndex
+#ifdef ADC_PHASE_LOCKED
+volatile uint16_t adc_frame_trigger_;  // OCR1B for the first sample of a frame
+volatile uint16_t adc_trigger_;  // OCR1B for the next sample on the schedule
+#endif
+#ifdef ISR_TIMING
+volatile uint32_t adc_isr_cycles_ = 0;  // Running total of ADC_vect (cycles)
+#endif
+
+// The sensor that is read into each slot of the sample array (see
+// kScheduleCount): the gyros are sampled twice as often as they would be with
+// an even share of the slots, the accelerometers half as often, the pressure
+// sensor 3/8 as often, and the battery voltage 1/8 as often. Each group of 4
+// slots starts with the three gyros, so that their samples are spread evenly
+// over the frame and each step of the rate loop gets 4 fresh samples of each,
+// and the other sensors take the last slot of the groups in turn.
+const uint8_t adc_schedule_[ADC_SCHEDULE_LENGTH] PROGMEM = {
+  ADC_GYRO_X, ADC_GYRO_Y, ADC_GYRO_Z, ADC_PRESSURE,
+  ADC_GYRO_X, ADC_GYRO_Y, ADC_GYRO_Z, ADC_ACCEL_X,
+  ADC_GYRO_X, ADC_GYRO_Y, ADC_GYRO_Z, ADC_ACCEL_Y,
+  ADC_GYRO_X, ADC_GYRO_Y, ADC_GYRO_Z, ADC_ACCEL_Z,
+  ADC_GYRO_X, ADC_GYRO_Y, ADC_GYRO_Z, ADC_ACCEL_X,
+  ADC_GYRO_X, ADC_GYRO_Y, ADC_GYRO_Z, ADC_PRESSURE,
+  ADC_GYRO_X, ADC_GYRO_Y, ADC_GYRO_Z, ADC_ACCEL_Y,
+  ADC_GYRO_X, ADC_GYRO_Y, ADC_GYRO_Z, ADC_ACCEL_Z,
+  ADC_GYRO_X, ADC_GYRO_Y, ADC_GYRO_Z, ADC_ACCEL_X,
+  ADC_GYRO_X, ADC_GYRO_Y, ADC_GYRO_Z, ADC_ACCEL_Y,
+  ADC_GYRO_X, ADC_GYRO_Y, ADC_GYRO_Z, ADC_PRESSURE,
+  ADC_GYRO_X, ADC_GYRO_Y, ADC_GYRO_Z, ADC_ACCEL_Z,
+  ADC_GYRO_X, ADC_GYRO_Y, ADC_GYRO_Z, ADC_ACCEL_X,
+  ADC_GYRO_X, ADC_GYRO_Y, ADC_GYRO_Z, ADC_ACCEL_Y,
+  ADC_GYRO_X, ADC_GYRO_Y, ADC_GYRO_Z, ADC_ACCEL_Z,
+  ADC_GYRO_X, ADC_GYRO_Y, ADC_GYRO_Z, ADC_BATT_V,
+};
 
 static float acceleration_[3], angular_rate_[3];
 static uint16_t biased_pressure_sum_, battery_voltage_;
@@ -40,12 +134,18 @@ static int16_t gyro_offset_[3] = { -ADC_MIDDLE_VALUE * ADC_N_SAMPLES,
 static int8_t gyro_fine_offset_[2];
 
 
+
 // =============================================================================
 // Private function declarations:
 
 static inline uint16_t ADCSample(enum ADCSensorIndex sensor);
 static void CheckOffset(const int16_t offset[3], int16_t acceptable_deviation);
-static inline uint16_t SumRecords(enum ADCSensorIndex sensor);
+#ifdef ADC_PHASE_LOCKED
+static uint16_t NextFrameTrigger(void);
+#endif
+static void ReadSums(uint16_t sums[ADC_N_CHANNELS]);
+static inline uint16_t ScaledSum(const uint16_t sums[ADC_N_CHANNELS],
+  enum ADCSensorIndex sensor);
 
 
 // =============================================================================
@@ -84,18 +184,32 @@ uint16_t Accelerometer(enum BodyAxes axis)
   }
 }
 
+
 // -----------------------------------------------------------------------------
-// Returns the sum of the most recent ADC_N_SAMPLES accelerometer readings.
-// Scale is 5/1024/ADC_N_SAMPLES g/LSB.
+// Returns the sum of the accelerometer readings in the sample array, scaled to
+// ADC_N_SAMPLES readings. Scale is 5/1024/ADC_N_SAMPLES g/LSB.
 int16_t AccelerometerSum(enum BodyAxes axis)
 {
   return accelerometer_sum_[axis];
 }
 
+// -----------------------------------------------------------------------------
+// This function returns the running total (modulo 2^32) of the CPU cycles spent
+// in the ADC interrupt handler (see adc.S), or 0 unless ISR_TIMING is
+// defined. It should be called with interrupts disabled.
+uint32_t ADCInterruptCycles(void)
+{
+#ifdef ISR_TIMING
+  return adc_isr_cycles_;
+#else
+  return 0;
+#endif
+}
+
 // -----------------------------------------------------------------------------
 enum ADCState ADCState(void)
 {
-  if (ADCSRA & _BV(ADSC)) return ADC_ACTIVE;
+  if (ADCSRA & _BV(ADEN)) return ADC_ACTIVE;
   else return ADC_INACTIVE;
 }
 
@@ -120,10 +234,12 @@ uint16_t BatteryVoltage(void)
   return battery_voltage_;
 }
 
+
 // -----------------------------------------------------------------------------
-// Returns the sum of the most recent ADC_N_SAMPLES biased pressure readings.
-// Slope is 1/578/ADC_N_SAMPLES kPa/LSB and bias is determined by a pair of
-// biasing voltages (see the PWM signals in pressure_altitude.c).
+// Returns the sum of the biased pressure readings in the sample array, scaled
+// to ADC_N_SAMPLES readings. Slope is 1/578/ADC_N_SAMPLES kPa/LSB and bias is
+// determined by a pair of biasing voltages (see the PWM signals in
+// pressure_altitude.c).
 uint16_t BiasedPressureSum(void)
 {
   return biased_pressure_sum_;
@@ -156,9 +272,10 @@ uint16_t Gyro(enum BodyAxes axis)
   }
 }
 
+
 // -----------------------------------------------------------------------------
-// Returns the sum of the most recent ADC_N_SAMPLES gyro readings. Scale is
-// 5/6.144/ADC_N_SAMPLES deg/s/LSB.
+// Returns the sum of the gyro readings in the sample array, scaled to
+// ADC_N_SAMPLES readings. Scale is 5/6.144/ADC_N_SAMPLES deg/s/LSB.
 int16_t GyroSum(enum BodyAxes axis)
 {
   return gyro_sum_[axis];
@@ -168,11 +285,41 @@ int16_t GyroSum(enum BodyAxes axis)
 // =============================================================================
 // Public functions:
 
-// This function starts the ADC in free-running mode.
+// This function starts the ADC, free running, or phase locked to the control
+// frame if ADC_PHASE_LOCKED is defined (see ADC_TRIGGER_PERIOD). When phase
+// locked, the first conversion occurs at the start of the next frame, so TIMER1
+// and TIMER3 must already be running (see TimingInit()).
 void ADCOn(void)
 {
+#ifndef ADC_PHASE_LOCKED
+  ADCSRB = 0;  // Free running
+  ADCSRA = (1 << ADEN)  // ADC Enable
+         | (1 << ADSC)  // ADC Start Conversion
+#else
+  // The first conversion after the ADC is enabled takes 25 ADC clocks (3200
+  // cycles), which is longer than ADC_TRIGGER_PERIOD, so do it here.
   ADCSRA = (1 << ADEN)  // ADC Enable
          | (1 << ADSC)  // ADC Start Conversion
+         | (1 << ADPS2)  // ADC Prescaler select bit 2
+         | (1 << ADPS1)  // ADC Prescaler select bit 1
+         | (1 << ADPS0);  // ADC Prescaler select bit 0
+  while (ADCSRA & _BV(ADSC)) continue;
+
+  // The first sample of a frame is recorded at index 0 (see adc.S).
+  samples_index_ = ADC_N_SLOTS - 1;
+  ADMUX = ADC_MUX(pgm_read_byte(&adc_schedule_[0]));
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    adc_frame_trigger_ = NextFrameTrigger();
+    adc_trigger_ = adc_frame_trigger_;
+    OCR1B = adc_frame_trigger_;
+  }
+  TIFR1 = _BV(OCF1B);  // Clear a stale compare match
+  ADCSRB = (1 << ADTS2)  // Auto Trigger Source: TIMER1 Compare Match B
+         | (0 << ADTS1)
+         | (1 << ADTS0);
+  ADCSRA = (1 << ADEN)  // ADC Enable
+#endif
          | (1 << ADATE)  // ADC Auto Trigger Enable
          | (1 << ADIF)  // (Clear the) ADC Interrupt Flag
          | (1 << ADIE)  // ADC Interrupt Enable
@@ -188,6 +335,17 @@ void ADCOff(void)
   ADCSRA = 0;  // Clear the ADC control register.
 }
 
+// -----------------------------------------------------------------------------
+// This function is called from the TIMER3 interrupt at each 128 Hz tick. If
+// ADC_PHASE_LOCKED is defined, it schedules the first conversion of the next
+// frame so that the acquisition stays phase locked to the frame.
+void ADCFrameTick(void)
+{
+#ifdef ADC_PHASE_LOCKED
+  adc_frame_trigger_ = NextFrameTrigger();
+#endif
+}
+
 // -----------------------------------------------------------------------------
 // This function loads the accelerometer offsets from EEPROM so that
 // accelerometers don't have to be re-calibrated every flight.
@@ -208,31 +366,38 @@ void LoadAccelerometerOffsets(void)
 //increases sanity of pre-initialized control computations.
 void LoadGyroOffsets(void)
 {
-  eeprom_read_block((void*)gyro_offset_, (const void*)&eeprom.gyro_offset[0],
-    sizeof(gyro_offset_));
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    eeprom_read_block((void*)gyro_offset_,
+      (const void*)&eeprom.gyro_offset[0], sizeof(gyro_offset_));
+  }
 }
 
 // -----------------------------------------------------------------------------
 // This function sums several sensor readings (each reading the sample array) in
-// order to increase fidelity.
+// order to increase fidelity. The sums of all of the sensors are taken from
+// the same set of samples.
 void ProcessSensorReadings(void)
 {
+  uint16_t sums[ADC_N_CHANNELS];
+  ReadSums(sums);
+
   // Raw accelerometer reading minus bias.
   if (BoardVersion() > 22)
   {
-    accelerometer_sum_[X_BODY_AXIS] = -SumRecords(ADC_ACCEL_X)
+    accelerometer_sum_[X_BODY_AXIS] = -ScaledSum(sums, ADC_ACCEL_X)
       - acc_offset_[X_BODY_AXIS];
-    accelerometer_sum_[Y_BODY_AXIS] = -SumRecords(ADC_ACCEL_Y)
+    accelerometer_sum_[Y_BODY_AXIS] = -ScaledSum(sums, ADC_ACCEL_Y)
       - acc_offset_[Y_BODY_AXIS];
   }
   else
   {
-    accelerometer_sum_[X_BODY_AXIS] = -SumRecords(ADC_ACCEL_Y)
+    accelerometer_sum_[X_BODY_AXIS] = -ScaledSum(sums, ADC_ACCEL_Y)
       - acc_offset_[X_BODY_AXIS];
-    accelerometer_sum_[Y_BODY_AXIS] = -SumRecords(ADC_ACCEL_X)
+    accelerometer_sum_[Y_BODY_AXIS] = -ScaledSum(sums, ADC_ACCEL_X)
       - acc_offset_[Y_BODY_AXIS];
   }
-  accelerometer_sum_[Z_BODY_AXIS] = -SumRecords(ADC_ACCEL_Z)
+  accelerometer_sum_[Z_BODY_AXIS] = -ScaledSum(sums, ADC_ACCEL_Z)
     - acc_offset_[Z_BODY_AXIS];
 
   // Convert raw accelerometer to g's.
@@ -252,31 +417,42 @@ void ProcessSensorReadings(void)
   }
 
   // Raw gyro reading minus bias.
-  gyro_sum_[X_BODY_AXIS] = -SumRecords(ADC_GYRO_X) - gyro_offset_[X_BODY_AXIS];
-  gyro_sum_[Y_BODY_AXIS] = -SumRecords(ADC_GYRO_Y) - gyro_offset_[Y_BODY_AXIS];
-  gyro_sum_[Z_BODY_AXIS] = SumRecords(ADC_GYRO_Z) - gyro_offset_[Z_BODY_AXIS];
+  gyro_sum_[X_BODY_AXIS] = -ScaledSum(sums, ADC_GYRO_X)
+    - gyro_offset_[X_BODY_AXIS];
+  gyro_sum_[Y_BODY_AXIS] = -ScaledSum(sums, ADC_GYRO_Y)
+    - gyro_offset_[Y_BODY_AXIS];
+  gyro_sum_[Z_BODY_AXIS] = ScaledSum(sums, ADC_GYRO_Z)
+    - gyro_offset_[Z_BODY_AXIS];
 
   // On average, the X and Y gyros should read zero. Constantly adjust the
-  // offset in that direction.
-  if (gyro_sum_[X_BODY_AXIS] > 0 && --gyro_fine_offset_[X_BODY_AXIS] == -127)
-  {
-    gyro_offset_[X_BODY_AXIS]--;
-    gyro_fine_offset_[X_BODY_AXIS] = 0;
-  }
-  if (gyro_sum_[X_BODY_AXIS] > 0 && ++gyro_fine_offset_[X_BODY_AXIS] == 127)
-  {
-    gyro_offset_[X_BODY_AXIS]++;
-    gyro_fine_offset_[X_BODY_AXIS] = 0;
-  }
-  if (gyro_sum_[Y_BODY_AXIS] > 0 && --gyro_fine_offset_[Y_BODY_AXIS] == -127)
-  {
-    gyro_offset_[Y_BODY_AXIS]--;
-    gyro_fine_offset_[Y_BODY_AXIS] = 0;
-  }
-  if (gyro_sum_[Y_BODY_AXIS] > 0 && ++gyro_fine_offset_[Y_BODY_AXIS] == 127)
+  // offset in that direction. The offsets are also read by the rate loop (see
+  // ReadAngularRate()), which may interrupt this function.
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
   {
-    gyro_offset_[Y_BODY_AXIS]++;
-    gyro_fine_offset_[Y_BODY_AXIS] = 0;
+    if (gyro_sum_[X_BODY_AXIS] > 0
+      && --gyro_fine_offset_[X_BODY_AXIS] == -127)
+    {
+      gyro_offset_[X_BODY_AXIS]--;
+      gyro_fine_offset_[X_BODY_AXIS] = 0;
+    }
+    if (gyro_sum_[X_BODY_AXIS] > 0
+      && ++gyro_fine_offset_[X_BODY_AXIS] == 127)
+    {
+      gyro_offset_[X_BODY_AXIS]++;
+      gyro_fine_offset_[X_BODY_AXIS] = 0;
+    }
+    if (gyro_sum_[Y_BODY_AXIS] > 0
+      && --gyro_fine_offset_[Y_BODY_AXIS] == -127)
+    {
+      gyro_offset_[Y_BODY_AXIS]--;
+      gyro_fine_offset_[Y_BODY_AXIS] = 0;
+    }
+    if (gyro_sum_[Y_BODY_AXIS] > 0
+      && ++gyro_fine_offset_[Y_BODY_AXIS] == 127)
+    {
+      gyro_offset_[Y_BODY_AXIS]++;
+      gyro_fine_offset_[Y_BODY_AXIS] = 0;
+    }
   }
 
   // Convert raw gyro reading to rad/s.
@@ -288,20 +464,44 @@ void ProcessSensorReadings(void)
     / ADC_N_SAMPLES;
 
   // Raw pressure reading.
-  biased_pressure_sum_ = SumRecords(ADC_PRESSURE);
+  biased_pressure_sum_ = ScaledSum(sums, ADC_PRESSURE);
 
   // The ADC records voltage in 31 steps per Volt. The following converts to the
   // desired 1 step per 0.1 V. The following gyration avoids overflow.
-  battery_voltage_ = U16RoundRShiftU16(82 * U16RoundRShiftU16(SumRecords(
+  battery_voltage_ = U16RoundRShiftU16(82 * U16RoundRShiftU16(ScaledSum(sums,
     ADC_BATT_V), ADC_N_SAMPLES_POW_OF_2 + 1) , 7);  //  1/10 Volts
+
+}
+
+// -----------------------------------------------------------------------------
+// This function sums the most recent gyro samples and converts them to
+// body-axis angular rates in rad/s, as ProcessSensorReadings() does, but
+// without keeping the result or adjusting the offsets. It is meant for the rate
+// loop (see RateControl()), which runs in an interrupt handler.
+void ReadAngularRate(float angular_rate[3])
+{
+  uint16_t sums[ADC_N_CHANNELS];
+  ReadSums(sums);
+  const int16_t gyro_sum[3] = {
+    -ScaledSum(sums, ADC_GYRO_X) - gyro_offset_[X_BODY_AXIS],
+    -ScaledSum(sums, ADC_GYRO_Y) - gyro_offset_[Y_BODY_AXIS],
+    ScaledSum(sums, ADC_GYRO_Z) - gyro_offset_[Z_BODY_AXIS],
+  };
+  angular_rate[X_BODY_AXIS] = (float)gyro_sum[X_BODY_AXIS] / GYRO_SCALE
+    / ADC_N_SAMPLES;
+  angular_rate[Y_BODY_AXIS] = (float)gyro_sum[Y_BODY_AXIS] / GYRO_SCALE
+    / ADC_N_SAMPLES;
+  angular_rate[Z_BODY_AXIS] = (float)gyro_sum[Z_BODY_AXIS] / GYRO_SCALE
+    / ADC_N_SAMPLES;
 }
 
+
 // -----------------------------------------------------------------------------
 // This function delays program execution until the ADC sample array has been
 // fully refreshed.
 void WaitOneADCCycle(void)
 {
-  if (!(ADCSRA & _BV(ADSC))) return;  // ADC not running.
+  if (!(ADCSRA & _BV(ADEN))) return;  // ADC not running.
   uint8_t samples_index_tmp = samples_index_;
   while (samples_index_tmp == samples_index_) continue;
   while (samples_index_tmp != samples_index_) continue;
@@ -309,7 +509,7 @@ void WaitOneADCCycle(void)
 
 // -----------------------------------------------------------------------------
 // This function assumes that the vehicle is motionless (on the ground). It
-// finds the average accelerometer readings over the period of 1 second
+// finds the average accelerometer readings over the period of 2 seconds
 // (approximately) and considers the results to be the zero values of the
 // accelerometers.
 void ZeroAccelerometers(void)
@@ -324,7 +524,7 @@ void ZeroAccelerometers(void)
   acc_offset_[Y_BODY_AXIS] = 0;
   acc_offset_[Z_BODY_AXIS] = 0;
 
-  // Sum samples over about 1 second (2048 samples).
+  // Sum samples over about 2 seconds (2048 samples).
   const uint8_t kNSamplesPowOf2 = 11 - ADC_N_SAMPLES_POW_OF_2;
   const int32_t kNSamples = 1 << kNSamplesPowOf2;
   for (uint16_t i = 0; i < kNSamples; i++)
@@ -356,13 +556,13 @@ void ZeroAccelerometers(void)
 
   // Save the values in the EEPROM.
   // TODO: Make this contingent on success of CheckOffset
-  eeprom_update_block((const void*)acc_offset_, (void*)&eeprom.acc_offset[0],
+  DeferredEEPROMUpdate((void*)&eeprom.acc_offset[0], (const void*)acc_offset_,
     sizeof(acc_offset_));
 }
 
 // -----------------------------------------------------------------------------
 // This function assumes that the vehicle is motionless on the ground. It finds
-// the average gyro readings over the period of 1 second (approximately) and
+// the average gyro readings over the period of 2 seconds (approximately) and
 // considers the results to be the zero values of the gyros.
 void ZeroGyros(void)
 {
@@ -372,11 +572,14 @@ void ZeroGyros(void)
   // if (MotorsOn()) return 1;
 
   // Clear offsets.
-  gyro_offset_[X_BODY_AXIS] = 0;
-  gyro_offset_[Y_BODY_AXIS] = 0;
-  gyro_offset_[Z_BODY_AXIS] = 0;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    gyro_offset_[X_BODY_AXIS] = 0;
+    gyro_offset_[Y_BODY_AXIS] = 0;
+    gyro_offset_[Z_BODY_AXIS] = 0;
+  }
 
-  // Sum samples over about 1 second (2000 samples).
+  // Sum samples over about 2 seconds (2048 samples).
   const uint8_t kNSamplesPowOf2 = 11 - ADC_N_SAMPLES_POW_OF_2;
   const int32_t kNSamples = 1 << kNSamplesPowOf2;
   for (uint16_t i = 0; i < kNSamples; i++)
@@ -389,12 +592,15 @@ void ZeroGyros(void)
   }
 
   // Average the results and set as the offset.
-  gyro_offset_[X_BODY_AXIS] = S16RoundRShiftS32(sample_sum[X_BODY_AXIS],
-    kNSamplesPowOf2);
-  gyro_offset_[Y_BODY_AXIS] = S16RoundRShiftS32(sample_sum[Y_BODY_AXIS],
-    kNSamplesPowOf2);
-  gyro_offset_[Z_BODY_AXIS] = S16RoundRShiftS32(sample_sum[Z_BODY_AXIS],
-    kNSamplesPowOf2);
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    gyro_offset_[X_BODY_AXIS] = S16RoundRShiftS32(sample_sum[X_BODY_AXIS],
+      kNSamplesPowOf2);
+    gyro_offset_[Y_BODY_AXIS] = S16RoundRShiftS32(sample_sum[Y_BODY_AXIS],
+      kNSamplesPowOf2);
+    gyro_offset_[Z_BODY_AXIS] = S16RoundRShiftS32(sample_sum[Z_BODY_AXIS],
+      kNSamplesPowOf2);
+  }
 
   // TODO: Change these limits to something more reasonable.
   // Check that the zero values are within an acceptable range. The acceptable
@@ -404,18 +610,30 @@ void ZeroGyros(void)
 
   // Save the values in the EEPROM.
   // TODO: Make this contingent on success of CheckOffset
-  eeprom_update_block((const void*)gyro_offset_, (void*)&eeprom.gyro_offset[0],
-    sizeof(gyro_offset_));
+  DeferredEEPROMUpdate((void*)&eeprom.gyro_offset[0],
+    (const void*)gyro_offset_, sizeof(gyro_offset_));
 }
 
 
 // =============================================================================
 // Private functions:
 
-// This function returns the most recent ADC sample for a particular sensor.
+// This function returns the most recent ADC sample for a particular sensor. The
+// sample is read again if the ADC interrupt handler records another one in the
+// meantime (see ReadSums()).
 static inline uint16_t ADCSample(enum ADCSensorIndex sensor)
 {
-  return samples_[(samples_index_ - sensor) / ADC_N_CHANNELS][sensor];
+  uint8_t index;
+  uint16_t sample;
+  do
+  {
+    index = samples_index_;
+    uint8_t i = index;
+    while (pgm_read_byte(&adc_schedule_[i & (ADC_SCHEDULE_LENGTH - 1)])
+      != sensor) i--;
+    sample = samples_[i & (ADC_N_SLOTS - 1)];
+  } while (index != samples_index_);
+  return sample;
 }
 
 // -----------------------------------------------------------------------------
@@ -432,15 +650,53 @@ static void CheckOffset(const int16_t offset[3], int16_t acceptable_deviation)
   }
 }
 
+
+#ifdef ADC_PHASE_LOCKED
+// -----------------------------------------------------------------------------
+// This function returns the value of TIMER1 at the start of the next frame
+// (the next time that TIMER3 reaches ICR3). It should be called with interrupts
+// disabled.
+static uint16_t NextFrameTrigger(void)
+{
+  const uint16_t timer1 = TCNT1;
+  // TIMER3 ticks until the next frame, reduced by whole TIMER1 periods.
+  uint16_t ticks = ICR3 + 1 - TCNT3;
+  while (ticks >= ADC_TIMER1_PERIOD / FRAME_TIMING_CYCLES_PER_TICK)
+    ticks -= ADC_TIMER1_PERIOD / FRAME_TIMING_CYCLES_PER_TICK;
+  uint16_t trigger = timer1 + ticks * FRAME_TIMING_CYCLES_PER_TICK;
+  if (trigger >= ADC_TIMER1_PERIOD) trigger -= ADC_TIMER1_PERIOD;
+  return trigger;
+}
+#endif  // ADC_PHASE_LOCKED
+
 // -----------------------------------------------------------------------------
-// This function sums those samples in the sample array for a particular sensor.
-static inline uint16_t SumRecords(enum ADCSensorIndex sensor)
+// This function reads the sums of the samples of all of the sensors, which the
+// ADC interrupt handler keeps up to date (see adc.S), into "sums" (by enum
+// ADCSensorIndex). The sums are read with interrupts enabled, and read again if
+// the interrupt handler has recorded a sample in the meantime (samples_index_
+// has moved), so that they all come from the same set of samples. Samples are
+// recorded at least 1664 CPU cycles apart, so the reads rarely need a second
+// try. The index only comes back to the same value after ADC_N_SLOTS samples
+// (several ms), which is much longer than anything that interrupts the reads.
+static void ReadSums(uint16_t sums[ADC_N_CHANNELS])
 {
-  uint16_t result = 0;
-  ATOMIC_BLOCK(ATOMIC_FORCEON)
+  uint8_t index;
+  do
   {
-    for (uint8_t i = 0; i < ADC_N_SAMPLES; i++)
-      result += samples_[i][sensor];
-  }
-  return result;
+    index = samples_index_;
+    for (uint8_t i = 0; i < ADC_N_CHANNELS; i++) sums[i] = sample_sums_[i];
+  } while (index != samples_index_);
+}
+
+// -----------------------------------------------------------------------------
+// This function returns the sum of the samples in the sample array for a
+// particular sensor from "sums" (see ReadSums()), scaled to ADC_N_SAMPLES
+// samples.
+static inline uint16_t ScaledSum(const uint16_t sums[ADC_N_CHANNELS],
+  enum ADCSensorIndex sensor)
+{
+  const uint8_t kCount = kScheduleCount[sensor];
+  if (EVEN_SHARE % kCount)  // Rounded
+    return ((uint32_t)sums[sensor] * SCALED_SUM_Q16(kCount) + 0x8000) >> 16;
+  return sums[sensor] * (EVEN_SHARE / kCount);
 }
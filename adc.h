@@ -2,15 +2,48 @@
 #define ADC_H_
 
 
-// ADC_N_SAMPLES defines the size of the ADC sample array. It is the number of
-// samples that are combined to report a sensor reading. Increasing this number
-// will improve fidelity and noise rejection, but will also increase latency.
-// Due to the structure of the ADC interrupt handler this number must be a power
-// of 2 between 1 and 32 (inclusively). The ADC sample array will be fully
-// refreshed at 20,000,000 / 128 / 13 / (ADC_N_CHANNELS * ADC_N_SAMPLES) Hz.
+// ADC_N_SAMPLES defines the size of the ADC sample array, which holds
+// ADC_N_SAMPLES samples per channel on average (ADC_N_SLOTS in all). The
+// sensor that is sampled in each slot is given by a schedule (see
+// adc_schedule_ in adc.c), so that the gyros can be sampled more often than the
+// battery voltage, for example. The sums of the samples of each sensor are
+// reported as if they were sums of ADC_N_SAMPLES samples, whatever the share of
+// the sensor. Increasing this number will improve fidelity and noise rejection,
+// but will also increase latency. Due to the structure of the ADC interrupt
+// handler this number must be a power of 2: from 8 to 32 (the schedule below
+// needs at least 8, and the index has 8 bits), or 8 if ADC_PHASE_LOCKED is
+// defined, because a conversion must then fit in each of the ADC_N_SLOTS
+// trigger periods of a frame. The ADC sample array will be fully refreshed at
+// 20,000,000 / 128 / 13 / ADC_N_SLOTS Hz (or once per 128 Hz frame if
+// ADC_PHASE_LOCKED is defined).
 #define ADC_N_SAMPLES_POW_OF_2 (3)  // 2^3 = 8
 #define ADC_N_SAMPLES (1 << ADC_N_SAMPLES_POW_OF_2)  // 8
 #define ADC_N_CHANNELS (8)  // Do not modify!!!
+#define ADC_N_SLOTS (ADC_N_SAMPLES * ADC_N_CHANNELS)
+
+// The schedule covers ADC_SCHEDULE_LENGTH slots and repeats over the sample
+// array, so ADC_N_SAMPLES must be at least 8.
+#define ADC_SCHEDULE_LENGTH_POW_OF_2 (6)
+#define ADC_SCHEDULE_LENGTH (1 << ADC_SCHEDULE_LENGTH_POW_OF_2)  // 64
+
+// The ADC free runs by default. If ADC_PHASE_LOCKED is defined, the ADC is
+// instead phase locked to the control frame: each conversion is started by a TIMER1 compare match (OCR1B) that is
+// moved on by ADC_TRIGGER_PERIOD CPU cycles each time, so that the sample array
+// is refreshed once per frame, and the sequence restarts at the start of each
+// frame (see ADCFrameTick()). A set of samples then ends just before each frame
+// and each step of the rate loop starts. If the ADC interrupt is held off past
+// the time of the next conversion, the handler starts it ADC_TRIGGER_MIN_LEAD
+// cycles later instead, and the following conversions catch up with the
+// schedule. Moving the trigger makes each interrupt longer, but the interrupts
+// are less frequent (8 kHz instead of 12 kHz). See adc.S for the runtime of the
+// handler, which the load meter also reports if ISR_TIMING is defined (see
+// ADCInterruptCycles()). The phase-locked acquisition has not yet been run on
+// simavr or on a board, so it stays opt-in until it has been.
+#define ADC_FRAME_CYCLES (156248)  // (ICR3 + 1) * 8 (see TimingInit())
+#define ADC_TIMER1_PERIOD (20000)  // CPU cycles (see TimingInit())
+#define ADC_TRIGGER_PERIOD (ADC_FRAME_CYCLES / ADC_N_SLOTS)  // CPU cycles
+// More than the cycles from reading TCNT1 to setting OCR1B in adc.S.
+#define ADC_TRIGGER_MIN_LEAD (48)  // CPU cycles (at most 63 for adiw)
 
 #ifndef __ASSEMBLER__
 
@@ -25,6 +58,14 @@
 #define ACCELEROMETER_2_2_SCALE (1024 / 6)  // LSB / g
 #define GYRO_SCALE (6.144 * 180 / M_PI / 5)  // LSB / (rad/s)
 
+// The reciprocal of "scale" times ADC_N_SAMPLES with 24 fractional bits, which
+// converts a sum of the sample array (such as AccelerometerSum()) to Q16 units
+// of g or rad/s with S16ScaleToQ16() (see custom_math.h). The firmware converts
+// the readings with float divisions, and "make bench" times both ways (as
+// SensorSumToFloat and SensorSumToQ16), so that a switch can be measured first.
+#define ADC_SUM_RECIPROCAL_Q24(scale) \
+  ((uint16_t)(16777216.0 / ((scale) * ADC_N_SAMPLES) + 0.5))
+
 enum ADCState {
   ADC_INACTIVE = 0,
   ADC_ACTIVE = 1,
@@ -45,11 +86,20 @@ const float * AccelerationVector(void);
 // Returns the most recent accelerometer reading. Scale is 5/1024 g/LSB.
 uint16_t Accelerometer(enum BodyAxes axis);
 
+
 // -----------------------------------------------------------------------------
-// Returns the sum of the most recent ADC_N_SAMPLES accelerometer readings.
-// Scale is 5/1024/ADC_N_SAMPLES g/LSB.
+// Returns the sum of the accelerometer readings in the sample array, scaled to
+// ADC_N_SAMPLES readings. Scale is 5/1024/ADC_N_SAMPLES g/LSB.
 int16_t AccelerometerSum(enum BodyAxes axis);
 
+// -----------------------------------------------------------------------------
+// Running total (modulo 2^32) of the CPU cycles spent in the ADC interrupt
+// handler, less the interrupt response and the register saves and restores.
+// The handler only keeps this total if ISR_TIMING is defined, which costs
+// it 41 cycles per sample (see adc.S). Otherwise this is 0. It should be read
+// with interrupts disabled.
+uint32_t ADCInterruptCycles(void);
+
 // -----------------------------------------------------------------------------
 enum ADCState ADCState(void);
 
@@ -65,10 +115,12 @@ const float * AngularRateVector(void);
 // Latest measurement of battery voltage in 1/10 Volts.
 uint16_t BatteryVoltage(void);
 
+
 // -----------------------------------------------------------------------------
-// Returns the sum of the most recent ADC_N_SAMPLES biased pressure readings.
-// Slope is 1/578/ADC_N_SAMPLES kPa/LSB and bias is determined by a pair of
-// biasing voltages (see the PWM signals in pressure_altitude.c).
+// Returns the sum of the biased pressure readings in the sample array, scaled
+// to ADC_N_SAMPLES readings. Slope is 1/578/ADC_N_SAMPLES kPa/LSB and bias is
+// determined by a pair of biasing voltages (see the PWM signals in
+// pressure_altitude.c).
 uint16_t BiasedPressureSum(void);
 
 // -----------------------------------------------------------------------------
@@ -81,22 +133,32 @@ uint16_t BiasedPressureSensor(void);
 // Returns the most recent gyro reading. Scale is 5/6.144 deg/s/LSB.
 uint16_t Gyro(enum BodyAxes axis);
 
+
 // -----------------------------------------------------------------------------
-// Returns the sum of the most recent ADC_N_SAMPLES gyro readings. Scale is
-// 5/6.144/ADC_N_SAMPLES deg/s/LSB.
+// Returns the sum of the gyro readings in the sample array, scaled to
+// ADC_N_SAMPLES readings. Scale is 5/6.144/ADC_N_SAMPLES deg/s/LSB.
 int16_t GyroSum(enum BodyAxes axis);
 
 
 // =============================================================================
 // Public functions:
 
-// This function starts the ADC in free-running mode.
+// This function starts the ADC, free running, or phase locked to the control
+// frame if ADC_PHASE_LOCKED is defined (see ADC_TRIGGER_PERIOD). When phase
+// locked, the first conversion occurs at the start of the next frame, so TIMER1
+// and TIMER3 must already be running (see TimingInit()).
 void ADCOn(void);
 
 // -----------------------------------------------------------------------------
 // This function immediately kills the ADC.
 void ADCOff(void);
 
+// -----------------------------------------------------------------------------
+// This function is called from the TIMER3 interrupt at each 128 Hz tick. If
+// ADC_PHASE_LOCKED is defined, it schedules the first conversion of the next
+// frame so that the acquisition stays phase locked to the frame.
+void ADCFrameTick(void);
+
 // -----------------------------------------------------------------------------
 // This function loads the accelerometer offsets from EEPROM so that
 // accelerometers don't have to be re-calibrated every flight.
@@ -109,9 +171,17 @@ void LoadGyroOffsets(void);
 
 // -----------------------------------------------------------------------------
 // This function sums several sensor readings (each reading the sample array) in
-// order to increase fidelity.
+// order to increase fidelity. The sums of all of the sensors are taken from
+// the same set of samples.
 void ProcessSensorReadings(void);
 
+// -----------------------------------------------------------------------------
+// This function sums the most recent gyro samples and converts them to
+// body-axis angular rates in rad/s without keeping the result or adjusting the
+// offsets. It may be called from an interrupt handler.
+void ReadAngularRate(float angular_rate[3]);
+
+
 // -----------------------------------------------------------------------------
 // This function delays program execution until the ADC sample array has been
 // fully refreshed at least once.
@@ -119,14 +189,14 @@ void WaitOneADCCycle(void);
 
 // -----------------------------------------------------------------------------
 // This function assumes that the vehicle is motionless (on the ground). It
-// finds the average accelerometer readings over the period of 1 second
+// finds the average accelerometer readings over the period of 2 seconds
 // (approximately) and considers the results to be the zero values of the
 // accelerometers.
 void ZeroAccelerometers(void);
 
 // -----------------------------------------------------------------------------
 // This function assumes that the vehicle is motionless on the ground. It finds
-// the average gyro readings over the period of 1 second (approximately) and
+// the average gyro readings over the period of 2 seconds (approximately) and
 // considers the results to be the zero values of the gyros.
 void ZeroGyros(void);
 
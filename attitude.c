@@ -14,36 +14,47 @@
 
 #define ACCELEROMETER_CORRECTION_GAIN (0.001)
 
-static float quat_[4] = { 1.0, 0.0, 0.0, 0.0 }, g_b_[3] = { 0.0, 0.0, 1.0 };
-static float heading_angle_ = 0.0;
-static uint8_t reset_attitude_ = 0;
+static struct AttitudeContext attitude_ = {
+  .quat = { 1.0, 0.0, 0.0, 0.0 },
+  .g_b = { 0.0, 0.0, 1.0 },
+  .heading_angle = 0.0,
+  .reset_attitude = 0,
+};
 
 
 // =============================================================================
 // Private function declarations:
 
-static float * CorrectQuaternionWithAccelerometer(float quat[4]);
-static void HandleAttitudeReset(void);
+static float * CorrectQuaternionWithAccelerometer(const float g_b[3],
+  const float acceleration[3], float quat[4]);
+static void HandleAttitudeReset(struct AttitudeContext * c,
+  const float acceleration[3]);
 
 
 // =============================================================================
 // Accessors:
 
+struct AttitudeContext * DefaultAttitudeContext(void)
+{
+  return &attitude_;
+}
+
+// -----------------------------------------------------------------------------
 const float * GravityInBodyVector(void)
 {
-  return g_b_;
+  return attitude_.g_b;
 }
 
 // -----------------------------------------------------------------------------
 float HeadingAngle(void)
 {
-  return heading_angle_;
+  return attitude_.heading_angle;
 }
 
 // -----------------------------------------------------------------------------
 const float * Quat(void)
 {
-  return quat_;
+  return attitude_.quat;
 }
 
 
@@ -52,24 +63,34 @@ const float * Quat(void)
 
 void UpdateAttitude(void)
 {
-  if (!reset_attitude_)
+  UpdateAttitudeContext(&attitude_, AngularRateVector(), AccelerationVector());
+}
+
+// -----------------------------------------------------------------------------
+// This function advances the attitude estimate in "c" by one time step using
+// the given gyro (rad/s) and accelerometer (g) readings.
+void UpdateAttitudeContext(struct AttitudeContext * c,
+  const float angular_rate[3], const float acceleration[3])
+{
+  if (!c->reset_attitude)
   {
-    UpdateQuaternion(quat_, AngularRateVector(), DT);
-    UpdateGravityInBody(quat_, g_b_);
-    CorrectQuaternionWithAccelerometer(quat_);
-    if (NavStatus() & NAV_STATUS_BIT_HEADING_DATA_OK) CorrectHeading();
-    QuaternionNormalizingFilter(quat_);
+    UpdateQuaternion(c->quat, angular_rate, DT);
+    UpdateGravityInBody(c->quat, c->g_b);
+    CorrectQuaternionWithAccelerometer(c->g_b, acceleration, c->quat);
+    if (NavStatus() & NAV_STATUS_BIT_HEADING_DATA_OK) CorrectHeading(c->quat);
+    QuaternionNormalizingFilter(c->quat);
   }
   else
   {
-    HandleAttitudeReset();
+    HandleAttitudeReset(c, acceleration);
   }
-  UpdateGravityInBody(quat_, g_b_);
-  heading_angle_ = HeadingFromQuaternion(quat_);
+
+  UpdateGravityInBody(c->quat, c->g_b);
+  c->heading_angle = HeadingFromQuaternion(c->quat);
 }
 
 // -----------------------------------------------------------------------------
-void CorrectHeading(void)
+void CorrectHeading(float quat[4])
 {
   // TODO: Check for valid data and ensure only small corrections.
   float hc0 = HeadingCorrection0();
@@ -85,18 +106,34 @@ void CorrectHeading(void)
   }
 
   float temp;
-  temp = quat_[0];
-  quat_[0] = hc0 * quat_[0] - hcz * quat_[3];
-  quat_[3] = hc0 * quat_[3] + hcz * temp;
-  temp = quat_[1];
-  quat_[1] = hc0 * quat_[1] - hcz * quat_[2];
-  quat_[2] = hc0 * quat_[2] + hcz * temp;
+  temp = quat[0];
+  quat[0] = hc0 * quat[0] - hcz * quat[3];
+  quat[3] = hc0 * quat[3] + hcz * temp;
+  temp = quat[1];
+  quat[1] = hc0 * quat[1] - hcz * quat[2];
+  quat[2] = hc0 * quat[2] + hcz * temp;
 }
 
 // -----------------------------------------------------------------------------
 void ResetAttitude(void)
 {
-  reset_attitude_ = 1;
+  attitude_.reset_attitude = 1;
+}
+
+// -----------------------------------------------------------------------------
+// This function sets "c" to level with the reset pending, so that the first
+// update takes the attitude from the accelerometer.
+void InitAttitudeContext(struct AttitudeContext * c)
+{
+  c->quat[0] = 1.0;
+  c->quat[1] = 0.0;
+  c->quat[2] = 0.0;
+  c->quat[3] = 0.0;
+  c->g_b[X_BODY_AXIS] = 0.0;
+  c->g_b[Y_BODY_AXIS] = 0.0;
+  c->g_b[Z_BODY_AXIS] = 1.0;
+  c->heading_angle = 0.0;
+  c->reset_attitude = 1;
 }
 
 // -----------------------------------------------------------------------------
@@ -150,15 +187,16 @@ float HeadingFromQuaternion(const float quat[4])
 // =============================================================================
 // Private functions:
 
-static float * CorrectQuaternionWithAccelerometer(float quat[4])
+static float * CorrectQuaternionWithAccelerometer(const float g_b[3],
+  const float acceleration[3], float quat[4])
 {
   // Assume that the accelerometer measures ONLY the resistance to gravity
   // (opposite the gravity vector). The direction of rotation that takes the
-  // body from predicted to estimated gravity is (-accelerometer x g_b_ x). This
-  // is equivalent to (g_b_ x accelerometer). Form a corrective quaternion from
+  // body from predicted to estimated gravity is (-accelerometer x g_b x). This
+  // is equivalent to (g_b x accelerometer). Form a corrective quaternion from
   // this rotation.
   float quat_c[4] = { 1.0, 0.0, 0.0, 0.0 };
-  Vector3Cross(g_b_, AccelerationVector(), &quat_c[1]);
+  Vector3Cross(g_b, acceleration, &quat_c[1]);
   quat_c[1] *= 0.5 * ACCELEROMETER_CORRECTION_GAIN;
   quat_c[2] *= 0.5 * ACCELEROMETER_CORRECTION_GAIN;
   quat_c[3] *= 0.5 * ACCELEROMETER_CORRECTION_GAIN;
@@ -175,14 +213,15 @@ static float * CorrectQuaternionWithAccelerometer(float quat[4])
 }
 
 // -----------------------------------------------------------------------------
-static void HandleAttitudeReset(void)
+static void HandleAttitudeReset(struct AttitudeContext * c,
+  const float acceleration[3])
 {
-  quat_[0] = -AccelerationVector()[Z_BODY_AXIS];
-  quat_[1] = -AccelerationVector()[Y_BODY_AXIS];
-  quat_[2] = AccelerationVector()[X_BODY_AXIS];
-  quat_[3] = 0.0;
-  quat_[0] += QuaternionNorm(quat_);
-  QuaternionNormalize(quat_);
-
-  reset_attitude_ = 0;
+  c->quat[0] = -acceleration[Z_BODY_AXIS];
+  c->quat[1] = -acceleration[Y_BODY_AXIS];
+  c->quat[2] = acceleration[X_BODY_AXIS];
+  c->quat[3] = 0.0;
+  c->quat[0] += QuaternionNorm(c->quat);
+  QuaternionNormalize(c->quat);
+
+  c->reset_attitude = 0;
 }
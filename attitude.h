@@ -5,9 +5,23 @@
 #include <inttypes.h>
 
 
+// The attitude estimate. The firmware keeps a single instance (see
+// DefaultAttitudeContext()), but any number can be advanced independently with
+// UpdateAttitudeContext().
+struct AttitudeContext {
+  float quat[4];
+  float g_b[3];
+  float heading_angle;
+  uint8_t reset_attitude;
+};
+
+
 // =============================================================================
 // Accessors:
 
+struct AttitudeContext * DefaultAttitudeContext(void);
+
+// -----------------------------------------------------------------------------
 const float * GravityInBodyVector(void);
 
 // -----------------------------------------------------------------------------
@@ -23,11 +37,18 @@ const float * Quat(void);
 void ResetAttitude(void);
 
 // -----------------------------------------------------------------------------
-void CorrectHeading(void);
+void InitAttitudeContext(struct AttitudeContext * c);
+
+// -----------------------------------------------------------------------------
+void CorrectHeading(float quat[4]);
 
 // -----------------------------------------------------------------------------
 void UpdateAttitude(void);
 
+// -----------------------------------------------------------------------------
+void UpdateAttitudeContext(struct AttitudeContext * c,
+  const float angular_rate[3], const float acceleration[3]);
+
 // -----------------------------------------------------------------------------
 float * UpdateGravityInBody(const float quat[4], float g_b[3]);
 
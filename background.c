@@ -0,0 +1,117 @@
+#include "background.h"
+
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "budget_check.h"
+#include "eeprom.h"
+#include "frame_timing.h"
+#include "load_meter.h"
+#include "uart.h"
+
+
+// =============================================================================
+// Private data:
+
+// Converts a budget in microseconds to TIMER3 ticks.
+#define JOB_BUDGET_US(us) \
+  ((uint16_t)((us) * (F_CPU / 1000000UL) / FRAME_TIMING_CYCLES_PER_TICK))
+
+struct Job {
+  uint8_t (*step)(void);  // Returns 1 if the job has more to do
+  uint16_t budget;  // TIMER3 ticks
+  enum LoadModule module;  // Identifies the job for the load meter
+  enum ProfileStage stage;  // Identifies the job for budget checks (or IDLE)
+};
+
+_Static_assert(BACKGROUND_JOB_COUNT <= 8, "Too many jobs for the bit field");
+
+static volatile uint8_t requested_ = 0;  // Bit field of enum BackgroundJob
+static uint8_t next_job_ = 0;  // The job that is considered first
+
+
+// =============================================================================
+// Private function declarations:
+
+#ifdef BUDGET_CHECK
+static void CheckJobBudget(const struct Job * job, uint16_t start);
+#endif
+static uint8_t SendTelemetry(void);
+
+
+// =============================================================================
+// Public functions:
+
+void RequestBackgroundJob(enum BackgroundJob job)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { requested_ |= _BV(job); }
+}
+
+// -----------------------------------------------------------------------------
+uint8_t RunBackgroundJobs(void)
+{
+  // The EEPROM step writes at most one byte (the EEPROM then works on its own
+  // for 3.4 ms), so its budget is not checked. Telemetry is sent in one step,
+  // so its budget is that of the task that it replaced.
+  static const struct Job kJobs[BACKGROUND_JOB_COUNT] = {
+    [BACKGROUND_JOB_EEPROM] = { WriteDeferredEEPROM, JOB_BUDGET_US(100),
+      LOAD_MODULE_OTHER, PROFILE_STAGE_IDLE },
+    [BACKGROUND_JOB_TELEMETRY] = { SendTelemetry, JOB_BUDGET_US(1000),
+      LOAD_MODULE_UART, PROFILE_STAGE_SEND_PENDING_UART },
+  };
+
+  if (!requested_) return 0;
+
+  uint16_t time;
+  FrameTimingNow(&time);
+  const uint16_t kTicksLeft = FRAME_TIMING_TICKS_PER_FRAME - time;
+
+  // Take turns so that a job that always has work does not starve the others.
+  for (uint8_t i = 0; i < BACKGROUND_JOB_COUNT; i++)
+  {
+    uint8_t job = next_job_ + i;
+    if (job >= BACKGROUND_JOB_COUNT) job -= BACKGROUND_JOB_COUNT;
+    if (!(requested_ & _BV(job)) || (kJobs[job].budget > kTicksLeft))
+      continue;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { requested_ &= ~_BV(job); }
+    LoadMeterMark(kJobs[job].module);
+    if ((*kJobs[job].step)()) RequestBackgroundJob(job);
+    LoadMeterMark(LOAD_MODULE_IDLE);
+#ifdef BUDGET_CHECK
+    CheckJobBudget(&kJobs[job], time);
+#endif
+    next_job_ = job + 1 < BACKGROUND_JOB_COUNT ? job + 1 : 0;
+    return 1;
+  }
+  return 0;
+}
+
+
+// =============================================================================
+// Private functions:
+
+#ifdef BUDGET_CHECK
+// This function checks the run of "job" that started "start" TIMER3 ticks into
+// the frame against its budget. The run may have crossed the next tick.
+static void CheckJobBudget(const struct Job * job, uint16_t start)
+{
+  if (job->stage == PROFILE_STAGE_IDLE) return;
+
+  uint16_t time;
+  FrameTimingNow(&time);
+  const uint16_t duration = time >= start ? time - start
+    : time + FRAME_TIMING_TICKS_PER_FRAME - start;
+  if (duration > job->budget)
+    BudgetViolation(job->stage, duration, job->budget);
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// This function sends the UART data streams that are due (see
+// SendPendingUART()) in a single step.
+static uint8_t SendTelemetry(void)
+{
+  SendPendingUART();
+  return 0;
+}
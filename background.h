@@ -0,0 +1,41 @@
+#ifndef BACKGROUND_H_
+#define BACKGROUND_H_
+
+
+// This file declares the runner of background jobs, which do deferred work in
+// the slack time of the main loop (between the end of the tasks of a frame and
+// the next TIMER3 tick, see scheduler.c). A job is requested with
+// RequestBackgroundJob() and then runs in steps, one per call to
+// RunBackgroundJobs(), until a step reports that nothing is left to do. A job
+// keeps its own position between steps, so each step resumes where the
+// previous one stopped.
+//
+// Each job has a budget for one step, and a step is only started if it would
+// finish before the next tick. The frame that follows is therefore not
+// delayed, and a job that does not fit in the slack of a frame waits for a
+// frame with more slack.
+
+#include <inttypes.h>
+
+
+enum BackgroundJob {
+  BACKGROUND_JOB_EEPROM = 0,  // Deferred EEPROM writes (see eeprom.h)
+  BACKGROUND_JOB_TELEMETRY,  // Packing and sending of the UART data streams
+  BACKGROUND_JOB_COUNT,
+};
+
+
+// =============================================================================
+// Public functions:
+
+// This function marks "job" to be run in the slack time of the main loop.
+void RequestBackgroundJob(enum BackgroundJob job);
+
+// -----------------------------------------------------------------------------
+// This function runs one step of the next requested job that fits in the time
+// left before the next tick, and returns 1, or returns 0 if there was nothing
+// to do.
+uint8_t RunBackgroundJobs(void);
+
+
+#endif  // BACKGROUND_H_
@@ -0,0 +1,536 @@
+#include "benchmarks.h"
+
+#ifdef SIM_BENCH
+
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/sleep.h>
+
+#include "adc.h"
+#include "attitude.h"
+#include "control.h"
+#include "custom_math.h"
+#include "main.h"
+#include "quaternion.h"
+#include "vector.h"
+
+
+// =============================================================================
+// Private data:
+
+// Length used for the variable-length vector routines.
+#define BENCH_VECTOR_LENGTH (4)
+
+// Inputs chosen to exercise the data-dependent paths (limits, sign, and wrap).
+static const float kVectors[BENCH_N_INPUTS][BENCH_VECTOR_LENGTH] = {
+  { 0.0, 0.0, 1.0, 0.5 },
+  { 0.1, -0.2, 0.97, -3.0 },
+  { -1.5, 2.25, -9.81, 100.0 },
+  { 123.4, -0.001, 7.0, -0.75 },
+};
+static const float kQuats[BENCH_N_INPUTS][4] = {
+  { 1.0, 0.0, 0.0, 0.0 },
+  { 0.9238795, 0.3826834, 0.0, 0.0 },
+  { 0.7071068, 0.0, 0.1, 0.7071068 },
+  { 0.5, 0.5, -0.5, 0.5 },
+};
+static const float kScalars[BENCH_N_INPUTS] = { 0.0, 0.7, -3.5, 12.0 };
+static const int32_t kIntegers[BENCH_N_INPUTS] = { 0, 37, -1234, 100000 };
+// Sums of the ADC samples, which are within range for any share of the sample
+// array (at least 2 samples of 10 bits).
+static const uint16_t kADCSums[BENCH_N_INPUTS] = { 0, 511, 1023, 2046 };
+
+// Operands are kept in static memory (like the state of the firmware modules)
+// and are reloaded from the tables above before every call.
+static float v1_[BENCH_VECTOR_LENGTH], v2_[BENCH_VECTOR_LENGTH];
+static float result_[BENCH_VECTOR_LENGTH];
+static float quat1_[4], quat2_[4];
+static float delay_[2];
+static struct AttitudeContext attitude_;
+static struct Limits limits_;
+
+// The running sums of the ADC interrupt handler (see adc.c), which is not
+// running during the benchmarks.
+extern volatile uint16_t sample_sums_[ADC_N_CHANNELS];
+
+static const float kFilterCoefficients[2][2] = {
+  { 0.0134, 0.0129 },
+  { -1.7786, 0.8049 },
+};
+
+// Scalar operands and results live in registers, so they are passed through
+// empty asm statements to hide their values from the optimizer and to force
+// the computation to happen between the markers.
+#define BENCH_OPAQUE(x) asm volatile("" : "+r" (x))
+#define BENCH_KEEP(x) asm volatile("" : : "r" (x))
+
+
+// =============================================================================
+// Private function declarations:
+
+static inline void BenchStart(enum BenchId id);
+static inline void BenchStop(void);
+static void LoadInputs(uint8_t i);
+static void RunVectorBenchmarks(uint8_t i);
+static void RunQuaternionBenchmarks(uint8_t i);
+static void RunCustomMathBenchmarks(uint8_t i);
+static void RunAttitudeBenchmarks(uint8_t i);
+static void RunADCBenchmarks(uint8_t i);
+
+
+// =============================================================================
+// Public functions:
+
+void RunBenchmarks(void)
+{
+  cli();
+
+  for (uint8_t i = 0; i < BENCH_N_INPUTS; i++)
+  {
+    BenchStart(BENCH_OVERHEAD);
+    BenchStop();
+
+    RunVectorBenchmarks(i);
+    RunQuaternionBenchmarks(i);
+    RunCustomMathBenchmarks(i);
+    RunAttitudeBenchmarks(i);
+    RunADCBenchmarks(i);
+  }
+
+  GPIOR1 = BENCH_DONE;
+
+  // Sleeping with interrupts disabled ends the simulation.
+  sleep_enable();
+  for (;;) sleep_cpu();
+}
+
+
+// =============================================================================
+// Private functions:
+
+// The memory barriers keep the compiler from moving loads of the operands or
+// stores of the results across the markers.
+static inline void BenchStart(enum BenchId id)
+{
+  asm volatile("" ::: "memory");
+  GPIOR1 = id;
+  asm volatile("" ::: "memory");
+}
+
+// -----------------------------------------------------------------------------
+static inline void BenchStop(void)
+{
+  asm volatile("" ::: "memory");
+  GPIOR1 = BENCH_IDLE;
+  asm volatile("" ::: "memory");
+}
+
+// -----------------------------------------------------------------------------
+static void LoadInputs(uint8_t i)
+{
+  const uint8_t j = (i + 1) % BENCH_N_INPUTS;
+  for (uint8_t k = 0; k < BENCH_VECTOR_LENGTH; k++)
+  {
+    v1_[k] = kVectors[i][k];
+    v2_[k] = kVectors[j][k];
+    result_[k] = kVectors[j][k];
+  }
+  for (uint8_t k = 0; k < 4; k++)
+  {
+    quat1_[k] = kQuats[i][k];
+    quat2_[k] = kQuats[j][k];
+    attitude_.quat[k] = kQuats[j][k];
+  }
+  delay_[0] = kScalars[i];
+  delay_[1] = kScalars[j];
+  UpdateGravityInBody(attitude_.quat, attitude_.g_b);
+  attitude_.heading_angle = HeadingFromQuaternion(attitude_.quat);
+  limits_.heading_error = 0.5;
+}
+
+// -----------------------------------------------------------------------------
+static void RunVectorBenchmarks(uint8_t i)
+{
+  float scalar = kScalars[i], result;
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR3_ADD);
+  Vector3Add(v1_, v2_, result_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR3_ADD_TO_SELF);
+  Vector3AddToSelf(v1_, v2_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR3_COPY);
+  Vector3Copy(v1_, result_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR3_CROSS);
+  Vector3Cross(v1_, v2_, result_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR3_DOT);
+  result = Vector3Dot(v1_, v2_);
+  BENCH_KEEP(result);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR3_NORM);
+  result = Vector3Norm(v1_);
+  BENCH_KEEP(result);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR3_NORM_SQUARED);
+  result = Vector3NormSquared(v1_);
+  BENCH_KEEP(result);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR3_SCALE);
+  BENCH_OPAQUE(scalar);
+  Vector3Scale(v1_, scalar, result_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR3_SCALE_AND_ACCUMULATE);
+  BENCH_OPAQUE(scalar);
+  Vector3ScaleAndAccumulate(v1_, scalar, result_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR3_SCALE_SELF);
+  BENCH_OPAQUE(scalar);
+  Vector3ScaleSelf(v1_, scalar);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR3_SUBTRACT);
+  Vector3Subtract(v1_, v2_, result_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR3_SUBTRACT_FROM_SELF);
+  Vector3SubtractFromSelf(v1_, v2_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR_ADD);
+  VectorAdd(v1_, v2_, BENCH_VECTOR_LENGTH, result_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR_ADD_TO_SELF);
+  VectorAddToSelf(v1_, v2_, BENCH_VECTOR_LENGTH);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR_COPY);
+  VectorCopy(v1_, BENCH_VECTOR_LENGTH, result_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR_SCALE);
+  BENCH_OPAQUE(scalar);
+  VectorScale(v1_, scalar, BENCH_VECTOR_LENGTH, result_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR_SCALE_SELF);
+  BENCH_OPAQUE(scalar);
+  VectorScaleSelf(v1_, scalar, BENCH_VECTOR_LENGTH);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR_SUBTRACT);
+  VectorSubtract(v1_, v2_, BENCH_VECTOR_LENGTH, result_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_VECTOR_SUBTRACT_FROM_SELF);
+  VectorSubtractFromSelf(v1_, v2_, BENCH_VECTOR_LENGTH);
+  BenchStop();
+}
+
+// -----------------------------------------------------------------------------
+static void RunQuaternionBenchmarks(uint8_t i)
+{
+  float result;
+
+  LoadInputs(i);
+  BenchStart(BENCH_QUATERNION_INVERSE);
+  QuaternionInverse(quat1_, result_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_QUATERNION_INVERT_SELF);
+  QuaternionInvertSelf(quat1_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_QUATERNION_INVERSE_MULTIPLY);
+  QuaternionInverseMultiply(quat1_, quat2_, result_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_QUATERNION_MULTIPLY);
+  QuaternionMultiply(quat1_, quat2_, result_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_QUATERNION_MULTIPLY_INVERSE);
+  QuaternionMultiplyInverse(quat1_, quat2_, result_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_QUATERNION_NORM);
+  result = QuaternionNorm(quat1_);
+  BENCH_KEEP(result);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_QUATERNION_NORMALIZE);
+  QuaternionNormalize(quat1_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_QUATERNION_NORMALIZING_FILTER);
+  QuaternionNormalizingFilter(quat1_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_QUATERNION_ROTATE_VECTOR);
+  QuaternionRotateVector(quat1_, v1_, result_);
+  BenchStop();
+}
+
+// -----------------------------------------------------------------------------
+static void RunCustomMathBenchmarks(uint8_t i)
+{
+  float x = kScalars[i], y = kScalars[(i + 1) % BENCH_N_INPUTS];
+  float angle = kVectors[i][3], result;
+  int32_t n = kIntegers[i];
+  int8_t s8 = (int8_t)n, s8_result;
+  int16_t s16 = (int16_t)n, s16_result;
+  int32_t s32 = n, s32_result;
+  uint8_t u8 = (uint8_t)n, u8_result;
+  uint16_t u16 = (uint16_t)n, u16_result;
+  uint32_t u32 = (uint32_t)n, u32_result;
+
+  LoadInputs(i);
+  BenchStart(BENCH_DIRECT_FORM_2_ZERO_B0);
+  BENCH_OPAQUE(x);
+  result = DirectForm2ZeroB0(x, kFilterCoefficients, delay_);
+  BENCH_KEEP(result);
+  BenchStop();
+
+  BenchStart(BENCH_FLOAT_TO_S16);
+  BENCH_OPAQUE(x);
+  s16_result = FloatToS16(x);
+  BENCH_KEEP(s16_result);
+  BenchStop();
+
+  BenchStart(BENCH_FLOAT_TO_U16);
+  BENCH_OPAQUE(y);
+  u16_result = FloatToU16(y);
+  BENCH_KEEP(u16_result);
+  BenchStop();
+
+  BenchStart(BENCH_FLOAT_LIMIT);
+  BENCH_OPAQUE(x);
+  result = FloatLimit(x, -1.0, 1.0);
+  BENCH_KEEP(result);
+  BenchStop();
+
+  BenchStart(BENCH_FLOAT_S_LIMIT);
+  BENCH_OPAQUE(x);
+  result = FloatSLimit(x, 1.0);
+  BENCH_KEEP(result);
+  BenchStop();
+
+  BenchStart(BENCH_FLOAT_MAX);
+  BENCH_OPAQUE(x);
+  BENCH_OPAQUE(y);
+  result = FloatMax(x, y);
+  BENCH_KEEP(result);
+  BenchStop();
+
+  BenchStart(BENCH_FLOAT_MIN);
+  BENCH_OPAQUE(x);
+  BENCH_OPAQUE(y);
+  result = FloatMin(x, y);
+  BENCH_KEEP(result);
+  BenchStop();
+
+  BenchStart(BENCH_Q16_TO_FLOAT);
+  BENCH_OPAQUE(s32);
+  result = Q16ToFloat(s32);
+  BENCH_KEEP(result);
+  BenchStop();
+
+  BenchStart(BENCH_S8_LIMIT);
+  BENCH_OPAQUE(s8);
+  s8_result = S8Limit(s8, -100, 100);
+  BENCH_KEEP(s8_result);
+  BenchStop();
+
+  BenchStart(BENCH_S16_LIMIT);
+  BENCH_OPAQUE(s16);
+  s16_result = S16Limit(s16, -1000, 1000);
+  BENCH_KEEP(s16_result);
+  BenchStop();
+
+  BenchStart(BENCH_S32_LIMIT);
+  BENCH_OPAQUE(s32);
+  s32_result = S32Limit(s32, -1000, 1000);
+  BENCH_KEEP(s32_result);
+  BenchStop();
+
+  BenchStart(BENCH_U8_LIMIT);
+  BENCH_OPAQUE(u8);
+  u8_result = U8Limit(u8, 10, 200);
+  BENCH_KEEP(u8_result);
+  BenchStop();
+
+  BenchStart(BENCH_U16_LIMIT);
+  BENCH_OPAQUE(u16);
+  u16_result = U16Limit(u16, 10, 1000);
+  BENCH_KEEP(u16_result);
+  BenchStop();
+
+  BenchStart(BENCH_U32_LIMIT);
+  BENCH_OPAQUE(u32);
+  u32_result = U32Limit(u32, 10, 1000);
+  BENCH_KEEP(u32_result);
+  BenchStop();
+
+  BenchStart(BENCH_S16_ROUND_R_SHIFT_S16);
+  BENCH_OPAQUE(s16);
+  s16_result = S16RoundRShiftS16(s16, 3);
+  BENCH_KEEP(s16_result);
+  BenchStop();
+
+  BenchStart(BENCH_S8_ROUND_R_SHIFT_S16);
+  BENCH_OPAQUE(s16);
+  s8_result = S8RoundRShiftS16(s16, 8);
+  BENCH_KEEP(s8_result);
+  BenchStop();
+
+  BenchStart(BENCH_S32_ROUND_R_SHIFT_S32);
+  BENCH_OPAQUE(s32);
+  s32_result = S32RoundRShiftS32(s32, 3);
+  BENCH_KEEP(s32_result);
+  BenchStop();
+
+  BenchStart(BENCH_S16_ROUND_R_SHIFT_S32);
+  BENCH_OPAQUE(s32);
+  s16_result = S16RoundRShiftS32(s32, 3);
+  BENCH_KEEP(s16_result);
+  BenchStop();
+
+  BenchStart(BENCH_U16_ROUND_R_SHIFT_U16);
+  BENCH_OPAQUE(u16);
+  u16_result = U16RoundRShiftU16(u16, 3);
+  BENCH_KEEP(u16_result);
+  BenchStop();
+
+  BenchStart(BENCH_U8_ROUND_R_SHIFT_U16);
+  BENCH_OPAQUE(u16);
+  u8_result = U8RoundRShiftU16(u16, 8);
+  BENCH_KEEP(u8_result);
+  BenchStop();
+
+  BenchStart(BENCH_U32_ROUND_R_SHIFT_U32);
+  BENCH_OPAQUE(u32);
+  u32_result = U32RoundRShiftU32(u32, 3);
+  BENCH_KEEP(u32_result);
+  BenchStop();
+
+  BenchStart(BENCH_U16_ROUND_R_SHIFT_U32);
+  BENCH_OPAQUE(u32);
+  u16_result = U16RoundRShiftU32(u32, 3);
+  BENCH_KEEP(u16_result);
+  BenchStop();
+
+  BenchStart(BENCH_S16_SCALE_TO_Q16);
+  BENCH_OPAQUE(s16);
+  s32_result = S16ScaleToQ16(s16, 12345);
+  BENCH_KEEP(s32_result);
+  BenchStop();
+
+  BenchStart(BENCH_WRAP_TO_PLUS_MINUS_PI);
+  BENCH_OPAQUE(angle);
+  result = WrapToPlusMinusPi(angle);
+  BENCH_KEEP(result);
+  BenchStop();
+}
+
+// -----------------------------------------------------------------------------
+static void RunAttitudeBenchmarks(uint8_t i)
+{
+  float dt = DT, heading_cmd = kScalars[i], result;
+
+  LoadInputs(i);
+  BenchStart(BENCH_UPDATE_QUATERNION);
+  BENCH_OPAQUE(dt);
+  UpdateQuaternion(quat1_, v1_, dt);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_UPDATE_GRAVITY_IN_BODY);
+  UpdateGravityInBody(quat1_, result_);
+  BenchStop();
+
+  LoadInputs(i);
+  BenchStart(BENCH_HEADING_FROM_QUATERNION);
+  result = HeadingFromQuaternion(quat1_);
+  BENCH_KEEP(result);
+  BenchStop();
+
+  // The gravity command is the x and y components of a unit vector.
+  LoadInputs(i);
+  UpdateGravityInBody(quat1_, v1_);
+  BenchStart(BENCH_QUATERNION_FROM_GRAVITY_AND_HEADING_COMMAND);
+  BENCH_OPAQUE(heading_cmd);
+  QuaternionFromGravityAndHeadingCommand(&attitude_, v1_, &limits_,
+    heading_cmd, result_);
+  BenchStop();
+}
+
+// -----------------------------------------------------------------------------
+// The conversion of a gyro sum to rad/s is timed both ways: the float division
+// by the scale that ProcessSensorReadings() and ReadAngularRate() do, and the
+// Q16 multiplication by the reciprocal with a float view, which would replace
+// it (see ADC_SUM_RECIPROCAL_Q24()).
+static void RunADCBenchmarks(uint8_t i)
+{
+  int16_t sum = (int16_t)kADCSums[i] - 1023;
+  float result;
+
+  BenchStart(BENCH_SENSOR_SUM_TO_FLOAT);
+  BENCH_OPAQUE(sum);
+  result = (float)sum / GYRO_SCALE / ADC_N_SAMPLES;
+  BENCH_KEEP(result);
+  BenchStop();
+
+  BenchStart(BENCH_SENSOR_SUM_TO_Q16);
+  BENCH_OPAQUE(sum);
+  result = Q16ToFloat(S16ScaleToQ16(sum, ADC_SUM_RECIPROCAL_Q24(GYRO_SCALE)));
+  BENCH_KEEP(result);
+  BenchStop();
+
+  for (uint8_t k = 0; k < ADC_N_CHANNELS; k++) sample_sums_[k] = kADCSums[i];
+
+  BenchStart(BENCH_PROCESS_SENSOR_READINGS);
+  ProcessSensorReadings();
+  BenchStop();
+}
+
+
+#endif  // SIM_BENCH
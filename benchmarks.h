@@ -0,0 +1,99 @@
+#ifndef BENCHMARKS_H_
+#define BENCHMARKS_H_
+
+
+// This file defines the microbenchmarks of the math routines that the cycle
+// benchmark runner times on a simulated ATmega1284P (see sim/bench.c and
+// "make bench"). When the firmware is built with SIM_BENCH defined, main()
+// calls RunBenchmarks() before anything else. Each benchmark calls its routine
+// once for each of BENCH_N_INPUTS input sets, writing the benchmark number to
+// GPIOR1 just before the call and BENCH_IDLE just after. BENCH_DONE is written
+// when all of the benchmarks have run. Otherwise, RunBenchmarks() compiles to
+// nothing.
+
+// Data space address of GPIOR1 (I/O address 0x2A).
+#define BENCH_MARKER_ADDRESS (0x4A)
+
+#define BENCH_N_INPUTS (4)
+
+
+enum BenchId {
+  BENCH_IDLE = 0,
+  BENCH_OVERHEAD,  // Markers only (subtracted from the other benchmarks)
+  // vector.c
+  BENCH_VECTOR3_ADD,
+  BENCH_VECTOR3_ADD_TO_SELF,
+  BENCH_VECTOR3_COPY,
+  BENCH_VECTOR3_CROSS,
+  BENCH_VECTOR3_DOT,
+  BENCH_VECTOR3_NORM,
+  BENCH_VECTOR3_NORM_SQUARED,
+  BENCH_VECTOR3_SCALE,
+  BENCH_VECTOR3_SCALE_AND_ACCUMULATE,
+  BENCH_VECTOR3_SCALE_SELF,
+  BENCH_VECTOR3_SUBTRACT,
+  BENCH_VECTOR3_SUBTRACT_FROM_SELF,
+  BENCH_VECTOR_ADD,
+  BENCH_VECTOR_ADD_TO_SELF,
+  BENCH_VECTOR_COPY,
+  BENCH_VECTOR_SCALE,
+  BENCH_VECTOR_SCALE_SELF,
+  BENCH_VECTOR_SUBTRACT,
+  BENCH_VECTOR_SUBTRACT_FROM_SELF,
+  // quaternion.c
+  BENCH_QUATERNION_INVERSE,
+  BENCH_QUATERNION_INVERT_SELF,
+  BENCH_QUATERNION_INVERSE_MULTIPLY,
+  BENCH_QUATERNION_MULTIPLY,
+  BENCH_QUATERNION_MULTIPLY_INVERSE,
+  BENCH_QUATERNION_NORM,
+  BENCH_QUATERNION_NORMALIZE,
+  BENCH_QUATERNION_NORMALIZING_FILTER,
+  BENCH_QUATERNION_ROTATE_VECTOR,
+  // custom_math.c
+  BENCH_DIRECT_FORM_2_ZERO_B0,
+  BENCH_FLOAT_TO_S16,
+  BENCH_FLOAT_TO_U16,
+  BENCH_FLOAT_LIMIT,
+  BENCH_FLOAT_S_LIMIT,
+  BENCH_FLOAT_MAX,
+  BENCH_FLOAT_MIN,
+  BENCH_Q16_TO_FLOAT,
+  BENCH_S8_LIMIT,
+  BENCH_S16_LIMIT,
+  BENCH_S32_LIMIT,
+  BENCH_U8_LIMIT,
+  BENCH_U16_LIMIT,
+  BENCH_U32_LIMIT,
+  BENCH_S16_ROUND_R_SHIFT_S16,
+  BENCH_S8_ROUND_R_SHIFT_S16,
+  BENCH_S32_ROUND_R_SHIFT_S32,
+  BENCH_S16_ROUND_R_SHIFT_S32,
+  BENCH_U16_ROUND_R_SHIFT_U16,
+  BENCH_U8_ROUND_R_SHIFT_U16,
+  BENCH_U32_ROUND_R_SHIFT_U32,
+  BENCH_U16_ROUND_R_SHIFT_U32,
+  BENCH_S16_SCALE_TO_Q16,
+  BENCH_WRAP_TO_PLUS_MINUS_PI,
+  // attitude.c and control.c
+  BENCH_UPDATE_QUATERNION,
+  BENCH_UPDATE_GRAVITY_IN_BODY,
+  BENCH_HEADING_FROM_QUATERNION,
+  BENCH_QUATERNION_FROM_GRAVITY_AND_HEADING_COMMAND,
+  // adc.c
+  BENCH_SENSOR_SUM_TO_FLOAT,  // The float conversion (see adc.h)
+  BENCH_SENSOR_SUM_TO_Q16,
+  BENCH_PROCESS_SENSOR_READINGS,
+  BENCH_COUNT,
+  BENCH_DONE = 0xFF,
+};
+
+
+// =============================================================================
+// Public functions:
+
+// This function runs all of the benchmarks and then halts the processor.
+void RunBenchmarks(void);
+
+
+#endif  // BENCHMARKS_H_
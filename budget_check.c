@@ -0,0 +1,78 @@
+// This file keeps the records of the budget violations (see budget_check.h). It
+// is only compiled into the program when BUDGET_CHECK is defined.
+
+#include "budget_check.h"
+
+#ifdef BUDGET_CHECK
+
+
+#include <avr/io.h>
+
+#include "adc.h"
+#include "completion.h"
+#include "frame_timing.h"
+#include "nav_comms.h"
+#include "sbus.h"
+#include "scheduler.h"
+#include "state.h"
+
+
+// =============================================================================
+// Private data:
+
+_Static_assert(!(BUDGET_CHECK_N_RECORDS & (BUDGET_CHECK_N_RECORDS - 1)),
+  "The number of budget violation records must be a power of 2");
+
+static struct BudgetViolationRecord records_[BUDGET_CHECK_N_RECORDS];
+static uint8_t next_record_ = 0;
+static uint16_t count_ = 0;
+
+
+// =============================================================================
+// Accessors:
+
+uint16_t BudgetViolationCount(void)
+{
+  return count_;
+}
+
+// -----------------------------------------------------------------------------
+struct BudgetViolationRecord BudgetViolationRecord(uint8_t i)
+{
+  return records_[(uint8_t)(next_record_ - 1 - i)
+    & (BUDGET_CHECK_N_RECORDS - 1)];
+}
+
+
+// =============================================================================
+// Public functions:
+
+void BudgetViolation(enum ProfileStage stage, uint16_t duration,
+  uint16_t budget)
+{
+  struct BudgetViolationRecord * record =
+    &records_[next_record_ & (BUDGET_CHECK_N_RECORDS - 1)];
+  next_record_++;
+  if (count_ != 0xFFFF) count_++;
+
+  uint16_t time;
+  record->stage = stage;
+  record->frame = FrameTimingNow(&time);
+  record->time = time;
+  record->duration = duration;
+  record->budget = budget;
+  record->state = State();
+  record->control_mode = ControlMode();
+  record->nav_mode = NavMode();
+  record->nav_status = NavStatus();
+  record->sbus_error_bits = SBusErrorBits();
+  record->load_shed_level = LoadShedLevel();
+  record->adc_state = ADCState();
+  record->completion_overflow_count = CompletionOverflowCount();
+
+  const uint8_t * byte = (const uint8_t *)record;
+  for (uint8_t i = 0; i < sizeof(*record); i++) GPIOR2 = byte[i];
+}
+
+
+#endif  // BUDGET_CHECK
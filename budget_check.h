@@ -0,0 +1,89 @@
+#ifndef BUDGET_CHECK_H_
+#define BUDGET_CHECK_H_
+
+
+// This file declares a checker of the execution budgets of the scheduled tasks
+// (see scheduler.c) and the background jobs (see background.c). The budgets
+// are the performance contracts of the main loop: when the firmware is built
+// with BUDGET_CHECK defined, each run that exceeds its budget is recorded along
+// with the inputs that steer the work of the tasks (the flight state, control
+// and navigation modes, and so on), so that the cause can be reproduced. The
+// most recent BUDGET_CHECK_N_RECORDS records are kept, and can be inspected
+// with a debugger.
+//
+// Each record is also written byte by byte to GPIOR2, where the cycle profiler
+// (see sim/profile.c) picks it up, so that a simulation run can report the
+// violations and fail if there are any. Otherwise, the checker is not compiled
+// and BudgetViolation() compiles to nothing. The tasks still count their
+// violations in either case (see TaskOverBudgetCount()).
+
+// Data space address of GPIOR2 (I/O address 0x2B).
+#define BUDGET_CHECK_MARKER_ADDRESS (0x4B)
+
+#define BUDGET_CHECK_N_RECORDS (8)
+
+
+#ifndef __ASSEMBLER__
+
+
+#include <inttypes.h>
+
+#include "profile.h"
+
+
+struct BudgetViolationRecord {
+  uint8_t stage;  // enum ProfileStage of the task or job
+  uint8_t frame;  // Number of the 128 Hz tick (modulo 256)
+  uint16_t time;  // TIMER3 ticks since the 128 Hz tick at the end of the run
+  uint16_t duration;  // TIMER3 ticks
+  uint16_t budget;  // TIMER3 ticks
+  // The inputs:
+  uint8_t state;  // enum StateBits
+  uint8_t control_mode;  // enum ControlMode
+  uint8_t nav_mode;  // enum NavMode
+  uint8_t nav_status;
+  uint8_t sbus_error_bits;
+  uint8_t load_shed_level;  // enum LoadShedLevel
+  uint8_t adc_state;  // enum ADCState
+  uint8_t completion_overflow_count;
+} __attribute__((packed));
+
+
+// =============================================================================
+// Accessors:
+
+// The accessors are only available when BUDGET_CHECK is defined.
+
+// This function returns the number of violations since startup (saturating at
+// 65535).
+uint16_t BudgetViolationCount(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the i-th most recent record (0 is the latest). Only the
+// first min(BudgetViolationCount(), BUDGET_CHECK_N_RECORDS) are valid.
+struct BudgetViolationRecord BudgetViolationRecord(uint8_t i);
+
+
+// =============================================================================
+// Public functions:
+
+// This function records that the task or job marked by "stage" has run for
+// "duration" TIMER3 ticks against a budget of "budget". It should only be
+// called from the main loop, once the run has finished.
+#ifdef BUDGET_CHECK
+void BudgetViolation(enum ProfileStage stage, uint16_t duration,
+  uint16_t budget);
+#else
+static inline void BudgetViolation(enum ProfileStage stage, uint16_t duration,
+  uint16_t budget)
+{
+  (void)stage;
+  (void)duration;
+  (void)budget;
+}
+#endif
+
+
+#endif  // __ASSEMBLER__
+
+#endif  // BUDGET_CHECK_H_
@@ -0,0 +1,73 @@
+#include "completion.h"
+
+
+// =============================================================================
+// Private data:
+
+#define COMPLETION_QUEUE_LENGTH (16)  // A power of 2
+
+_Static_assert(!(COMPLETION_QUEUE_LENGTH & (COMPLETION_QUEUE_LENGTH - 1)),
+  "The completion queue length must be a power of 2");
+
+struct Completion {
+  CompletionHandler handler;
+  uint8_t argument;
+};
+
+// The entries are volatile so that an entry is written before the head that
+// publishes it, and read before the tail that releases it.
+static volatile struct Completion queue_[COMPLETION_QUEUE_LENGTH];
+static volatile uint8_t head_ = 0;  // Written only by PostCompletion()
+static volatile uint8_t tail_ = 0;  // Written only by RunCompletions()
+static uint8_t overflow_count_ = 0;
+
+
+// =============================================================================
+// Accessors:
+
+uint8_t CompletionOverflowCount(void)
+{
+  return overflow_count_;
+}
+
+
+// =============================================================================
+// Public functions:
+
+void PostCompletion(CompletionHandler handler, uint8_t argument)
+{
+  const uint8_t head = head_;
+  if ((uint8_t)(head - tail_) >= COMPLETION_QUEUE_LENGTH)
+  {
+    if (overflow_count_ != 0xFF) overflow_count_++;
+    return;
+  }
+
+  volatile struct Completion * entry =
+    &queue_[head & (COMPLETION_QUEUE_LENGTH - 1)];
+  entry->handler = handler;
+  entry->argument = argument;
+  head_ = head + 1;
+}
+
+// -----------------------------------------------------------------------------
+uint8_t RunCompletions(void)
+{
+  // Events that are posted meanwhile are left for the next call, so that this
+  // returns even if the events keep coming.
+  const uint8_t head = head_;
+  uint8_t tail = tail_;
+  if (tail == head) return 0;
+
+  do
+  {
+    volatile struct Completion * entry =
+      &queue_[tail & (COMPLETION_QUEUE_LENGTH - 1)];
+    const CompletionHandler handler = entry->handler;
+    const uint8_t argument = entry->argument;
+    tail_ = ++tail;
+    (*handler)(argument);
+  } while (tail != head);
+
+  return 1;
+}
@@ -0,0 +1,47 @@
+#ifndef COMPLETION_H_
+#define COMPLETION_H_
+
+
+// This file declares a queue of completion events, which lets the interrupt
+// handlers of the I2C and SPI hand the processing of a finished transfer to the
+// main loop. The handler posts an event (a function and a one-byte argument)
+// and returns, and the main loop runs the events in order with
+// RunCompletions(). The time spent in the interrupt handlers therefore stays
+// short and bounded, however much work the completion needs.
+//
+// The queue is a ring with a single producer and a single consumer, so it needs
+// no locking: the producer only writes the head and the consumer only writes
+// the tail, and both are single bytes. The producer is interrupt context (the
+// TWI and SPI handlers, which do not nest), and the consumer is the main loop.
+// Events that arrive while the queue is full are dropped and counted.
+
+#include <inttypes.h>
+
+
+typedef void (*CompletionHandler)(uint8_t argument);
+
+
+// =============================================================================
+// Accessors:
+
+// This function returns the number of events that have been dropped because
+// the queue was full (saturating at 255).
+uint8_t CompletionOverflowCount(void);
+
+
+// =============================================================================
+// Public functions:
+
+// This function queues "handler" to be called with "argument" from the main
+// loop. It should only be called from an interrupt handler that runs with
+// interrupts disabled.
+void PostCompletion(CompletionHandler handler, uint8_t argument);
+
+// -----------------------------------------------------------------------------
+// This function runs the events that are queued when it is called, in the order
+// in which they were posted, and returns 1, or returns 0 if there was nothing
+// to do.
+uint8_t RunCompletions(void);
+
+
+#endif  // COMPLETION_H_
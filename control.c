@@ -3,6 +3,12 @@
 //   - thrust
 //   - heading rate
 //   - direction of gravity in the body frame
+//
+// The controller is split in two loops. The outer loop (Control()) runs once
+// per 128 Hz frame and turns the commands into a target attitude, an angular
+// rate command, and the attitude feedback term. The rate loop (RateControl())
+// runs RATE_LOOP_FACTOR times per frame with the latest gyro readings and adds
+// the angular rate and acceleration feedback to form the motor setpoints.
 
 // The structure of the attitude controller is state-feedback with model-based
 // integral action as described in:
@@ -14,12 +20,12 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <util/atomic.h>
 
 #include "adc.h"
 #include "attitude.h"
 #include "custom_math.h"
 #include "eeprom.h"
-#include "indicator.h"
 #include "main.h"
 #include "motors.h"
 #include "nav_comms.h"
@@ -41,7 +47,7 @@
 #define THRUST_CMD_RANGE (MAX_THRUST_CMD - MIN_THRUST_CMD)
 #define SBUS_TO_THRUST_CMD ((float)THRUST_CMD_RANGE / (2.0 * (float)SBUS_MAX))
 #define MAX_G_B_CMD (sin(M_PI / 6.0))
-// TODO: unify this with limits_.heading_rate
+// TODO: unify this with ControlContext.limits.heading_rate
 #define MAX_HEADING_RATE (M_PI / 4.0)
 #define MAX_VERTICAL_SPEED (1.0)
 #define MIN_TRANSIT_SPEED (0.1)
@@ -54,176 +60,113 @@
 #define TAKEOFF_RESIDUAL_WASHOUT_STEP (TAKEOFF_RESIDUAL_WASHOUT_RATE / 100.0 \
     * (float)(THRUST_CMD_RANGE) * DT)
 
-// Computed constants.
-static float actuation_inverse_[MAX_MOTORS][4];
-
-static struct FeedbackGains {
-  float p_dot;
-  float p;
-  float phi;
-  float r;
-  float psi;
-  float psi_integral;
-  float w_dot;
-  float w;
-  float x_dot;
-  float x;
-  float x_integral;
-  float z;
-  float z_integral;
-} feedback_gains_ = { 0 };
-
-static struct Limits {
-  float heading_rate;
-  float heading_error;
-} limits_ = { 0 };
-
-static struct KalmanCoeffiecients {
-  float A11;
-  float A13;
-  float A21;
-  float A23;
-  float B11;
-  float B21;
-  float K[3][2];
-} kalman_coefficients_ = { 0 };
-
-static struct KalmanState {
-  float p_dot;
-  float p;
-  float p_dot_bias;
-  float q_dot;
-  float q;
-  float q_dot_bias;
-  float p_pv;
-  float q_pv;
-} kalman_state_ = { 0 };
-
-static struct Model {
-  float angular_acceleration[3];
-  float angular_rate[3];
-  float eular_angles[3];
-  float vertical_acceleration;
-  float velocity[3];
-  float position[3];
-} model_ = { 0 };
-
-static struct PositionControlState {
-  float position_cmd[3];
-  float position_integral[3];
-  float heading_cmd;
-  float heading_integral;
-  float takeoff_thrust_residual;
-  int16_t hover_thrust_stick;
-  uint8_t control_mode_pv;
-} position_control_state_ = { 0 };
-
-// TODO: make some of these local to Control()
-static float angular_cmd_[3] = { 0.0 };
-static float heading_cmd_ = 0.0, thrust_cmd_ = 0.0;
-static float nav_g_b_cmd_[2] = { 0.0 }, nav_thrust_cmd_ = 0.0;
-static float quat_cmd_[4];  // Target attitude in quaternion
-
-
-static float k_motor_lag_ = 0.0;
-static float k_x_velocity_to_position_error_ = 0.0,
-  k_x_position_error_to_velocity_ = 0.0,
-  k_z_velocity_to_position_error_ = 0.0,
-  k_z_position_error_to_velocity_ = 0.0,
-  k_horizontal_limit_to_vertical_limit = 0.0,
-  k_vertical_limit_to_horizontal_limit = 0.0;
-static uint16_t setpoints_[MAX_MOTORS] = { 0 };
+static struct ControlContext control_ = { 0 };
+static volatile uint8_t rate_loop_inhibited_ = 0;
 
 
 // =============================================================================
 // Private function declarations:
 
-static void CommandsForPositionControl(const struct FeedbackGains * k,
-  const struct Limits * limit, float g_b_cmd[2], float * heading_cmd,
-  float * heading_rate_cmd, float * thrust_cmd, struct Model * model,
-  struct PositionControlState * state);
-static void CommandsFromSticks(float g_b_cmd[2], float * heading_cmd,
-  float * heading_rate_cmd, float * thrust_cmd);
-static void FormAngularCommand(const float quat_cmd[4],
-  float heading_rate_cmd, const struct KalmanState * kalman,
+static void CommandsForPositionControl(struct ControlContext * c,
+  const struct AttitudeContext * attitude, float g_b_cmd[2],
+  float * heading_cmd, float * heading_rate_cmd, float * thrust_cmd);
+static void CommandsFromSticks(const struct AttitudeContext * attitude,
+  float g_b_cmd[2], float * heading_cmd, float * heading_rate_cmd,
+  float * thrust_cmd);
+static void FormAngularCommand(const struct RateLoopCommand * cmd,
+  const float angular_rate[3], const struct KalmanState * kalman,
   const struct FeedbackGains * k, float angular_cmd[3]);
-static void QuaternionFromGravityAndHeadingCommand(const float g_b_cmd[2],
-  const struct Limits * limit, float heading_cmd, float quat_cmd[4]);
+static void FormRateLoopCommand(const struct AttitudeContext * attitude,
+  const float quat_cmd[4], float heading_rate_cmd,
+  const struct FeedbackGains * k, struct RateLoopCommand * cmd);
+static float ReadRateLoopOutput(const float * output);
 static void ResetModel(const float position[3], const float velocity[3],
   struct Model * m);
+static void SetKalmanPrediction(float k_motor_lag, float dt,
+  struct KalmanCoeffiecients * k);
 static void UpdateKalmanFilter(const float angular_cmd[3],
+  const float angular_rate[3], uint8_t correct,
   const struct KalmanCoeffiecients * k, struct KalmanState * x);
 static void UpdateModel(const float position_cmd[3],
   const float velocity_cmd[3], const struct FeedbackGains * k,
-  struct Model * m);
+  float k_motor_lag, struct Model * m);
 
 
 // =============================================================================
 // Accessors:
 
+struct ControlContext * DefaultControlContext(void)
+{
+  return &control_;
+}
+
+// -----------------------------------------------------------------------------
 float AngularCommand(enum BodyAxes axis)
 {
-  return angular_cmd_[axis];
+  return ReadRateLoopOutput(&control_.angular_cmd[axis]);
 }
 
 // -----------------------------------------------------------------------------
 float HeadingCommand(void)
 {
-  return heading_cmd_;
+  return control_.heading_cmd;
 }
 
 // -----------------------------------------------------------------------------
 float KalmanP(void)
 {
-  return kalman_state_.p;
+  return ReadRateLoopOutput(&control_.kalman_state.p);
 }
 
 // -----------------------------------------------------------------------------
 float KalmanPDot(void)
 {
-  return kalman_state_.p_dot;
+  return ReadRateLoopOutput(&control_.kalman_state.p_dot);
 }
 
 // -----------------------------------------------------------------------------
 float KalmanQ(void)
 {
-  return kalman_state_.q;
+  return ReadRateLoopOutput(&control_.kalman_state.q);
 }
 
 // -----------------------------------------------------------------------------
 float KalmanQDot(void)
 {
-  return kalman_state_.q_dot;
+  return ReadRateLoopOutput(&control_.kalman_state.q_dot);
 }
 
 // -----------------------------------------------------------------------------
 uint16_t MotorSetpoint(uint8_t n)
 {
-  return setpoints_[n];
+  // Written by the rate loop, which may interrupt the read.
+  uint16_t setpoint;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { setpoint = control_.setpoints[n]; }
+  return setpoint;
 }
 
 // -----------------------------------------------------------------------------
 const float * NavGBCommand(void)
 {
-  return nav_g_b_cmd_;
+  return control_.nav_g_b_cmd;
 }
 
 // -----------------------------------------------------------------------------
 float NavThrustCommand(void)
 {
-  return nav_thrust_cmd_;
+  return control_.nav_thrust_cmd;
 }
 
 // -----------------------------------------------------------------------------
 const float * QuatCommandVector(void)
 {
-  return quat_cmd_;
+  return control_.quat_cmd;
 }
 
 // -----------------------------------------------------------------------------
 float ThrustCommand(void)
 {
-  return thrust_cmd_;
+  return control_.thrust_cmd;
 }
 
 
@@ -232,277 +175,362 @@ float ThrustCommand(void)
 
 void ControlInit(void)
 {
-  eeprom_read_block((void*)actuation_inverse_,
-    (const void*)&eeprom.actuation_inverse[0][0], sizeof(actuation_inverse_));
+  // Keep the rate loop from running on a partly initialized controller. (The
+  // atomic blocks also keep the compiler from moving the initialization out
+  // from between them.)
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { rate_loop_inhibited_ = 1; }
+  InitControlContext(&control_);
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { rate_loop_inhibited_ = 0; }
+}
+
+// -----------------------------------------------------------------------------
+// This function clears the Kalman filter of the default controller's rate
+// loop, so that it restarts from rest (see PreflightInit()). It should be
+// called with the rate loop stopped.
+void ResetRateLoop(void)
+{
+  control_.kalman_state = (struct KalmanState){ 0 };
+}
+
+// -----------------------------------------------------------------------------
+// This function loads the actuation inverse from EEPROM into "c" and sets the
+// gains of the airframe selected at build time.
+void InitControlContext(struct ControlContext * c)
+{
+  eeprom_read_block((void*)c->actuation_inverse,
+    (const void*)&eeprom.actuation_inverse[0][0], sizeof(c->actuation_inverse));
 
   // TODO: remove these temporary initializations and replace computations.
 #if defined BI_OCTO
   // control proportion: 0.400000
-  feedback_gains_.p_dot = 5.532231665e-01;
-  feedback_gains_.p = 1.503704565e+01;
-  feedback_gains_.phi = 5.590657197e+01;
-  feedback_gains_.r = 2.664374986e+00;
-  feedback_gains_.psi = 3.731358603e+00;
-
-  feedback_gains_.psi_integral = 1.742256838e+00 * DT / feedback_gains_.psi;
-
-  feedback_gains_.x_dot = 0.18;
-  feedback_gains_.x = 0.135;
-  feedback_gains_.x_integral = 0.045 * DT;
-
-  feedback_gains_.w_dot = 0.0;
-  feedback_gains_.w = 2.0;
-  feedback_gains_.z = 1.5;
-  feedback_gains_.z_integral = 0.45 * DT * actuation_inverse_[0][3];
-
-  kalman_coefficients_.A11 = 8.943955582e-01;
-  kalman_coefficients_.A13 = 7.392310928e-03;
-  kalman_coefficients_.A21 = 7.392310928e-03;
-  kalman_coefficients_.A23 = 2.941323505e-05;
-  kalman_coefficients_.B11 = 1.056044418e-01;
-  kalman_coefficients_.B21 = 4.201890722e-04;
-  kalman_coefficients_.K[0][0] = 7.736180483e-03;
-  kalman_coefficients_.K[0][1] = 6.465227478e+00;
-  kalman_coefficients_.K[1][0] = 1.973030846e-04;
-  kalman_coefficients_.K[1][1] = 2.905144232e-01;
-  kalman_coefficients_.K[2][0] = 2.225348506e-01;
-  kalman_coefficients_.K[2][1] = 1.470361439e+02;
-
-  k_motor_lag_ = 1.0 / 0.07;
+  c->feedback_gains.p_dot = 5.532231665e-01;
+  c->feedback_gains.p = 1.503704565e+01;
+  c->feedback_gains.phi = 5.590657197e+01;
+  c->feedback_gains.r = 2.664374986e+00;
+  c->feedback_gains.psi = 3.731358603e+00;
+
+  c->feedback_gains.psi_integral = 1.742256838e+00 * DT / c->feedback_gains.psi;
+
+  c->feedback_gains.x_dot = 0.18;
+  c->feedback_gains.x = 0.135;
+  c->feedback_gains.x_integral = 0.045 * DT;
+
+  c->feedback_gains.w_dot = 0.0;
+  c->feedback_gains.w = 2.0;
+  c->feedback_gains.z = 1.5;
+  c->feedback_gains.z_integral = 0.45 * DT * c->actuation_inverse[0][3];
+
+  c->kalman_coefficients.K[0][0] = 7.736180483e-03;
+  c->kalman_coefficients.K[0][1] = 6.465227478e+00;
+  c->kalman_coefficients.K[1][0] = 1.973030846e-04;
+  c->kalman_coefficients.K[1][1] = 2.905144232e-01;
+  c->kalman_coefficients.K[2][0] = 2.225348506e-01;
+  c->kalman_coefficients.K[2][1] = 1.470361439e+02;
+
+  c->k_motor_lag = 1.0 / 0.07;
 #elif defined BI_QUAD
-  feedback_gains_.p_dot = +6.558822907e-01;
-  feedback_gains_.p = +1.709045882e+01;
-  feedback_gains_.phi = +6.774069832e+01;
-  feedback_gains_.r = +2.962652898e+00;
-  feedback_gains_.psi = +4.651437048e+00;
-
-  feedback_gains_.psi_integral = +2.297100566e+00 * DT / feedback_gains_.psi;
-
-  feedback_gains_.x_dot = 0.17;
-  feedback_gains_.x = 0.1;
-  feedback_gains_.x_integral = 0.02 * DT;
-
-  feedback_gains_.w_dot = +0.000000000e+00;
-  feedback_gains_.w = +2.700000000e+00;
-  feedback_gains_.z = +2.300000000e+00;
-  feedback_gains_.z_integral = +1.424969065e+00 * DT * actuation_inverse_[0][3];
-
-  kalman_coefficients_.A11 = +8.943955582e-01;
-  kalman_coefficients_.A13 = +7.392310928e-03;
-  kalman_coefficients_.A21 = +7.392310928e-03;
-  kalman_coefficients_.A23 = +2.941323505e-05;
-  kalman_coefficients_.B11 = +1.056044418e-01;
-  kalman_coefficients_.B21 = +4.201890722e-04;
-  kalman_coefficients_.K[0][0] = +7.736180483e-03;
-  kalman_coefficients_.K[0][1] = +6.465227478e+00;
-  kalman_coefficients_.K[1][0] = +1.973030846e-04;
-  kalman_coefficients_.K[1][1] = +2.905144232e-01;
-  kalman_coefficients_.K[2][0] = +2.225348506e-01;
-  kalman_coefficients_.K[2][1] = +1.470361439e+02;
-
-  k_motor_lag_ = 1.0 / 0.07;
+  c->feedback_gains.p_dot = +6.558822907e-01;
+  c->feedback_gains.p = +1.709045882e+01;
+  c->feedback_gains.phi = +6.774069832e+01;
+  c->feedback_gains.r = +2.962652898e+00;
+  c->feedback_gains.psi = +4.651437048e+00;
+
+  c->feedback_gains.psi_integral = +2.297100566e+00 * DT
+    / c->feedback_gains.psi;
+
+  c->feedback_gains.x_dot = 0.17;
+  c->feedback_gains.x = 0.1;
+  c->feedback_gains.x_integral = 0.02 * DT;
+
+  c->feedback_gains.w_dot = +0.000000000e+00;
+  c->feedback_gains.w = +2.700000000e+00;
+  c->feedback_gains.z = +2.300000000e+00;
+  c->feedback_gains.z_integral = +1.424969065e+00 * DT
+    * c->actuation_inverse[0][3];
+
+  c->kalman_coefficients.K[0][0] = +7.736180483e-03;
+  c->kalman_coefficients.K[0][1] = +6.465227478e+00;
+  c->kalman_coefficients.K[1][0] = +1.973030846e-04;
+  c->kalman_coefficients.K[1][1] = +2.905144232e-01;
+  c->kalman_coefficients.K[2][0] = +2.225348506e-01;
+  c->kalman_coefficients.K[2][1] = +1.470361439e+02;
+
+  c->k_motor_lag = 1.0 / 0.07;
 #elif defined HEXA690
   // control proportion: 0.500000
-  feedback_gains_.p_dot = +1.077064337e+00;
-  feedback_gains_.p = +2.689024117e+01;
-  feedback_gains_.phi = +1.336937583e+02;
-  feedback_gains_.r = +4.270252606e+00;
-  feedback_gains_.psi = +1.105450976e+01;
-
-  feedback_gains_.psi_integral = +7.547131788e+00 * DT / feedback_gains_.psi;
-
-  feedback_gains_.x_dot = 0.17;
-  feedback_gains_.x = 0.1;
-  feedback_gains_.x_integral = 0.02 * DT;
-
-  feedback_gains_.w_dot = +0.000000000e+00;
-  feedback_gains_.w = +4.2e+00;
-  feedback_gains_.z = +5.7e+00;
-  feedback_gains_.z_integral = +3.0e+00 * DT * actuation_inverse_[0][3];
-
-  kalman_coefficients_.A11 = +8.943955582e-01;
-  kalman_coefficients_.A13 = +7.392310928e-03;
-  kalman_coefficients_.A21 = +7.392310928e-03;
-  kalman_coefficients_.A23 = +2.941323505e-05;
-  kalman_coefficients_.B11 = +1.056044418e-01;
-  kalman_coefficients_.B21 = +4.201890722e-04;
-  kalman_coefficients_.K[0][0] = +7.736180483e-03;
-  kalman_coefficients_.K[0][1] = +6.465227478e+00;
-  kalman_coefficients_.K[1][0] = +1.973030846e-04;
-  kalman_coefficients_.K[1][1] = +2.905144232e-01;
-  kalman_coefficients_.K[2][0] = +2.225348506e-01;
-  kalman_coefficients_.K[2][1] = +1.470361439e+02;
-
-  k_motor_lag_ = 1.0 / 0.07;
+  c->feedback_gains.p_dot = +1.077064337e+00;
+  c->feedback_gains.p = +2.689024117e+01;
+  c->feedback_gains.phi = +1.336937583e+02;
+  c->feedback_gains.r = +4.270252606e+00;
+  c->feedback_gains.psi = +1.105450976e+01;
+
+  c->feedback_gains.psi_integral = +7.547131788e+00 * DT
+    / c->feedback_gains.psi;
+
+  c->feedback_gains.x_dot = 0.17;
+  c->feedback_gains.x = 0.1;
+  c->feedback_gains.x_integral = 0.02 * DT;
+
+  c->feedback_gains.w_dot = +0.000000000e+00;
+  c->feedback_gains.w = +4.2e+00;
+  c->feedback_gains.z = +5.7e+00;
+  c->feedback_gains.z_integral = +3.0e+00 * DT * c->actuation_inverse[0][3];
+
+  c->kalman_coefficients.K[0][0] = +7.736180483e-03;
+  c->kalman_coefficients.K[0][1] = +6.465227478e+00;
+  c->kalman_coefficients.K[1][0] = +1.973030846e-04;
+  c->kalman_coefficients.K[1][1] = +2.905144232e-01;
+  c->kalman_coefficients.K[2][0] = +2.225348506e-01;
+  c->kalman_coefficients.K[2][1] = +1.470361439e+02;
+
+  c->k_motor_lag = 1.0 / 0.07;
 #elif defined QUAD475_12
   // control proportion: 0.500000
-  feedback_gains_.p_dot = +1.523148685e+00;
-  feedback_gains_.p = +3.968080612e+01;
-  feedback_gains_.phi = +2.396568328e+02;
-  feedback_gains_.r = +5.005760432e+00;
-  feedback_gains_.psi = +1.654149185e+01;
-
-  feedback_gains_.psi_integral = +1.342291242e+01 * DT / feedback_gains_.psi;
-
-  feedback_gains_.x_dot = 0.17;
-  feedback_gains_.x = 0.1;
-  feedback_gains_.x_integral = 0.02 * DT;
-
-  feedback_gains_.w_dot = 0.0;
-  feedback_gains_.w = 4.7;
-  feedback_gains_.z = 5.6;
-  feedback_gains_.z_integral = 3.4 * DT * actuation_inverse_[0][3];
-
-  kalman_coefficients_.A11 = +8.943955582e-01;
-  kalman_coefficients_.A13 = +7.392310928e-03;
-  kalman_coefficients_.A21 = +7.392310928e-03;
-  kalman_coefficients_.A23 = +2.941323505e-05;
-  kalman_coefficients_.B11 = +1.056044418e-01;
-  kalman_coefficients_.B21 = +4.201890722e-04;
-  kalman_coefficients_.K[0][0] = +7.736180483e-03;
-  kalman_coefficients_.K[0][1] = +6.465227478e+00;
-  kalman_coefficients_.K[1][0] = +1.973030846e-04;
-  kalman_coefficients_.K[1][1] = +2.905144232e-01;
-  kalman_coefficients_.K[2][0] = +2.225348506e-01;
-  kalman_coefficients_.K[2][1] = +1.470361439e+02;
-
-  k_motor_lag_ = 1.0 / 0.07;
+  c->feedback_gains.p_dot = +1.523148685e+00;
+  c->feedback_gains.p = +3.968080612e+01;
+  c->feedback_gains.phi = +2.396568328e+02;
+  c->feedback_gains.r = +5.005760432e+00;
+  c->feedback_gains.psi = +1.654149185e+01;
+
+  c->feedback_gains.psi_integral = +1.342291242e+01 * DT
+    / c->feedback_gains.psi;
+
+  c->feedback_gains.x_dot = 0.17;
+  c->feedback_gains.x = 0.1;
+  c->feedback_gains.x_integral = 0.02 * DT;
+
+  c->feedback_gains.w_dot = 0.0;
+  c->feedback_gains.w = 4.7;
+  c->feedback_gains.z = 5.6;
+  c->feedback_gains.z_integral = 3.4 * DT * c->actuation_inverse[0][3];
+
+  c->kalman_coefficients.K[0][0] = +7.736180483e-03;
+  c->kalman_coefficients.K[0][1] = +6.465227478e+00;
+  c->kalman_coefficients.K[1][0] = +1.973030846e-04;
+  c->kalman_coefficients.K[1][1] = +2.905144232e-01;
+  c->kalman_coefficients.K[2][0] = +2.225348506e-01;
+  c->kalman_coefficients.K[2][1] = +1.470361439e+02;
+
+  c->k_motor_lag = 1.0 / 0.07;
 #elif defined SMALL_QUAD
   // control proportion: 0.500000
-  feedback_gains_.p_dot = +2.690295082e+00;
-  feedback_gains_.p = +5.941758937e+01;
-  feedback_gains_.phi = +3.674012659e+02;
-  feedback_gains_.r = +4.921024667e+00;
-  feedback_gains_.psi = +1.786057092e+01;
-
-  feedback_gains_.x_dot = 0.18;
-  feedback_gains_.x = 0.135;
-  feedback_gains_.x_integral = 0.045 * DT;
-
-  feedback_gains_.w_dot = 5.091813030e-03;
-  feedback_gains_.w = 4.407621675e+00;
-  feedback_gains_.z = 7.422916434e+00;
-  feedback_gains_.z_integral = 4.854441330e+00 * DT * actuation_inverse_[0][3];
-
-  kalman_coefficients_.A11 = 9.248488132e-01;
-  kalman_coefficients_.A13 = 7.515118678e-03;
-  kalman_coefficients_.A21 = 7.515118678e-03;
-  kalman_coefficients_.A23 = 2.973813216e-05;
-  kalman_coefficients_.B11 = 7.515118678e-02;
-  kalman_coefficients_.B21 = 2.973813216e-04;
-  kalman_coefficients_.K[0][0] = 9.136779251e-03;
-  kalman_coefficients_.K[0][1] = 7.278503516e+00;
-  kalman_coefficients_.K[1][0] = 2.221222997e-04;
-  kalman_coefficients_.K[1][1] = 3.062778776e-01;
-  kalman_coefficients_.K[2][0] = 2.359221725e-01;
-  kalman_coefficients_.K[2][1] = 1.445698341e+02;
-
-  k_motor_lag_ = 1.0 / 0.1;
+  c->feedback_gains.p_dot = +2.690295082e+00;
+  c->feedback_gains.p = +5.941758937e+01;
+  c->feedback_gains.phi = +3.674012659e+02;
+  c->feedback_gains.r = +4.921024667e+00;
+  c->feedback_gains.psi = +1.786057092e+01;
+
+  c->feedback_gains.x_dot = 0.18;
+  c->feedback_gains.x = 0.135;
+  c->feedback_gains.x_integral = 0.045 * DT;
+
+  c->feedback_gains.w_dot = 5.091813030e-03;
+  c->feedback_gains.w = 4.407621675e+00;
+  c->feedback_gains.z = 7.422916434e+00;
+  c->feedback_gains.z_integral = 4.854441330e+00 * DT
+    * c->actuation_inverse[0][3];
+
+  c->kalman_coefficients.K[0][0] = 9.136779251e-03;
+  c->kalman_coefficients.K[0][1] = 7.278503516e+00;
+  c->kalman_coefficients.K[1][0] = 2.221222997e-04;
+  c->kalman_coefficients.K[1][1] = 3.062778776e-01;
+  c->kalman_coefficients.K[2][0] = 2.359221725e-01;
+  c->kalman_coefficients.K[2][1] = 1.445698341e+02;
+
+  c->k_motor_lag = 1.0 / 0.1;
 #else  // Large quad
   // control proportion: 0.500000
-  feedback_gains_.p_dot = +1.432616077e+00;
-  feedback_gains_.p = +3.688433387e+01;
-  feedback_gains_.phi = +2.147741471e+02;
-  feedback_gains_.r = +5.240313279e+00;
-  feedback_gains_.psi = +1.623500801e+01;
-
-  feedback_gains_.psi_integral = +1.356024132e+01 * DT / feedback_gains_.psi;
-
-  feedback_gains_.x_dot = 0.21;
-  feedback_gains_.x = 0.15;
-  feedback_gains_.x_integral = 0.045 * DT;
-
-  feedback_gains_.w_dot = +0.000000000e+00;
-  feedback_gains_.w = +2.200000000e+00;
-  feedback_gains_.z = +2.000000000e+00;
-  feedback_gains_.z_integral = +1.225890194e+00 * DT * actuation_inverse_[0][3];
-
-  kalman_coefficients_.A11 = 8.943955582e-01;
-  kalman_coefficients_.A13 = 7.392310928e-03;
-  kalman_coefficients_.A21 = 7.392310928e-03;
-  kalman_coefficients_.A23 = 2.941323505e-05;
-  kalman_coefficients_.B11 = 1.056044418e-01;
-  kalman_coefficients_.B21 = 4.201890722e-04;
-  kalman_coefficients_.K[0][0] = 7.736180483e-03;
-  kalman_coefficients_.K[0][1] = 6.465227478e+00;
-  kalman_coefficients_.K[1][0] = 1.973030846e-04;
-  kalman_coefficients_.K[1][1] = 2.905144232e-01;
-  kalman_coefficients_.K[2][0] = 2.225348506e-01;
-  kalman_coefficients_.K[2][1] = 1.470361439e+02;
-
-  k_motor_lag_ = 1.0 / 0.07;
+  c->feedback_gains.p_dot = +1.432616077e+00;
+  c->feedback_gains.p = +3.688433387e+01;
+  c->feedback_gains.phi = +2.147741471e+02;
+  c->feedback_gains.r = +5.240313279e+00;
+  c->feedback_gains.psi = +1.623500801e+01;
+
+  c->feedback_gains.psi_integral = +1.356024132e+01 * DT
+    / c->feedback_gains.psi;
+
+  c->feedback_gains.x_dot = 0.21;
+  c->feedback_gains.x = 0.15;
+  c->feedback_gains.x_integral = 0.045 * DT;
+
+  c->feedback_gains.w_dot = +0.000000000e+00;
+  c->feedback_gains.w = +2.200000000e+00;
+  c->feedback_gains.z = +2.000000000e+00;
+  c->feedback_gains.z_integral = +1.225890194e+00 * DT
+    * c->actuation_inverse[0][3];
+
+  c->kalman_coefficients.K[0][0] = 7.736180483e-03;
+  c->kalman_coefficients.K[0][1] = 6.465227478e+00;
+  c->kalman_coefficients.K[1][0] = 1.973030846e-04;
+  c->kalman_coefficients.K[1][1] = 2.905144232e-01;
+  c->kalman_coefficients.K[2][0] = 2.225348506e-01;
+  c->kalman_coefficients.K[2][1] = 1.470361439e+02;
+
+  c->k_motor_lag = 1.0 / 0.07;
 #endif
 
+  SetKalmanPrediction(c->k_motor_lag, DT_RATE, &c->kalman_coefficients);
+
   // TODO: Handle this actuation inverse in a smarter way.
   // Limit heading and heading rate error to 25% of control authority.
-  limits_.heading_rate = 0.25 * (MAX_CMD - MIN_CMD) / (feedback_gains_.r
-    * fabs(actuation_inverse_[0][2]));
-  limits_.heading_error = 0.25 * (MAX_CMD - MIN_CMD) / (feedback_gains_.psi
-    * fabs(actuation_inverse_[0][2]));
-
-  k_x_velocity_to_position_error_ = feedback_gains_.x_dot / feedback_gains_.x;
-  k_x_position_error_to_velocity_ = 1.0 / k_x_velocity_to_position_error_;
-  k_z_velocity_to_position_error_ = feedback_gains_.w / feedback_gains_.z;
-  k_z_position_error_to_velocity_ = 1.0 / k_z_velocity_to_position_error_;
-  k_horizontal_limit_to_vertical_limit = feedback_gains_.w / feedback_gains_.z
-    / k_x_velocity_to_position_error_;
-  k_vertical_limit_to_horizontal_limit = 1.0
-    / k_horizontal_limit_to_vertical_limit;
+  c->limits.heading_rate = 0.25 * (MAX_CMD - MIN_CMD) / (c->feedback_gains.r
+    * fabs(c->actuation_inverse[0][2]));
+  c->limits.heading_error = 0.25 * (MAX_CMD - MIN_CMD) / (c->feedback_gains.psi
+    * fabs(c->actuation_inverse[0][2]));
+
+  c->k_x_velocity_to_position_error = c->feedback_gains.x_dot
+    / c->feedback_gains.x;
+  c->k_x_position_error_to_velocity = 1.0 / c->k_x_velocity_to_position_error;
+  c->k_z_velocity_to_position_error = c->feedback_gains.w / c->feedback_gains.z;
+  c->k_z_position_error_to_velocity = 1.0 / c->k_z_velocity_to_position_error;
+  c->k_horizontal_limit_to_vertical_limit = c->feedback_gains.w
+    / c->feedback_gains.z / c->k_x_velocity_to_position_error;
+  c->k_vertical_limit_to_horizontal_limit = 1.0
+    / c->k_horizontal_limit_to_vertical_limit;
 }
 
 // -----------------------------------------------------------------------------
 void Control(void)
+{
+  UpdateControlContext(&control_, DefaultAttitudeContext());
+}
+
+// -----------------------------------------------------------------------------
+void RateControl(void)
+{
+  if (rate_loop_inhibited_) return;
+
+  float angular_rate[3];
+  ReadAngularRate(angular_rate);
+  UpdateRateLoop(&control_, angular_rate);
+
+  if (MotorsRunning())
+    for (uint8_t i = NMotors(); i--; )
+      SetMotorSetpoint(i, control_.setpoints[i]);
+  else if (MotorsStarting())
+    for (uint8_t i = NMotors(); i--; ) SetMotorSetpoint(i, STARTING_SETPOINT);
+  else
+    for (uint8_t i = NMotors(); i--; ) SetMotorSetpoint(i, 0);
+
+  TxMotorSetpoints();
+}
+
+// -----------------------------------------------------------------------------
+// This function runs the outer loop of "c": it computes the target attitude
+// from the sticks, the nav commands, and the attitude estimate in "attitude",
+// and hands the resulting commands to the rate loop (see UpdateRateLoop()).
+void UpdateControlContext(struct ControlContext * c,
+  const struct AttitudeContext * attitude)
 {
   float g_b_cmd[2];  // Target x and y components of the gravity vector in body
   float heading_rate_cmd;
 
   // Derive a target attitude from the position of the sticks.
-  CommandsFromSticks(g_b_cmd, &heading_cmd_, &heading_rate_cmd, &thrust_cmd_);
-  CommandsForPositionControl(&feedback_gains_, &limits_, nav_g_b_cmd_,
-    &heading_cmd_, &heading_rate_cmd, &nav_thrust_cmd_, &model_,
-    &position_control_state_);
-
-  g_b_cmd[0] += nav_g_b_cmd_[0];
-  g_b_cmd[1] += nav_g_b_cmd_[1];
-  thrust_cmd_ += nav_thrust_cmd_;
-
-  QuaternionFromGravityAndHeadingCommand(g_b_cmd, &limits_, heading_cmd_,
-    quat_cmd_);
+  CommandsFromSticks(attitude, g_b_cmd, &c->heading_cmd, &heading_rate_cmd,
+    &c->thrust_cmd);
+  CommandsForPositionControl(c, attitude, c->nav_g_b_cmd, &c->heading_cmd,
+    &heading_rate_cmd, &c->nav_thrust_cmd);
+
+  g_b_cmd[0] += c->nav_g_b_cmd[0];
+  g_b_cmd[1] += c->nav_g_b_cmd[1];
+  c->thrust_cmd += c->nav_thrust_cmd;
+
+  QuaternionFromGravityAndHeadingCommand(attitude, g_b_cmd, &c->limits,
+    c->heading_cmd, c->quat_cmd);
+
+  struct RateLoopCommand rate_loop_cmd;
+  FormRateLoopCommand(attitude, c->quat_cmd, heading_rate_cmd,
+    &c->feedback_gains, &rate_loop_cmd);
+  rate_loop_cmd.thrust = c->thrust_cmd;
+
+  // The rate loop may interrupt the outer loop, so hand over the commands as a
+  // whole.
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { c->rate_loop_cmd = rate_loop_cmd; }
+}
 
+// -----------------------------------------------------------------------------
+// This function runs one step of the rate loop of "c" with the angular rate
+// measured by the gyros in "angular_rate": it updates the Kalman filter and
+// computes new motor setpoints in "c" from the latest outer loop commands. The
+// setpoints are not sent to the motors.
+void UpdateRateLoop(struct ControlContext * c, const float angular_rate[3])
+{
   // Update the pitch and roll Kalman filters before recomputing the command.
-  UpdateKalmanFilter(angular_cmd_, &kalman_coefficients_, &kalman_state_);
+  // The Kalman gains were designed for one correction per frame, so the filter
+  // only predicts in the other steps.
+  UpdateKalmanFilter(c->angular_cmd, angular_rate, c->rate_step == 0,
+    &c->kalman_coefficients, &c->kalman_state);
+  c->rate_step = (c->rate_step + 1) & (RATE_LOOP_FACTOR - 1);
 
   // Compute a new attitude acceleration command.
   // TODO: separate proportional and integral commands
-  FormAngularCommand(quat_cmd_, heading_rate_cmd, &kalman_state_,
-    &feedback_gains_, angular_cmd_);
+  FormAngularCommand(&c->rate_loop_cmd, angular_rate, &c->kalman_state,
+    &c->feedback_gains, c->angular_cmd);
 
-  int16_t limit = FloatToS16(thrust_cmd_ * 2.0);
+  const float thrust_cmd = c->rate_loop_cmd.thrust;
+  int16_t limit = FloatToS16(thrust_cmd * 2.0);
   if (limit > MAX_CMD) limit = MAX_CMD;
   for (uint8_t i = NMotors(); i--; )
-    setpoints_[i] = (uint16_t)S16Limit(FloatToS16(thrust_cmd_
-      + Vector3Dot(angular_cmd_, actuation_inverse_[i])), MIN_CMD, limit);
-
-  if (MotorsRunning())
-    for (uint8_t i = NMotors(); i--; ) SetMotorSetpoint(i, setpoints_[i]);
-  else if (MotorsStarting())
-    for (uint8_t i = NMotors(); i--; ) SetMotorSetpoint(i, STARTING_SETPOINT);
-  else
-    for (uint8_t i = NMotors(); i--; ) SetMotorSetpoint(i, 0);
-
-  // Update the indicator state before the I2C sequence is started.
-  UpdateIndicator();
-  TxMotorSetpoints();
+    c->setpoints[i] = (uint16_t)S16Limit(FloatToS16(thrust_cmd
+      + Vector3Dot(c->angular_cmd, c->actuation_inverse[i])), MIN_CMD, limit);
 }
 
 // -----------------------------------------------------------------------------
 void SetActuationInverse(float actuation_inverse[MAX_MOTORS][4])
 {
   eeprom_update_block((const void*)actuation_inverse,
-    (void*)&eeprom.actuation_inverse[0][0], sizeof(actuation_inverse_));
+    (void*)&eeprom.actuation_inverse[0][0],
+    sizeof(control_.actuation_inverse));
   ControlInit();
 }
 
+// -----------------------------------------------------------------------------
+// This function converts the combination of the x and y components of a unit
+// vector corresponding to the commanded direction of gravity in the body frame
+// and a heading commanded to a target quaternion. Note that, in the interest of
+// computational efficiency, the heading of the resulting quaternion may not
+// exactly match heading command for attitude commands that are far from level.
+// Also note that the heading error is saturated in this step to avoid an overly
+// large yawing command.
+void QuaternionFromGravityAndHeadingCommand(
+  const struct AttitudeContext * attitude, const float g_b_cmd[2],
+  const struct Limits * limit, float heading_cmd, float quat_cmd[4])
+{
+  // Compute the z component of the gravity vector command.
+  float g_b_cmd_z = sqrt(1.0 - g_b_cmd[X_BODY_AXIS] * g_b_cmd[X_BODY_AXIS]
+    - g_b_cmd[Y_BODY_AXIS] * g_b_cmd[Y_BODY_AXIS]);
+
+  // Form a quaternion from these components (z component is 0).
+  float temp1 = 0.5 + 0.5 * g_b_cmd_z;
+  float quat_g_b_cmd_0 = sqrt(temp1);
+  float temp2 = 1.0 / (2.0 * quat_g_b_cmd_0);
+  float quat_g_b_cmd_x = g_b_cmd[Y_BODY_AXIS] * temp2;
+  float quat_g_b_cmd_y = -g_b_cmd[X_BODY_AXIS] * temp2;
+
+  // Determine the (approximate) heading of this command for removal (optional).
+  float heading_from_g_b_cmd = (quat_g_b_cmd_x * quat_g_b_cmd_y) / (temp1
+    + quat_g_b_cmd_x * quat_g_b_cmd_x - 0.5);
+
+  // Limit the heading error.
+  float heading_error = FloatSLimit(WrapToPlusMinusPi(heading_cmd
+    - attitude->heading_angle), limit->heading_error);
+
+  // Make a second quaternion for the commanded heading minus the residual
+  // heading from the gravity vector command (x and y components are zero).
+  float temp = (attitude->heading_angle + heading_error
+    - heading_from_g_b_cmd) * 0.5;
+  float quat_heading_cmd_0 = cos(temp);
+  float quat_heading_cmd_z = sin(temp);
+
+  // Combine the quaternions (heading rotation first) to form the final
+  // quaternion command.
+  quat_cmd[0] = quat_heading_cmd_0 * quat_g_b_cmd_0;
+  quat_cmd[1] = quat_heading_cmd_0 * quat_g_b_cmd_x - quat_heading_cmd_z
+    * quat_g_b_cmd_y;
+  quat_cmd[2] = quat_heading_cmd_0 * quat_g_b_cmd_y + quat_heading_cmd_z
+    * quat_g_b_cmd_x;
+  quat_cmd[3] = quat_heading_cmd_z * quat_g_b_cmd_0;
+}
 
 // =============================================================================
 // Private functions:
@@ -539,11 +567,14 @@ static float * AttitudeError(const float quat_cmd[4], const float quat[4],
 }
 
 // -----------------------------------------------------------------------------
-static void CommandsForPositionControl(const struct FeedbackGains * k,
-  const struct Limits * limit, float g_b_cmd[2], float * heading_cmd,
-  float * heading_rate_cmd, float * thrust_cmd, struct Model * model,
-  struct PositionControlState * state)
+static void CommandsForPositionControl(struct ControlContext * c,
+  const struct AttitudeContext * attitude, float g_b_cmd[2],
+  float * heading_cmd, float * heading_rate_cmd, float * thrust_cmd)
 {
+  const struct FeedbackGains * k = &c->feedback_gains;
+  const struct Limits * limit = &c->limits;
+  struct Model * model = &c->model;
+  struct PositionControlState * state = &c->position_control_state;
   float position[3] = { 0.0 }, velocity[3] = { 0.0 }, velocity_cmd[3] = { 0.0 };
   float position_error[3] = { 0.0 }, velocity_error[3] = { 0.0 };
   float model_error[3] = { 0.0 };
@@ -581,7 +612,7 @@ static void CommandsForPositionControl(const struct FeedbackGains * k,
       {
         ResetModel(position, velocity, model);
         Vector3Copy(position, state->position_cmd);
-        state->heading_cmd = HeadingAngle();
+        state->heading_cmd = attitude->heading_angle;
       }
 
       // Position:
@@ -612,7 +643,7 @@ static void CommandsForPositionControl(const struct FeedbackGains * k,
       }
 
       // Integrate the difference with the model.
-      UpdateModel(state->position_cmd, velocity_cmd, k, model);
+      UpdateModel(state->position_cmd, velocity_cmd, k, c->k_motor_lag, model);
 
       // Compute the error between the current position / velocity and the
       // command.
@@ -625,7 +656,8 @@ static void CommandsForPositionControl(const struct FeedbackGains * k,
       // Form an integral command based on the difference between the current
       // heading and the rabbit.
       state->heading_integral += FloatSLimit(WrapToPlusMinusPi(
-        state->heading_cmd - HeadingAngle()) * k->psi_integral, M_PI / 12);
+        state->heading_cmd - attitude->heading_angle) * k->psi_integral,
+        M_PI / 12);
 
       // Compute a rate command (at the specified rate) that will move the
       // rabbit toward the target.
@@ -659,7 +691,7 @@ static void CommandsForPositionControl(const struct FeedbackGains * k,
       state->position_cmd[D_WORLD_AXIS] += velocity_cmd[D_WORLD_AXIS] * DT;
 
       // Integrate the difference with the model.
-      UpdateModel(state->position_cmd, velocity_cmd, k, model);
+      UpdateModel(state->position_cmd, velocity_cmd, k, c->k_motor_lag, model);
 
       // Compute the error between the current position / velocity and the
       // command.
@@ -740,14 +772,15 @@ static void CommandsForPositionControl(const struct FeedbackGains * k,
     + state->position_integral[E_WORLD_AXIS];
 
   // Rotate the world commands to the body (assuming small pitch/roll angles).
-  float cos_heading = cos(HeadingAngle()), sin_heading = sin(HeadingAngle());
+  float cos_heading = cos(attitude->heading_angle);
+  float sin_heading = sin(attitude->heading_angle);
   g_b_cmd[X_BODY_AXIS] = cos_heading * a_w_cmd[N_WORLD_AXIS] + sin_heading
     * a_w_cmd[E_WORLD_AXIS];
   g_b_cmd[Y_BODY_AXIS] = cos_heading * a_w_cmd[E_WORLD_AXIS] - sin_heading
     * a_w_cmd[N_WORLD_AXIS];
 
   // TODO: do this actuation inverse in a smarter way.
-  *thrust_cmd = FloatSLimit(actuation_inverse_[0][3] * (
+  *thrust_cmd = FloatSLimit(c->actuation_inverse[0][3] * (
     + k->w_dot * -(-VerticalAcceleration())
     + k->w * velocity_error[D_WORLD_AXIS]
     + k->z * position_error[D_WORLD_AXIS]),
@@ -766,8 +799,9 @@ static void CommandsForPositionControl(const struct FeedbackGains * k,
 // similar to a pitch and roll command, but is actually closer to the intended
 // result and has the benefit of a direct correspondence with linear
 // acceleration.
-static void CommandsFromSticks(float g_b_cmd[2], float * heading_cmd,
-  float * heading_rate_cmd, float * thrust_cmd)
+static void CommandsFromSticks(const struct AttitudeContext * attitude,
+  float g_b_cmd[2], float * heading_cmd, float * heading_rate_cmd,
+  float * thrust_cmd)
 {
   if (SBusStale())
   {
@@ -799,7 +833,7 @@ static void CommandsFromSticks(float g_b_cmd[2], float * heading_cmd,
   }
   else
   {
-    *heading_cmd = HeadingAngle();
+    *heading_cmd = attitude->heading_angle;
   }
   *heading_cmd = WrapToPlusMinusPi(*heading_cmd);
 
@@ -809,77 +843,54 @@ static void CommandsFromSticks(float g_b_cmd[2], float * heading_cmd,
 }
 
 // -----------------------------------------------------------------------------
-static void FormAngularCommand(const float quat_cmd[4],
-  float heading_rate_cmd, const struct KalmanState * kalman,
+// This function applies the angular acceleration and rate gains of the rate
+// loop and adds the attitude term from the outer loop.
+static void FormAngularCommand(const struct RateLoopCommand * cmd,
+  const float angular_rate[3], const struct KalmanState * kalman,
   const struct FeedbackGains * k, float angular_cmd[3])
 {
-  float attitude_error[3];
-  AttitudeError(quat_cmd, Quat(), attitude_error);
-
-  // Transform the yaw rate command into the body axis. Note that yaw rate
-  // happens to occur along the gravity vector, so yaw rate command is a simple
-  // scalar multiplication of the gravity vector.
-  float rate_cmd[3];
-  Vector3Scale(GravityInBodyVector(), heading_rate_cmd, rate_cmd);
-
-  // Apply the control gains.
   angular_cmd[X_BODY_AXIS] =
     + k->p_dot * -kalman->p_dot
-    + k->p * (rate_cmd[X_BODY_AXIS] - AngularRate(X_BODY_AXIS))
-    + k->phi * attitude_error[X_BODY_AXIS];
+    + k->p * (cmd->angular_rate[X_BODY_AXIS] - angular_rate[X_BODY_AXIS])
+    + cmd->attitude_term[X_BODY_AXIS];
   angular_cmd[Y_BODY_AXIS] =
     + k->p_dot * -kalman->q_dot
-    + k->p * (rate_cmd[Y_BODY_AXIS] - AngularRate(Y_BODY_AXIS))
-    + k->phi * attitude_error[Y_BODY_AXIS];
+    + k->p * (cmd->angular_rate[Y_BODY_AXIS] - angular_rate[Y_BODY_AXIS])
+    + cmd->attitude_term[Y_BODY_AXIS];
   angular_cmd[Z_BODY_AXIS] =
-    + k->r * (rate_cmd[Z_BODY_AXIS] - AngularRate(Z_BODY_AXIS))
-    + k->psi * attitude_error[Z_BODY_AXIS];
+    + k->r * (cmd->angular_rate[Z_BODY_AXIS] - angular_rate[Z_BODY_AXIS])
+    + cmd->attitude_term[Z_BODY_AXIS];
 }
 
 // -----------------------------------------------------------------------------
-// This function converts the combination of the x and y components of a unit
-// vector corresponding to the commanded direction of gravity in the body frame
-// and a heading commanded to a target quaternion. Note that, in the interest of
-// computational efficiency, the heading of the resulting quaternion may not
-// exactly match heading command for attitude commands that are far from level.
-// Also note that the heading error is saturated in this step to avoid an overly
-// large yawing command.
-static void QuaternionFromGravityAndHeadingCommand(const float g_b_cmd[2],
-  const struct Limits * limit, float heading_cmd, float quat_cmd[4])
+// This function computes the parts of the angular command that change only
+// once per frame: the angular rate command and the attitude feedback term.
+static void FormRateLoopCommand(const struct AttitudeContext * attitude,
+  const float quat_cmd[4], float heading_rate_cmd,
+  const struct FeedbackGains * k, struct RateLoopCommand * cmd)
 {
-  // Compute the z component of the gravity vector command.
-  float g_b_cmd_z = sqrt(1.0 - g_b_cmd[X_BODY_AXIS] * g_b_cmd[X_BODY_AXIS]
-    - g_b_cmd[Y_BODY_AXIS] * g_b_cmd[Y_BODY_AXIS]);
-
-  // Form a quaternion from these components (z component is 0).
-  float temp1 = 0.5 + 0.5 * g_b_cmd_z;
-  float quat_g_b_cmd_0 = sqrt(temp1);
-  float temp2 = 1.0 / (2.0 * quat_g_b_cmd_0);
-  float quat_g_b_cmd_x = g_b_cmd[Y_BODY_AXIS] * temp2;
-  float quat_g_b_cmd_y = -g_b_cmd[X_BODY_AXIS] * temp2;
-
-  // Determine the (approximate) heading of this command for removal (optional).
-  float heading_from_g_b_cmd = (quat_g_b_cmd_x * quat_g_b_cmd_y) / (temp1
-    + quat_g_b_cmd_x * quat_g_b_cmd_x - 0.5);
+  float attitude_error[3];
+  AttitudeError(quat_cmd, attitude->quat, attitude_error);
 
-  // Limit the heading error.
-  float heading_error = FloatSLimit(WrapToPlusMinusPi(heading_cmd
-    - HeadingAngle()), limit->heading_error);
+  // Transform the yaw rate command into the body axis. Note that yaw rate
+  // happens to occur along the gravity vector, so yaw rate command is a simple
+  // scalar multiplication of the gravity vector.
+  Vector3Scale(attitude->g_b, heading_rate_cmd, cmd->angular_rate);
 
-  // Make a second quaternion for the commanded heading minus the residual
-  // heading from the gravity vector command (x and y components are zero).
-  float temp = (HeadingAngle() + heading_error - heading_from_g_b_cmd) * 0.5;
-  float quat_heading_cmd_0 = cos(temp);
-  float quat_heading_cmd_z = sin(temp);
+  cmd->attitude_term[X_BODY_AXIS] = k->phi * attitude_error[X_BODY_AXIS];
+  cmd->attitude_term[Y_BODY_AXIS] = k->phi * attitude_error[Y_BODY_AXIS];
+  cmd->attitude_term[Z_BODY_AXIS] = k->psi * attitude_error[Z_BODY_AXIS];
+}
 
-  // Combine the quaternions (heading rotation first) to form the final
-  // quaternion command.
-  quat_cmd[0] = quat_heading_cmd_0 * quat_g_b_cmd_0;
-  quat_cmd[1] = quat_heading_cmd_0 * quat_g_b_cmd_x - quat_heading_cmd_z
-    * quat_g_b_cmd_y;
-  quat_cmd[2] = quat_heading_cmd_0 * quat_g_b_cmd_y + quat_heading_cmd_z
-    * quat_g_b_cmd_x;
-  quat_cmd[3] = quat_heading_cmd_z * quat_g_b_cmd_0;
+// -----------------------------------------------------------------------------
+// This function returns an output of the rate loop of control_ (the angular
+// command, Kalman state, and so on), which may be rewritten by the rate loop
+// interrupt in the middle of a read of its four bytes.
+static float ReadRateLoopOutput(const float * output)
+{
+  float value;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { value = *output; }
+  return value;
 }
 
 // -----------------------------------------------------------------------------
@@ -900,6 +911,25 @@ static void ResetModel(const float position[3], const float velocity[3],
   Vector3Copy(position, m->position);
 }
 
+// -----------------------------------------------------------------------------
+// This function sets the prediction coefficients of the Kalman filter to the
+// exact (zero-order hold) discretization over "dt" of a model in which the
+// angular acceleration follows the command through the motor lag and the bias
+// adds to the rate of change of the angular acceleration.
+static void SetKalmanPrediction(float k_motor_lag, float dt,
+  struct KalmanCoeffiecients * k)
+{
+  const float tau = 1.0 / k_motor_lag;
+  const float decay = exp(-dt * k_motor_lag);
+
+  k->A11 = decay;
+  k->B11 = 1.0 - decay;
+  k->A13 = tau * (1.0 - decay);
+  k->A21 = k->A13;
+  k->B21 = dt - k->A21;
+  k->A23 = tau * k->B21;
+}
+
 // -----------------------------------------------------------------------------
 // This function updates a Kalman filter that combines the angular acceleration
 // that is expected given the motor commands and the derivative of the measured
@@ -907,7 +937,10 @@ static void ResetModel(const float position[3], const float velocity[3],
 // angular rate is extremely noisy, resulting in large commands. Note that the
 // process and measurement noise covariances are assumed to be constant and the
 // Kalman gains are pre-computed for the resulting stead-state error covariance.
+// The correction (and the derivative of the measured angular rate) is only
+// computed if "correct" is set, which is once per frame.
 static void UpdateKalmanFilter(const float angular_cmd[3],
+  const float angular_rate[3], uint8_t correct,
   const struct KalmanCoeffiecients * k, struct KalmanState * x)
 {
   // Prediction.
@@ -921,29 +954,31 @@ static void UpdateKalmanFilter(const float angular_cmd[3],
   x->q_dot = k->A11 * x->q_dot + k->A13 * x->q_dot_bias
     + k->B11 * angular_cmd[Y_BODY_AXIS];
 
+  if (!correct) return;
+
   // Correction.
-  float p_dot_err = (AngularRate(X_BODY_AXIS) - x->p_pv) / DT - x->p_dot;
-  float p_err = AngularRate(X_BODY_AXIS) - x->p;
+  float p_dot_err = (angular_rate[X_BODY_AXIS] - x->p_pv) / DT - x->p_dot;
+  float p_err = angular_rate[X_BODY_AXIS] - x->p;
   x->p_dot += k->K[0][0] * p_dot_err + k->K[0][1] * p_err;
   x->p += k->K[1][0] * p_dot_err + k->K[1][1] * p_err;
   x->p_dot_bias += k->K[2][0] * p_dot_err + k->K[2][1] * p_err;
 
-  float q_dot_err = (AngularRate(Y_BODY_AXIS) - x->q_pv) / DT - x->q_dot;
-  float q_err = AngularRate(Y_BODY_AXIS) - x->q;
+  float q_dot_err = (angular_rate[Y_BODY_AXIS] - x->q_pv) / DT - x->q_dot;
+  float q_err = angular_rate[Y_BODY_AXIS] - x->q;
   x->q_dot += k->K[0][0] * q_dot_err + k->K[0][1] * q_err;
   x->q += k->K[1][0] * q_dot_err + k->K[1][1] * q_err;
   x->q_dot_bias += k->K[2][0] * q_dot_err + k->K[2][1] * q_err;
 
   // Save past values
-  x->p_pv = AngularRate(X_BODY_AXIS);
-  x->q_pv = AngularRate(Y_BODY_AXIS);
+  x->p_pv = angular_rate[X_BODY_AXIS];
+  x->q_pv = angular_rate[Y_BODY_AXIS];
 }
 
 // -----------------------------------------------------------------------------
 // Simple linear decoupled model of position in NED frame with zero heading.
 static void UpdateModel(const float position_cmd[3],
   const float velocity_cmd[3], const struct FeedbackGains * k,
-  struct Model * m)
+  float k_motor_lag, struct Model * m)
 {
   float position_error[3], velocity_error[3];
   Vector3Subtract(position_cmd, m->position, position_error);
@@ -973,7 +1008,7 @@ static void UpdateModel(const float position_cmd[3],
     + k->p * -m->angular_rate[Y_BODY_AXIS]
     + k->phi * (-a_w_cmd[N_WORLD_AXIS] - m->eular_angles[Y_BODY_AXIS]);
 
-  float p_dot_dot = k_motor_lag_ * (angular_cmd[X_BODY_AXIS]
+  float p_dot_dot = k_motor_lag * (angular_cmd[X_BODY_AXIS]
     - m->angular_acceleration[X_BODY_AXIS]);
   m->angular_acceleration[X_BODY_AXIS] += p_dot_dot * DT;
   m->angular_rate[X_BODY_AXIS] += m->angular_acceleration[X_BODY_AXIS] * DT;
@@ -982,7 +1017,7 @@ static void UpdateModel(const float position_cmd[3],
     * GRAVITY_ACCELERATION * DT;
   m->position[E_WORLD_AXIS] += m->velocity[E_WORLD_AXIS] * DT;
 
-  float q_dot_dot = k_motor_lag_ * (angular_cmd[Y_BODY_AXIS]
+  float q_dot_dot = k_motor_lag * (angular_cmd[Y_BODY_AXIS]
     - m->angular_acceleration[Y_BODY_AXIS]);
   m->angular_acceleration[Y_BODY_AXIS] += q_dot_dot * DT;
   m->angular_rate[Y_BODY_AXIS] += m->angular_acceleration[Y_BODY_AXIS] * DT;
@@ -993,7 +1028,7 @@ static void UpdateModel(const float position_cmd[3],
 
   // TODO: make the direction of vertical_acceleration consistent with
   // vertical_speed (from pressure altitude)
-  float w_dot_dot = k_motor_lag_ * (a_w_cmd[D_WORLD_AXIS]
+  float w_dot_dot = k_motor_lag * (a_w_cmd[D_WORLD_AXIS]
     - m->vertical_acceleration);
   m->vertical_acceleration += w_dot_dot * DT;
   m->velocity[D_WORLD_AXIS] += m->vertical_acceleration * DT;
@@ -4,12 +4,119 @@
 
 #include <inttypes.h>
 
+#include "attitude.h"
 #include "main.h"
 
 
+struct FeedbackGains {
+  float p_dot;
+  float p;
+  float phi;
+  float r;
+  float psi;
+  float psi_integral;
+  float w_dot;
+  float w;
+  float x_dot;
+  float x;
+  float x_integral;
+  float z;
+  float z_integral;
+};
+
+struct Limits {
+  float heading_rate;
+  float heading_error;
+};
+
+// The prediction coefficients (A and B) are for one step of the rate loop
+// (DT_RATE) and the gains (K) are for one correction per frame (DT).
+struct KalmanCoeffiecients {
+  float A11;
+  float A13;
+  float A21;
+  float A23;
+  float B11;
+  float B21;
+  float K[3][2];
+};
+
+struct KalmanState {
+  float p_dot;
+  float p;
+  float p_dot_bias;
+  float q_dot;
+  float q;
+  float q_dot_bias;
+  float p_pv;
+  float q_pv;
+};
+
+struct Model {
+  float angular_acceleration[3];
+  float angular_rate[3];
+  float eular_angles[3];
+  float vertical_acceleration;
+  float velocity[3];
+  float position[3];
+};
+
+// The commands that the outer loop hands to the rate loop once per frame.
+struct RateLoopCommand {
+  float angular_rate[3];  // Body-axis angular rate command (rad/s)
+  float attitude_term[3];  // Attitude feedback part of the angular command
+  float thrust;
+};
+
+struct PositionControlState {
+  float position_cmd[3];
+  float position_integral[3];
+  float heading_cmd;
+  float heading_integral;
+  float takeoff_thrust_residual;
+  int16_t hover_thrust_stick;
+  uint8_t control_mode_pv;
+};
+
+// The complete state of the controller. The firmware keeps a single instance
+// (see DefaultControlContext()), but any number can be initialized and updated
+// independently, for example to compare gain sets on the host.
+struct ControlContext {
+  // Computed constants.
+  float actuation_inverse[MAX_MOTORS][4];
+  struct FeedbackGains feedback_gains;
+  struct Limits limits;
+  struct KalmanCoeffiecients kalman_coefficients;
+  float k_motor_lag;
+  float k_x_velocity_to_position_error;
+  float k_x_position_error_to_velocity;
+  float k_z_velocity_to_position_error;
+  float k_z_position_error_to_velocity;
+  float k_horizontal_limit_to_vertical_limit;
+  float k_vertical_limit_to_horizontal_limit;
+
+  // State.
+  struct KalmanState kalman_state;
+  struct Model model;
+  struct PositionControlState position_control_state;
+  float angular_cmd[3];
+  float heading_cmd;
+  float thrust_cmd;
+  float nav_g_b_cmd[2];
+  float nav_thrust_cmd;
+  float quat_cmd[4];  // Target attitude in quaternion
+  struct RateLoopCommand rate_loop_cmd;
+  uint16_t setpoints[MAX_MOTORS];
+  uint8_t rate_step;  // Rate loop steps run (modulo RATE_LOOP_FACTOR)
+};
+
+
 // =============================================================================
 // Accessors:
 
+struct ControlContext * DefaultControlContext(void);
+
+// -----------------------------------------------------------------------------
 float AngularCommand(enum BodyAxes axis);
 
 // -----------------------------------------------------------------------------
@@ -55,10 +162,38 @@ float ThrustCommand(void);
 void ControlInit(void);
 
 // -----------------------------------------------------------------------------
+// This function clears the Kalman filter of the default controller's rate
+// loop, so that it restarts from rest. It should be called with the rate loop
+// stopped (see StopRateLoop()), for example after the gyros are zeroed.
+void ResetRateLoop(void);
+
+// -----------------------------------------------------------------------------
+void InitControlContext(struct ControlContext * c);
+
+// -----------------------------------------------------------------------------
+// This function runs the outer loop of the default controller once per frame.
 void Control(void);
 
+// -----------------------------------------------------------------------------
+// This function runs one step of the rate loop of the default controller and
+// sends the resulting setpoints to the motors. It is called RATE_LOOP_FACTOR
+// times per frame from the TIMER3 compare interrupt (see scheduler.c).
+void RateControl(void);
+
+// -----------------------------------------------------------------------------
+void UpdateControlContext(struct ControlContext * c,
+  const struct AttitudeContext * attitude);
+
+// -----------------------------------------------------------------------------
+void UpdateRateLoop(struct ControlContext * c, const float angular_rate[3]);
+
 // -----------------------------------------------------------------------------
 void SetActuationInverse(float actuation_inverse[MAX_MOTORS][4]);
 
+// -----------------------------------------------------------------------------
+void QuaternionFromGravityAndHeadingCommand(
+  const struct AttitudeContext * attitude, const float g_b_cmd[2],
+  const struct Limits * limit, float heading_cmd, float quat_cmd[4]);
+
 
 #endif  // CONTROL_H_
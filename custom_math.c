@@ -63,6 +63,12 @@ float FloatMin(float input1, float input2)
   return input1 < input2 ? input1 : input2;
 }
 
+// -----------------------------------------------------------------------------
+float Q16ToFloat(int32_t input)
+{
+  return ldexpf((float)input, -16);
+}
+
 // -----------------------------------------------------------------------------
 int8_t S8Limit(int8_t input, int8_t lower_limit, int8_t upper_limit)
 {
@@ -184,6 +190,12 @@ uint16_t U16RoundRShiftU32(uint32_t input, uint8_t power)
   return (uint16_t)((input + bias) >> power);
 }
 
+// -----------------------------------------------------------------------------
+int32_t S16ScaleToQ16(int16_t input, uint16_t scale)
+{
+  return ((int32_t)input * scale + (1L << 7)) >> 8;
+}
+
 // -----------------------------------------------------------------------------
 float WrapToPlusMinusPi(float angle)
 {
@@ -32,6 +32,12 @@ float FloatMax(float input1, float input2);
 // -----------------------------------------------------------------------------
 float FloatMin(float input1, float input2);
 
+// -----------------------------------------------------------------------------
+// This function converts "input", a fixed-point number with 16 fractional bits
+// (Q16), to a float. Only the exponent is adjusted after the conversion, so it
+// is cheaper than a multiplication by 1/65536.
+float Q16ToFloat(int32_t input);
+
 // -----------------------------------------------------------------------------
 int8_t S8Limit(int8_t input, int8_t lower_limit, int8_t upper_limit);
 
@@ -87,6 +93,13 @@ uint32_t U32RoundRShiftU32(uint32_t input, uint8_t power);
 // Same as above but outputting uint16_t
 uint16_t U16RoundRShiftU32(uint32_t input, uint8_t power);
 
+// -----------------------------------------------------------------------------
+// This function returns "input" multiplied by "scale", which has 24 fractional
+// bits (scale = round(2^24 * factor)), as a fixed-point number with 16
+// fractional bits (Q16), rounded to the nearest. It takes a single 16 by 16 bit
+// integer multiplication. The product must not overflow int32_t.
+int32_t S16ScaleToQ16(int16_t input, uint16_t scale);
+
 // -----------------------------------------------------------------------------
 float WrapToPlusMinusPi(float angle);
 
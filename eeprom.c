@@ -1,5 +1,7 @@
 #include "eeprom.h"
 
+#include "background.h"
+
 
 struct EEPROM EEMEM eeprom = {
   .n_motors = 8,
@@ -15,3 +17,73 @@ struct EEPROM EEMEM eeprom = {
   .sbus_channel_switch = { 4, 12, 13, 14, 15 },
   .sbus_channel_trim = { 8, 9, 10, 11 },
 };
+
+
+// =============================================================================
+// Private data:
+
+#define DEFERRED_QUEUE_LENGTH (64)  // Bytes (a power of 2)
+#define MAX_COMPARES_PER_STEP (16)
+
+struct DeferredByte {
+  uint8_t * destination;
+  uint8_t value;
+};
+
+static struct DeferredByte queue_[DEFERRED_QUEUE_LENGTH];
+static uint8_t queue_head_ = 0, queue_tail_ = 0;  // Counts modulo 256
+
+
+// =============================================================================
+// Public functions:
+
+void DeferredEEPROMUpdate(void * destination, const void * source,
+  uint8_t length)
+{
+  if ((uint8_t)(queue_head_ - queue_tail_) + length > DEFERRED_QUEUE_LENGTH)
+  {
+    while (WriteDeferredEEPROM()) continue;
+    if (length > DEFERRED_QUEUE_LENGTH)
+    {
+      eeprom_update_block(source, destination, length);
+      return;
+    }
+  }
+
+  for (uint8_t i = 0; i < length; i++, queue_head_++)
+  {
+    struct DeferredByte * entry = &queue_[queue_head_
+      % DEFERRED_QUEUE_LENGTH];
+    entry->destination = (uint8_t *)destination + i;
+    entry->value = ((const uint8_t *)source)[i];
+  }
+  RequestBackgroundJob(BACKGROUND_JOB_EEPROM);
+}
+
+// -----------------------------------------------------------------------------
+void DeferredEEPROMUpdateByte(uint8_t * destination, uint8_t value)
+{
+  DeferredEEPROMUpdate(destination, &value, 1);
+}
+
+// -----------------------------------------------------------------------------
+uint8_t WriteDeferredEEPROM(void)
+{
+  // Bytes that are already up to date are skipped without waiting, a limited
+  // number per step.
+  for (uint8_t i = MAX_COMPARES_PER_STEP; i--; )
+  {
+    if (queue_head_ == queue_tail_) return 0;
+    if (!eeprom_is_ready()) return 1;
+
+    const struct DeferredByte * entry = &queue_[queue_tail_
+      % DEFERRED_QUEUE_LENGTH];
+    queue_tail_++;
+    if (eeprom_read_byte(entry->destination) != entry->value)
+    {
+      eeprom_write_byte(entry->destination, entry->value);
+      break;
+    }
+  }
+  return queue_head_ != queue_tail_;
+}
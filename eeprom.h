@@ -37,4 +37,28 @@ extern struct EEPROM {
 } eeprom;
 
 
+// =============================================================================
+// Public functions:
+
+// This function queues an update of "length" bytes at "destination" in EEPROM
+// from "source", to be written in the slack time of the main loop (see
+// background.h) instead of blocking for 3.4 ms for each byte that changes. The
+// data is copied, so "source" may change afterwards. If the queue is full, it
+// is first emptied by blocking writes. Reads from EEPROM return the old values
+// until the writes have been made, so this should only be used for data that
+// is also kept in RAM.
+void DeferredEEPROMUpdate(void * destination, const void * source,
+  uint8_t length);
+
+// -----------------------------------------------------------------------------
+// This function queues an update of a single byte (see DeferredEEPROMUpdate()).
+void DeferredEEPROMUpdateByte(uint8_t * destination, uint8_t value);
+
+// -----------------------------------------------------------------------------
+// This function writes the next queued byte that differs from the EEPROM, if
+// the EEPROM is ready, and returns 1 if there is more to write. It is the step
+// of the EEPROM background job.
+uint8_t WriteDeferredEEPROM(void);
+
+
 #endif  // EEPROM_H_
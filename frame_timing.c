@@ -0,0 +1,256 @@
+#include "frame_timing.h"
+
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "trace.h"
+
+
+// =============================================================================
+// Private data:
+
+struct Accumulator {
+  uint16_t min;
+  uint16_t max;
+  uint32_t sum;
+  uint16_t count;
+};
+
+static struct Accumulator stages_[PROFILE_STAGE_COUNT];
+static struct Accumulator frame_;
+static enum ProfileStage stage_ = PROFILE_STAGE_IDLE;
+static uint16_t stage_start_ = 0, frame_start_ = 0;
+
+static uint16_t latency_histogram_[FRAME_HISTOGRAM_N_BINS];
+static uint16_t completion_histogram_[FRAME_HISTOGRAM_N_BINS];
+static uint16_t overrun_count_ = 0;
+static uint16_t slack_ = 0;  // Of the last frame
+
+// Count of 128 Hz ticks and the count at the tick that triggered the current
+// frame (both modulo 256).
+static volatile uint8_t tick_count_ = 0, trigger_tick_ = 0;
+
+
+// =============================================================================
+// Private function declarations:
+
+static void Accumulate(struct Accumulator * accumulator, uint16_t duration);
+static void AddToHistogram(uint16_t * histogram, uint32_t bin);
+static uint16_t Elapsed(uint16_t start, uint16_t now);
+static uint32_t TimeSinceTrigger(void);
+static struct FrameTimingStatistic Statistic(
+  const struct Accumulator * accumulator);
+
+
+// =============================================================================
+// Accessors:
+
+const uint16_t * FrameCompletionHistogram(void)
+{
+  return completion_histogram_;
+}
+
+// -----------------------------------------------------------------------------
+const uint16_t * FrameLatencyHistogram(void)
+{
+  return latency_histogram_;
+}
+
+// -----------------------------------------------------------------------------
+uint16_t FrameOverrunCount(void)
+{
+  return overrun_count_;
+}
+
+// -----------------------------------------------------------------------------
+uint16_t FrameSlack(void)
+{
+  return slack_;
+}
+
+// -----------------------------------------------------------------------------
+struct FrameTimingStatistic FrameTiming(void)
+{
+  return Statistic(&frame_);
+}
+
+// -----------------------------------------------------------------------------
+uint16_t FrameTimingCount(void)
+{
+  return frame_.count;
+}
+
+// -----------------------------------------------------------------------------
+struct FrameTimingStatistic FrameTimingStage(enum ProfileStage stage)
+{
+  return Statistic(&stages_[stage]);
+}
+
+
+// =============================================================================
+// Public functions:
+
+uint16_t FrameTimingMark(enum ProfileStage stage)
+{
+  // Interrupts are disabled because a handler that reads another 16-bit timer
+  // register (see isr_profile.h) would overwrite the shared TEMP register.
+  uint16_t now;
+  ATOMIC_BLOCK(ATOMIC_FORCEON) { now = TCNT3; }
+
+  uint16_t duration = 0;
+  if (stage_ != PROFILE_STAGE_IDLE)
+  {
+    duration = Elapsed(stage_start_, now);
+    Accumulate(&stages_[stage_], duration);
+  }
+
+  // A frame runs from the first stage after idle to the return to idle.
+  if ((stage != PROFILE_STAGE_IDLE) && (stage_ == PROFILE_STAGE_IDLE))
+  {
+    frame_start_ = now;
+    AddToHistogram(latency_histogram_,
+      TimeSinceTrigger() >> FRAME_LATENCY_BIN_SHIFT);
+  }
+  else if ((stage == PROFILE_STAGE_IDLE) && (stage_ != PROFILE_STAGE_IDLE))
+  {
+    Accumulate(&frame_, Elapsed(frame_start_, now));
+    const uint32_t completion = TimeSinceTrigger();
+    AddToHistogram(completion_histogram_,
+      completion >> FRAME_COMPLETION_BIN_SHIFT);
+    if (completion >= FRAME_TIMING_TICKS_PER_FRAME)
+    {
+      slack_ = 0;
+      if (overrun_count_ != 0xFFFF) overrun_count_++;
+      Trace(TRACE_EVENT_OVERRUN, completion > 0xFFFF ? 0xFFFF : completion);
+    }
+    else
+    {
+      slack_ = FRAME_TIMING_TICKS_PER_FRAME - completion;
+    }
+  }
+
+  stage_ = stage;
+  stage_start_ = now;
+
+  ProfileStage(stage);
+
+  return duration;
+}
+
+// -----------------------------------------------------------------------------
+uint8_t FrameTimingNow(uint16_t * time)
+{
+  uint8_t tick;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    *time = TCNT3;
+    tick = tick_count_;
+    // TIMER3 may have restarted without the interrupt having run yet.
+    if (TIFR3 & _BV(ICF3))
+    {
+      *time = TCNT3;
+      tick++;
+    }
+  }
+  return tick;
+}
+
+// -----------------------------------------------------------------------------
+void FrameTimingTick(uint8_t triggered)
+{
+  tick_count_++;
+  if (triggered) trigger_tick_ = tick_count_;
+}
+
+// -----------------------------------------------------------------------------
+void ResetFrameHistograms(void)
+{
+  for (uint8_t i = 0; i < FRAME_HISTOGRAM_N_BINS; i++)
+  {
+    latency_histogram_[i] = 0;
+    completion_histogram_[i] = 0;
+  }
+}
+
+// -----------------------------------------------------------------------------
+void ResetFrameOverruns(void)
+{
+  overrun_count_ = 0;
+}
+
+// -----------------------------------------------------------------------------
+void ResetFrameTiming(void)
+{
+  for (uint8_t i = 0; i < PROFILE_STAGE_COUNT; i++) stages_[i].count = 0;
+  frame_.count = 0;
+}
+
+
+// =============================================================================
+// Private functions:
+
+static void Accumulate(struct Accumulator * accumulator, uint16_t duration)
+{
+  if (!accumulator->count)
+  {
+    accumulator->min = duration;
+    accumulator->max = duration;
+    accumulator->sum = 0;
+  }
+  else if (duration < accumulator->min)
+  {
+    accumulator->min = duration;
+  }
+  else if (duration > accumulator->max)
+  {
+    accumulator->max = duration;
+  }
+  accumulator->sum += duration;
+  if (++accumulator->count == 0xFFFF)
+  {
+    // Keep the mean (and not the sum) when the count saturates.
+    accumulator->sum = accumulator->sum / 0xFFFF * 0x8000;
+    accumulator->count = 0x8000;
+  }
+}
+
+// -----------------------------------------------------------------------------
+static void AddToHistogram(uint16_t * histogram, uint32_t bin)
+{
+  if (bin >= FRAME_HISTOGRAM_N_BINS) bin = FRAME_HISTOGRAM_N_BINS - 1;
+  if (histogram[bin] != 0xFFFF) histogram[bin]++;
+}
+
+// -----------------------------------------------------------------------------
+// This function returns the number of TIMER3 ticks from "start" to "now",
+// allowing for TIMER3 restarting at the beginning of a frame in between (when
+// the frame has overrun).
+static uint16_t Elapsed(uint16_t start, uint16_t now)
+{
+  if (now >= start) return now - start;
+  return now + FRAME_TIMING_TICKS_PER_FRAME - start;
+}
+
+// -----------------------------------------------------------------------------
+static struct FrameTimingStatistic Statistic(
+  const struct Accumulator * accumulator)
+{
+  struct FrameTimingStatistic statistic = { 0, 0, 0 };
+  if (accumulator->count)
+  {
+    statistic.min = accumulator->min;
+    statistic.max = accumulator->max;
+    statistic.mean = (uint16_t)(accumulator->sum / accumulator->count);
+  }
+  return statistic;
+}
+
+// -----------------------------------------------------------------------------
+// This function returns the number of TIMER3 ticks since the tick that
+// triggered the current frame.
+static uint32_t TimeSinceTrigger(void)
+{
+  uint16_t now;
+  const uint8_t ticks = FrameTimingNow(&now) - trigger_tick_;
+  return (uint32_t)ticks * FRAME_TIMING_TICKS_PER_FRAME + now;
+}
@@ -0,0 +1,121 @@
+#ifndef FRAME_TIMING_H_
+#define FRAME_TIMING_H_
+
+
+// This file declares the on-board accounting of the time spent in each stage of
+// the main loop (the tasks run by the scheduler, see scheduler.c). TIMER3
+// restarts at the beginning of every 128 Hz frame (see TimingInit()), so TCNT3
+// read at the start of each stage gives the time since the frame began. The
+// minimum, maximum, and mean duration of each stage and of the whole frame
+// (from the first stage to the return to idle) are kept until
+// ResetFrameTiming() is called, and are reported by the frame timing MK data
+// stream.
+//
+// Two histograms are also kept (until ResetFrameHistograms() is called): the
+// latency from the TIMER3 tick that triggered a frame to the start of the
+// frame, and the time from that tick to the end of the frame. Frames that end
+// after the next tick are counted as overruns.
+
+#include <inttypes.h>
+
+#include "profile.h"
+
+
+// CPU cycles per TIMER3 tick (see TIMER3_DIVIDER in timing.c). Durations are
+// kept in TIMER3 ticks.
+#define FRAME_TIMING_CYCLES_PER_TICK (8)
+
+// TIMER3 ticks per frame (ICR3 + 1, see TimingInit()). This is used instead of
+// reading ICR3 outside of an interrupt handler, which could be disturbed by a
+// handler that accesses another 16-bit timer register (through the shared TEMP
+// register).
+#define FRAME_TIMING_TICKS_PER_FRAME \
+  ((uint16_t)(F_CPU / FRAME_TIMING_CYCLES_PER_TICK / 128))
+
+// Each histogram has FRAME_HISTOGRAM_N_BINS bins of equal width, the last of
+// which also counts everything beyond it. The frame period is 19531 ticks, so
+// bins 0 to 18 of the completion histogram end within the frame.
+#define FRAME_HISTOGRAM_N_BINS (24)
+#define FRAME_LATENCY_BIN_SHIFT (5)  // 32 ticks (12.8 us) per bin
+#define FRAME_COMPLETION_BIN_SHIFT (10)  // 1024 ticks (410 us) per bin
+
+struct FrameTimingStatistic {
+  uint16_t min;  // TIMER3 ticks
+  uint16_t max;  // TIMER3 ticks
+  uint16_t mean;  // TIMER3 ticks
+} __attribute__((packed));
+
+
+// =============================================================================
+// Accessors:
+
+// This function returns the histogram of the time from the triggering tick to
+// the end of the frame (FRAME_HISTOGRAM_N_BINS counts).
+const uint16_t * FrameCompletionHistogram(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the histogram of the latency from the triggering tick
+// to the start of the frame (FRAME_HISTOGRAM_N_BINS counts).
+const uint16_t * FrameLatencyHistogram(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the number of frames that have ended after the next
+// tick since the last call to ResetFrameOverruns().
+uint16_t FrameOverrunCount(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the TIMER3 ticks that were left from the end of the
+// last frame to the next tick, or 0 if that frame overran.
+uint16_t FrameSlack(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the duration of the frame (from the start of the first
+// task to the end of the last).
+struct FrameTimingStatistic FrameTiming(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the number of 128 Hz frames timed since the last
+// reset.
+uint16_t FrameTimingCount(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the duration of "stage". All zeros are returned if the
+// stage has not run since the last reset.
+struct FrameTimingStatistic FrameTimingStage(enum ProfileStage stage);
+
+
+// =============================================================================
+// Public functions:
+
+// This function marks the beginning of a main loop stage (or the return to
+// idle when stage is PROFILE_STAGE_IDLE), which ends the previous stage, and
+// returns the duration of the previous stage in TIMER3 ticks (0 if idle). It
+// also writes the profiler marker (see ProfileStage()).
+uint16_t FrameTimingMark(enum ProfileStage stage);
+
+// -----------------------------------------------------------------------------
+// This function returns the number of the most recent 128 Hz tick (modulo 256)
+// and sets "time" to the number of TIMER3 ticks since then. It may be called
+// from an interrupt handler.
+uint8_t FrameTimingNow(uint16_t * time);
+
+// -----------------------------------------------------------------------------
+// This function is called from the TIMER3 interrupt at each 128 Hz tick.
+// "triggered" indicates that the tick started a new frame (the previous frame
+// had finished).
+void FrameTimingTick(uint8_t triggered);
+
+// -----------------------------------------------------------------------------
+// This function clears the histograms.
+void ResetFrameHistograms(void);
+
+// -----------------------------------------------------------------------------
+// This function clears the overrun count.
+void ResetFrameOverruns(void);
+
+// -----------------------------------------------------------------------------
+// This function clears the accumulated durations.
+void ResetFrameTiming(void);
+
+
+#endif  // FRAME_TIMING_H_
@@ -0,0 +1,94 @@
+#include "airframe.h"
+
+#include <string.h>
+
+
+// =============================================================================
+// Accessors:
+
+// This function returns the name of the selected airframe (as in AIRFRAME in
+// the makefile).
+const char * AirframeName(void)
+{
+#if defined BI_OCTO
+  return "BI_OCTO";
+#elif defined BI_QUAD
+  return "BI_QUAD";
+#elif defined HEXA690
+  return "HEXA690";
+#elif defined QUAD475_12
+  return "QUAD475_12";
+#elif defined SMALL_QUAD
+  return "SMALL_QUAD";
+#else
+  return "LARGE_QUAD";
+#endif
+}
+
+
+// =============================================================================
+// Public functions:
+
+// This function copies the actuation inverse of the selected airframe into
+// "b_inv" and returns the number of motors.
+uint8_t AirframeActuationInverse(float b_inv[MAX_MOTORS][4])
+{
+#if defined BI_OCTO
+  const uint8_t kNMotors = 8;
+  const float kActuationInverse[MAX_MOTORS][4] = {
+    { +0.000000000e+00, +9.675320382e+00, +1.972471902e+02, -6.033975571e+01 },
+    { +9.308934042e+00, +6.841484653e+00, -1.972471902e+02, -6.033975571e+01 },
+    { +1.316482077e+01, +0.000000000e+00, +1.972471902e+02, -6.033975571e+01 },
+    { +9.308934042e+00, -6.841484653e+00, -1.972471902e+02, -6.033975571e+01 },
+    { +0.000000000e+00, -9.675320382e+00, +1.972471902e+02, -6.033975571e+01 },
+    { -9.308934042e+00, -6.841484653e+00, -1.972471902e+02, -6.033975571e+01 },
+    { -1.316482077e+01, +0.000000000e+00, +1.972471902e+02, -6.033975571e+01 },
+    { -9.308934042e+00, +6.841484653e+00, -1.972471902e+02, -6.033975571e+01 },
+  };
+#elif defined BI_QUAD
+  const uint8_t kNMotors = 4;
+  const float kActuationInverse[MAX_MOTORS][4] = {
+    { +0.000000000e+00, +1.192417555e+01, -1.909087430e+02, -7.062768931e+01 },
+    { +0.000000000e+00, -1.192417555e+01, -1.909087430e+02, -7.062768931e+01 },
+    { -1.310881083e+01, +0.000000000e+00, +1.909087430e+02, -7.062768931e+01 },
+    { +1.310881083e+01, +0.000000000e+00, +1.909087430e+02, -7.062768931e+01 },
+  };
+#elif defined HEXA690
+  const uint8_t kNMotors = 6;
+  const float kActuationInverse[MAX_MOTORS][4] = {
+    { +0.000000000e+00, +6.514121394e+00, -8.032920678e+01, -5.559948227e+01 },
+    { -5.788637274e+00, +3.257060697e+00, +8.032920678e+01, -5.559948227e+01 },
+    { -5.788637274e+00, -3.257060697e+00, -8.032920678e+01, -5.559948227e+01 },
+    { +0.000000000e+00, -6.514121394e+00, +8.032920678e+01, -5.559948227e+01 },
+    { +5.788637274e+00, -3.257060697e+00, -8.032920678e+01, -5.559948227e+01 },
+    { +5.788637274e+00, +3.257060697e+00, +8.032920678e+01, -5.559948227e+01 },
+  };
+#elif defined QUAD475_12
+  const uint8_t kNMotors = 4;
+  const float kActuationInverse[MAX_MOTORS][4] = {
+    { +3.705298070e+00, +3.559601704e+00, -5.368318697e+01, -5.845104543e+01 },
+    { -3.705298070e+00, -3.559601704e+00, -5.368318697e+01, -5.845104543e+01 },
+    { -3.705298070e+00, +3.559601704e+00, +5.368318697e+01, -5.845104543e+01 },
+    { +3.705298070e+00, -3.559601704e+00, +5.368318697e+01, -5.845104543e+01 },
+  };
+#elif defined SMALL_QUAD
+  const uint8_t kNMotors = 4;
+  const float kActuationInverse[MAX_MOTORS][4] = {
+    { +2.416975886e+00, +2.416975886e+00, -4.971845548e+01, -5.047879731e+01 },
+    { -2.416975886e+00, -2.416975886e+00, -4.971845548e+01, -5.047879731e+01 },
+    { -2.416975886e+00, +2.416975886e+00, +4.971845548e+01, -5.047879731e+01 },
+    { +2.416975886e+00, -2.416975886e+00, +4.971845548e+01, -5.047879731e+01 },
+  };
+#else  // Large quad
+  const uint8_t kNMotors = 4;
+  const float kActuationInverse[MAX_MOTORS][4] = {
+    { +4.134575842e+00, +4.115660990e+00, -5.469661607e+01, -5.576508516e+01 },
+    { -4.134575842e+00, -4.115660990e+00, -5.469661607e+01, -5.576508516e+01 },
+    { -4.134575842e+00, +4.115660990e+00, +5.469661607e+01, -5.576508516e+01 },
+    { +4.134575842e+00, -4.115660990e+00, +5.469661607e+01, -5.576508516e+01 },
+  };
+#endif
+
+  memcpy(b_inv, kActuationInverse, sizeof(kActuationInverse));
+  return kNMotors;
+}
@@ -0,0 +1,30 @@
+// This file declares the airframe parameters that the firmware normally keeps
+// in EEPROM (see the commented-out block in main()), so that the host build
+// and the simulator can configure the controller for the airframe selected at
+// build time (AIRFRAME in the makefile).
+
+#ifndef HOST_AIRFRAME_H_
+#define HOST_AIRFRAME_H_
+
+
+#include <inttypes.h>
+
+#include "main.h"
+
+
+// =============================================================================
+// Accessors:
+
+// This function returns the name of the selected airframe.
+const char * AirframeName(void);
+
+
+// =============================================================================
+// Public functions:
+
+// This function copies the actuation inverse of the selected airframe into
+// "b_inv" and returns the number of motors.
+uint8_t AirframeActuationInverse(float b_inv[MAX_MOTORS][4]);
+
+
+#endif  // HOST_AIRFRAME_H_
@@ -0,0 +1,52 @@
+// This file stands in for <avr/eeprom.h> in the host build. The EEPROM image
+// (struct EEPROM eeprom) is placed in ordinary RAM, so the block and byte
+// accessors reduce to memory copies.
+
+#ifndef HOST_AVR_EEPROM_H_
+#define HOST_AVR_EEPROM_H_
+
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+
+
+#define EEMEM
+
+static inline void eeprom_read_block(void * destination, const void * source,
+  size_t length)
+{
+  memcpy(destination, source, length);
+}
+
+static inline uint8_t eeprom_read_byte(const uint8_t * source)
+{
+  return *source;
+}
+
+static inline void eeprom_update_block(const void * source, void * destination,
+  size_t length)
+{
+  memcpy(destination, source, length);
+}
+
+static inline void eeprom_update_byte(uint8_t * destination, uint8_t value)
+{
+  *destination = value;
+}
+
+static inline void eeprom_write_block(const void * source, void * destination,
+  size_t length)
+{
+  memcpy(destination, source, length);
+}
+
+static inline void eeprom_write_byte(uint8_t * destination, uint8_t value)
+{
+  *destination = value;
+}
+
+#define eeprom_is_ready() (1)
+
+
+#endif  // HOST_AVR_EEPROM_H_
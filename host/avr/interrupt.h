@@ -0,0 +1,17 @@
+// This file stands in for <avr/interrupt.h> in the host build. Interrupt
+// handlers become ordinary functions that the host program may call directly to
+// emulate the corresponding interrupt.
+
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+
+#include <avr/io.h>
+
+
+#define ISR(vector, ...) void vector(void); void vector(void)
+#define sei() ((void)0)
+#define cli() ((void)0)
+
+
+#endif  // HOST_AVR_INTERRUPT_H_
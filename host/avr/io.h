@@ -0,0 +1,258 @@
+// This file stands in for <avr/io.h> when the flight-control core is built for
+// the host (see "make host"). Each special function register of the
+// ATmega1284P that is referenced by the firmware is replaced by an ordinary
+// variable (defined in host/avr_shim.c) so that register reads and writes
+// compile unchanged and can be inspected or driven by the host program.
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+
+#include <inttypes.h>
+
+
+#define _BV(bit) (1 << (bit))
+#define bit_is_set(sfr, bit) ((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!((sfr) & _BV(bit)))
+#define loop_until_bit_is_set(sfr, bit) do { } while (bit_is_clear(sfr, bit))
+#define loop_until_bit_is_clear(sfr, bit) do { } while (bit_is_set(sfr, bit))
+
+
+// =============================================================================
+// Registers:
+
+// General purpose I/O
+extern volatile uint8_t DDRA, DDRB, DDRC, DDRD;
+extern volatile uint8_t PINA, PINB, PINC, PIND;
+extern volatile uint8_t PORTA, PORTB, PORTC, PORTD;
+extern volatile uint8_t GPIOR0, GPIOR1, GPIOR2;
+
+// Status register
+extern volatile uint8_t SREG;
+
+// ADC
+extern volatile uint8_t ADCSRA, ADCSRB, ADMUX, ADCL, ADCH;
+extern volatile uint16_t ADC;
+
+// External interrupts
+extern volatile uint8_t EICRA, EIMSK, EIFR;
+
+// EEPROM
+extern volatile uint8_t EECR, EEDR;
+extern volatile uint16_t EEAR;
+
+// Self-programming
+extern volatile uint8_t SPMCSR;
+
+// SPI
+extern volatile uint8_t SPCR, SPSR, SPDR;
+
+// TIMER0
+extern volatile uint8_t TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B, TIMSK0, TIFR0;
+
+// TIMER1
+extern volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+extern volatile uint16_t TCNT1, OCR1A, OCR1B, ICR1;
+
+// TIMER3
+extern volatile uint8_t TCCR3A, TCCR3B, TCCR3C, TIMSK3, TIFR3;
+extern volatile uint16_t TCNT3, OCR3A, OCR3B, ICR3;
+
+// TWI
+extern volatile uint8_t TWBR, TWCR, TWDR, TWSR, TWAR;
+
+// USART0
+extern volatile uint8_t UCSR0A, UCSR0B, UCSR0C, UDR0;
+extern volatile uint16_t UBRR0;
+
+// USART1
+extern volatile uint8_t UCSR1A, UCSR1B, UCSR1C, UDR1;
+extern volatile uint16_t UBRR1;
+
+
+// =============================================================================
+// Register bits:
+
+// ADCSRA
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+
+// ADCSRB
+#define ACME 6
+#define ADTS2 2
+#define ADTS1 1
+#define ADTS0 0
+
+// ADMUX
+#define REFS1 7
+#define REFS0 6
+#define ADLAR 5
+
+// EICRA, EIMSK, EIFR
+#define ISC21 5
+#define ISC20 4
+#define ISC11 3
+#define ISC10 2
+#define ISC01 1
+#define ISC00 0
+#define INT2 2
+#define INT1 1
+#define INT0 0
+#define INTF2 2
+#define INTF1 1
+#define INTF0 0
+
+// EECR
+#define EEPM1 5
+#define EEPM0 4
+#define EERIE 3
+#define EEMPE 2
+#define EEPE 1
+#define EERE 0
+
+// SPMCSR
+#define SPMIE 7
+#define SPMEN 0
+
+// SPCR, SPSR
+#define SPIE 7
+#define SPE 6
+#define DORD 5
+#define MSTR 4
+#define CPOL 3
+#define CPHA 2
+#define SPR1 1
+#define SPR0 0
+#define SPIF 7
+#define WCOL 6
+#define SPI2X 0
+
+// TCCR0A, TCCR0B, TIMSK0, TIFR0
+#define COM0A1 7
+#define COM0A0 6
+#define COM0B1 5
+#define COM0B0 4
+#define WGM01 1
+#define WGM00 0
+#define FOC0A 7
+#define FOC0B 6
+#define WGM02 3
+#define CS02 2
+#define CS01 1
+#define CS00 0
+#define OCIE0B 2
+#define OCIE0A 1
+#define TOIE0 0
+#define OCF0B 2
+#define OCF0A 1
+#define TOV0 0
+
+// TCCR1A, TCCR1B, TIMSK1, TIFR1
+#define COM1A1 7
+#define COM1A0 6
+#define COM1B1 5
+#define COM1B0 4
+#define WGM11 1
+#define WGM10 0
+#define ICNC1 7
+#define ICES1 6
+#define WGM13 4
+#define WGM12 3
+#define CS12 2
+#define CS11 1
+#define CS10 0
+#define ICIE1 5
+#define OCIE1B 2
+#define OCIE1A 1
+#define TOIE1 0
+#define ICF1 5
+#define OCF1B 2
+#define OCF1A 1
+#define TOV1 0
+
+// TCCR3A, TCCR3B, TIMSK3, TIFR3
+#define COM3A1 7
+#define COM3A0 6
+#define COM3B1 5
+#define COM3B0 4
+#define WGM31 1
+#define WGM30 0
+#define ICNC3 7
+#define ICES3 6
+#define WGM33 4
+#define WGM32 3
+#define CS32 2
+#define CS31 1
+#define CS30 0
+#define ICIE3 5
+#define OCIE3B 2
+#define OCIE3A 1
+#define TOIE3 0
+#define ICF3 5
+#define OCF3B 2
+#define OCF3A 1
+#define TOV3 0
+
+// TWCR
+#define TWINT 7
+#define TWEA 6
+#define TWSTA 5
+#define TWSTO 4
+#define TWWC 3
+#define TWEN 2
+#define TWIE 0
+
+// UCSR0A, UCSR0B, UCSR0C
+#define RXC0 7
+#define TXC0 6
+#define UDRE0 5
+#define FE0 4
+#define DOR0 3
+#define UPE0 2
+#define U2X0 1
+#define MPCM0 0
+#define RXCIE0 7
+#define TXCIE0 6
+#define UDRIE0 5
+#define RXEN0 4
+#define TXEN0 3
+#define UCSZ02 2
+#define UMSEL01 7
+#define UMSEL00 6
+#define UPM01 5
+#define UPM00 4
+#define USBS0 3
+#define UCSZ01 2
+#define UCSZ00 1
+
+// UCSR1A, UCSR1B, UCSR1C
+#define RXC1 7
+#define TXC1 6
+#define UDRE1 5
+#define FE1 4
+#define DOR1 3
+#define UPE1 2
+#define U2X1 1
+#define MPCM1 0
+#define RXCIE1 7
+#define TXCIE1 6
+#define UDRIE1 5
+#define RXEN1 4
+#define TXEN1 3
+#define UCSZ12 2
+#define UMSEL11 7
+#define UMSEL10 6
+#define UPM11 5
+#define UPM10 4
+#define USBS1 3
+#define UCSZ11 2
+#define UCSZ10 1
+
+
+#endif  // HOST_AVR_IO_H_
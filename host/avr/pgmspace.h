@@ -0,0 +1,29 @@
+// This file stands in for <avr/pgmspace.h> in the host build. There is only one
+// address space on the host, so program memory accesses are plain reads.
+
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define PGM_P const char *
+
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define pgm_read_dword(address) (*(const uint32_t *)(address))
+#define pgm_read_ptr(address) (*(void * const *)(address))
+
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define sprintf_P sprintf
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+
+
+#endif  // HOST_AVR_PGMSPACE_H_
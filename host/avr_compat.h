@@ -0,0 +1,35 @@
+// This file is force-included (gcc -include) into every translation unit of the
+// host build. It reproduces the numeric environment of avr-gcc, where double is
+// a 32-bit float, so that results computed on the host match the flight
+// controller as closely as possible.
+
+#ifndef HOST_AVR_COMPAT_H_
+#define HOST_AVR_COMPAT_H_
+
+
+#include <math.h>
+#include <stdarg.h>  // avr-libc's <stdio.h> includes this, glibc's does not.
+
+// avr-libc implements the double precision math functions in single precision.
+#define sqrt sqrtf
+#define sin sinf
+#define cos cosf
+#define tan tanf
+#define asin asinf
+#define acos acosf
+#define atan atanf
+#define atan2 atan2f
+#define exp expf
+#define log logf
+#define pow powf
+#define fabs fabsf
+#define floor floorf
+#define ceil ceilf
+#define round roundf
+
+#ifndef F_CPU
+  #define F_CPU (20000000UL)
+#endif
+
+
+#endif  // HOST_AVR_COMPAT_H_
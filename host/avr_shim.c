@@ -0,0 +1,43 @@
+// This file provides storage for the special function registers declared in
+// host/avr/io.h.
+
+#include <avr/io.h>
+
+
+// =============================================================================
+// Registers:
+
+volatile uint8_t DDRA, DDRB, DDRC, DDRD;
+volatile uint8_t PINA, PINB, PINC, PIND;
+volatile uint8_t PORTA, PORTB, PORTC, PORTD;
+volatile uint8_t GPIOR0, GPIOR1, GPIOR2;
+
+volatile uint8_t SREG;
+
+volatile uint8_t ADCSRA, ADCSRB, ADMUX, ADCL, ADCH;
+volatile uint16_t ADC;
+
+volatile uint8_t EICRA, EIMSK, EIFR;
+
+volatile uint8_t EECR, EEDR;
+volatile uint16_t EEAR;
+
+volatile uint8_t SPMCSR;
+
+volatile uint8_t SPCR, SPSR, SPDR;
+
+volatile uint8_t TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B, TIMSK0, TIFR0;
+
+volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+volatile uint16_t TCNT1, OCR1A, OCR1B, ICR1;
+
+volatile uint8_t TCCR3A, TCCR3B, TCCR3C, TIMSK3, TIFR3;
+volatile uint16_t TCNT3, OCR3A, OCR3B, ICR3;
+
+volatile uint8_t TWBR, TWCR, TWDR, TWSR, TWAR;
+
+volatile uint8_t UCSR0A, UCSR0B, UCSR0C, UDR0;
+volatile uint16_t UBRR0;
+
+volatile uint8_t UCSR1A, UCSR1B, UCSR1C, UDR1;
+volatile uint16_t UBRR1;
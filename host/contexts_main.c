@@ -0,0 +1,190 @@
+// This program checks that controller contexts (see struct ControlContext in
+// control.h) are independent of each other. Two contexts with different gains
+// and different attitude and gyro inputs are stepped side by side, with their
+// outer loops and rate loop steps interleaved, while the default controller
+// flies the scripted pilot (see pilot.c). A reference copy of each context is
+// stepped on its own in the same frames with the same inputs. Any state that
+// the contexts share shows up as a difference between a context and its
+// reference, and the program then fails.
+//
+// Usage: UT_FlightCtrl_contexts [seconds]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "attitude.h"
+#include "control.h"
+#include "host_board.h"
+#include "main.h"
+#include "motors.h"
+#include "pilot.h"
+
+
+// =============================================================================
+// Private data:
+
+#define DEFAULT_SECONDS (20)
+
+// The contexts are stepped once the motors are running, so that the sticks
+// command thrust.
+#define START_FRAME ((PILOT_FLYING_MS + 1000) * (uint32_t)FS / 1000)
+
+#define N_CONTEXTS (2)
+
+// Gains of the second context relative to the first.
+#define GAIN_SCALE (0.8)
+
+struct ContextInputs {
+  struct AttitudeContext attitude;
+  float amplitude;  // Of the synthetic angular rate (rad/s)
+  float frequency;  // Hz
+};
+
+
+// =============================================================================
+// Private function declarations:
+
+static uint8_t Compare(const struct ControlContext * context,
+  const struct ControlContext * reference);
+static void SyntheticAngularRate(const struct ContextInputs * inputs,
+  uint32_t step, float angular_rate[3]);
+
+
+// =============================================================================
+// Public functions:
+
+int main(int argc, char * argv[])
+{
+  uint32_t seconds = DEFAULT_SECONDS;
+  if (argc > 1) seconds = strtoul(argv[1], NULL, 0);
+  const uint32_t n_frames = START_FRAME + seconds * (uint32_t)FS;
+
+  HostBoardInit();
+
+  static struct ControlContext contexts[N_CONTEXTS], references[N_CONTEXTS];
+  static struct ContextInputs inputs[N_CONTEXTS] = {
+    { .amplitude = 0.3, .frequency = 1.0 },
+    { .amplitude = 1.0, .frequency = 3.0 },
+  };
+  for (uint8_t k = 0; k < N_CONTEXTS; k++)
+  {
+    InitControlContext(&contexts[k]);
+    InitAttitudeContext(&inputs[k].attitude);
+  }
+  contexts[1].feedback_gains.p *= GAIN_SCALE;
+  contexts[1].feedback_gains.phi *= GAIN_SCALE;
+  for (uint8_t k = 0; k < N_CONTEXTS; k++) references[k] = contexts[k];
+
+  uint32_t n_mismatches = 0, n_different = 0;
+  for (uint32_t i = 0; i < n_frames; i++)
+  {
+    int16_t channels[SBUS_FRAME_N_CHANNELS];
+    uint8_t binary;
+    PilotSticks((uint64_t)HostFrameCount() * 1000 / (uint32_t)FS, channels,
+      &binary);
+    HostSetSBusChannels(channels, binary);
+    HostRunOuterLoop();
+    if (i < START_FRAME)
+    {
+      for (uint8_t j = 0; j < RATE_LOOP_FACTOR; j++) HostRunRateLoop();
+      continue;
+    }
+
+    // Each context gets its own attitude from its own synthetic rates.
+    const float acceleration[3] = { 0.0, 0.0, -1.0 };
+    float angular_rate[N_CONTEXTS][RATE_LOOP_FACTOR][3];
+    for (uint8_t k = 0; k < N_CONTEXTS; k++)
+    {
+      for (uint8_t j = 0; j < RATE_LOOP_FACTOR; j++)
+        SyntheticAngularRate(&inputs[k], i * RATE_LOOP_FACTOR + j,
+          angular_rate[k][j]);
+      UpdateAttitudeContext(&inputs[k].attitude, angular_rate[k][0],
+        acceleration);
+    }
+
+    // The contexts side by side, with the default controller in between.
+    for (uint8_t k = 0; k < N_CONTEXTS; k++)
+      UpdateControlContext(&contexts[k], &inputs[k].attitude);
+    for (uint8_t j = 0; j < RATE_LOOP_FACTOR; j++)
+    {
+      HostRunRateLoop();
+      for (uint8_t k = 0; k < N_CONTEXTS; k++)
+        UpdateRateLoop(&contexts[k], angular_rate[k][j]);
+    }
+
+    // Each reference on its own.
+    for (uint8_t k = 0; k < N_CONTEXTS; k++)
+    {
+      UpdateControlContext(&references[k], &inputs[k].attitude);
+      for (uint8_t j = 0; j < RATE_LOOP_FACTOR; j++)
+        UpdateRateLoop(&references[k], angular_rate[k][j]);
+    }
+
+    for (uint8_t k = 0; k < N_CONTEXTS; k++)
+    {
+      if (Compare(&contexts[k], &references[k])) continue;
+      if (!n_mismatches)
+      {
+        printf("context %u differs from its reference in frame %lu\n", k,
+          (unsigned long)i);
+      }
+      n_mismatches++;
+    }
+    if (memcmp(contexts[0].setpoints, contexts[1].setpoints,
+      NMotors() * sizeof(contexts[0].setpoints[0])))
+    {
+      n_different++;
+    }
+  }
+
+  const uint32_t n_checked = n_frames - START_FRAME;
+  printf("%lu frames, %lu with different setpoints in the two contexts, "
+    "%lu mismatches\n", (unsigned long)n_checked, (unsigned long)n_different,
+    (unsigned long)n_mismatches);
+
+  // The check means nothing if the contexts never diverged.
+  const uint8_t passed = !n_mismatches && (n_different > n_checked / 2);
+  printf("%s\n", passed ? "PASS" : "FAIL");
+  return passed ? 0 : 1;
+}
+
+
+// =============================================================================
+// Private functions:
+
+// This function returns 1 if the state and outputs of "context" match those of
+// "reference" exactly. The fields are compared one by one, because a struct
+// assignment need not copy the padding.
+static uint8_t Compare(const struct ControlContext * context,
+  const struct ControlContext * reference)
+{
+  return !memcmp(&context->kalman_state, &reference->kalman_state,
+      sizeof(context->kalman_state))
+    && !memcmp(context->angular_cmd, reference->angular_cmd,
+      sizeof(context->angular_cmd))
+    && (context->heading_cmd == reference->heading_cmd)
+    && (context->thrust_cmd == reference->thrust_cmd)
+    && !memcmp(context->nav_g_b_cmd, reference->nav_g_b_cmd,
+      sizeof(context->nav_g_b_cmd))
+    && (context->nav_thrust_cmd == reference->nav_thrust_cmd)
+    && !memcmp(context->quat_cmd, reference->quat_cmd,
+      sizeof(context->quat_cmd))
+    && !memcmp(context->setpoints, reference->setpoints,
+      sizeof(context->setpoints))
+    && (context->rate_step == reference->rate_step);
+}
+
+// -----------------------------------------------------------------------------
+// This function writes the angular rate of rate loop step "step" for a context:
+// roll and pitch sinusoids in quadrature and a slow yaw.
+static void SyntheticAngularRate(const struct ContextInputs * inputs,
+  uint32_t step, float angular_rate[3])
+{
+  const float t = (float)step / FS_RATE;
+  const float phase = 2.0 * M_PI * inputs->frequency * t;
+  angular_rate[0] = inputs->amplitude * sinf(phase);
+  angular_rate[1] = inputs->amplitude * cosf(phase);
+  angular_rate[2] = 0.1 * inputs->amplitude;
+}
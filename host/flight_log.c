@@ -0,0 +1,92 @@
+#include "flight_log.h"
+
+#include <string.h>
+
+#include <avr/eeprom.h>
+
+#include "airframe.h"
+#include "eeprom.h"
+
+
+// =============================================================================
+// Public functions:
+
+void FlightLogHostHeader(struct FlightLogHeader * header)
+{
+  memset(header, 0, sizeof(*header));
+  header->magic = FLIGHT_LOG_MAGIC;
+  header->version = FLIGHT_LOG_VERSION;
+  strncpy(header->airframe, AirframeName(), FLIGHT_LOG_AIRFRAME_LENGTH - 1);
+  header->n_motors = eeprom_read_byte(&eeprom.n_motors);
+  header->rate_loop_factor = RATE_LOOP_FACTOR;
+  eeprom_read_block((void*)header->actuation_inverse,
+    (const void*)&eeprom.actuation_inverse[0][0],
+    sizeof(header->actuation_inverse));
+  eeprom_read_block((void*)header->acc_offset,
+    (const void*)&eeprom.acc_offset[0], sizeof(header->acc_offset));
+  eeprom_read_block((void*)header->gyro_offset,
+    (const void*)&eeprom.gyro_offset[0], sizeof(header->gyro_offset));
+}
+
+// -----------------------------------------------------------------------------
+int FlightLogReadHeader(FILE * file, struct FlightLogHeader * header)
+{
+  if (fread(header, sizeof(*header), 1, file) != 1) return 1;
+  if (header->magic != FLIGHT_LOG_MAGIC) return 1;
+  if (header->version != FLIGHT_LOG_VERSION) return 1;
+  if (header->n_motors > MAX_MOTORS) return 1;
+  if (header->rate_loop_factor != RATE_LOOP_FACTOR) return 1;
+  header->airframe[FLIGHT_LOG_AIRFRAME_LENGTH - 1] = '\0';
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+int FlightLogReadRecord(FILE * file, struct FlightLogRecord * record)
+{
+  if (fread(&record->frame, sizeof(record->frame), 1, file) != 1) return 0;
+  if (record->frame.n_nav_packets > FLIGHT_LOG_MAX_NAV_PACKETS) return 0;
+
+  if ((record->frame.flags & FLIGHT_LOG_FRAME_SBUS)
+    && (fread(&record->sbus, sizeof(record->sbus), 1, file) != 1))
+  {
+    return 0;
+  }
+
+  for (uint8_t i = 0; i < record->frame.n_nav_packets; i++)
+  {
+    struct FlightLogNavPacket * nav = &record->nav[i];
+    if (fread(&nav->length, 1, 1, file) != 1) return 0;
+    if (fread(nav->payload, 1, nav->length, file) != nav->length) return 0;
+    memset(&nav->payload[nav->length], 0, FLIGHT_LOG_MAX_NAV_LENGTH
+      - nav->length);
+  }
+
+  return 1;
+}
+
+// -----------------------------------------------------------------------------
+int FlightLogWriteHeader(FILE * file, const struct FlightLogHeader * header)
+{
+  return fwrite(header, sizeof(*header), 1, file) != 1;
+}
+
+// -----------------------------------------------------------------------------
+int FlightLogWriteRecord(FILE * file, const struct FlightLogRecord * record)
+{
+  if (fwrite(&record->frame, sizeof(record->frame), 1, file) != 1) return 1;
+
+  if ((record->frame.flags & FLIGHT_LOG_FRAME_SBUS)
+    && (fwrite(&record->sbus, sizeof(record->sbus), 1, file) != 1))
+  {
+    return 1;
+  }
+
+  for (uint8_t i = 0; i < record->frame.n_nav_packets; i++)
+  {
+    const struct FlightLogNavPacket * nav = &record->nav[i];
+    if (fwrite(&nav->length, 1, 1, file) != 1) return 1;
+    if (fwrite(nav->payload, 1, nav->length, file) != nav->length) return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,106 @@
+// This file declares the binary flight log that the replay tool (see
+// replay_main.c) feeds back through the flight-control core. The log holds the
+// inputs of every 128 Hz frame (the raw ADC sums, the decoded SBus channels,
+// the packets received from the NaviCtrl, and the gyro sums read by each step
+// of the rate loop) along with the motor setpoints that each step of the rate
+// loop produced, so that a flight can be re-run on the host and the setpoints
+// compared step by step.
+//
+// The log starts with struct FlightLogHeader and is followed by one record per
+// frame: struct FlightLogFrame, then struct FlightLogSBus if a new SBus frame
+// was received since the previous frame, then a length byte and the payload of
+// each NaviCtrl packet received since the previous frame. All fields are
+// little-endian and packed, as the AVR stores them.
+
+#ifndef HOST_FLIGHT_LOG_H_
+#define HOST_FLIGHT_LOG_H_
+
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "adc.h"
+#include "main.h"
+#include "sbus_frame.h"
+
+
+#define FLIGHT_LOG_MAGIC (0x474C4346UL)  // "FCLG"
+#define FLIGHT_LOG_VERSION (2)
+#define FLIGHT_LOG_AIRFRAME_LENGTH (16)
+#define FLIGHT_LOG_MAX_NAV_PACKETS (3)  // Per frame
+#define FLIGHT_LOG_MAX_NAV_LENGTH (255)
+#define FLIGHT_LOG_FIRST_GYRO_CHANNEL (2)  // Gyro Z, then X and Y (see adc.c)
+#define FLIGHT_LOG_N_GYRO_CHANNELS (3)
+
+enum FlightLogFrameFlags {
+  FLIGHT_LOG_FRAME_SBUS = 1 << 0,  // struct FlightLogSBus follows
+};
+
+// Configuration in effect when logging started (normally from the EEPROM and
+// the gyro calibration at power-up).
+struct FlightLogHeader {
+  uint32_t magic;
+  uint16_t version;
+  char airframe[FLIGHT_LOG_AIRFRAME_LENGTH];  // AIRFRAME of the build
+  uint8_t n_motors;
+  uint8_t rate_loop_factor;  // RATE_LOOP_FACTOR of the build
+  float actuation_inverse[MAX_MOTORS][4];
+  int16_t acc_offset[3];
+  int16_t gyro_offset[3];
+} __attribute__((packed));
+
+struct FlightLogFrame {
+  uint16_t timestamp;  // ms
+  uint8_t flags;  // enum FlightLogFrameFlags
+  uint8_t n_nav_packets;
+  uint16_t adc_sum[ADC_N_CHANNELS];  // Sum of ADC_N_SAMPLES raw samples
+  // The gyro channels as read by each step of the rate loop.
+  uint16_t gyro_sum[RATE_LOOP_FACTOR][FLIGHT_LOG_N_GYRO_CHANNELS];
+  uint16_t motor_setpoint[RATE_LOOP_FACTOR][MAX_MOTORS];  // Output of each step
+} __attribute__((packed));
+
+struct FlightLogSBus {
+  int16_t channels[SBUS_FRAME_N_CHANNELS];
+  uint8_t binary;
+} __attribute__((packed));
+
+struct FlightLogNavPacket {
+  uint8_t length;
+  uint8_t payload[FLIGHT_LOG_MAX_NAV_LENGTH];
+};
+
+// One frame record as read back from a log.
+struct FlightLogRecord {
+  struct FlightLogFrame frame;
+  struct FlightLogSBus sbus;  // Valid if FLIGHT_LOG_FRAME_SBUS is set
+  struct FlightLogNavPacket nav[FLIGHT_LOG_MAX_NAV_PACKETS];
+};
+
+
+// =============================================================================
+// Public functions:
+
+// This function fills "header" with the configuration of the host build as it
+// is after HostBoardInit().
+void FlightLogHostHeader(struct FlightLogHeader * header);
+
+// -----------------------------------------------------------------------------
+// This function reads and checks the header, which must be from a build with
+// the same RATE_LOOP_FACTOR. It returns 0 on success.
+int FlightLogReadHeader(FILE * file, struct FlightLogHeader * header);
+
+// -----------------------------------------------------------------------------
+// This function reads the next frame record. It returns 1 if a complete record
+// was read and 0 at the end of the log (or if the last record is truncated).
+int FlightLogReadRecord(FILE * file, struct FlightLogRecord * record);
+
+// -----------------------------------------------------------------------------
+// This function writes the header. It returns 0 on success.
+int FlightLogWriteHeader(FILE * file, const struct FlightLogHeader * header);
+
+// -----------------------------------------------------------------------------
+// This function writes a frame record. It returns 0 on success.
+int FlightLogWriteRecord(FILE * file, const struct FlightLogRecord * record);
+
+
+#endif  // HOST_FLIGHT_LOG_H_
@@ -0,0 +1,366 @@
+#include "host_board.h"
+
+#include <avr/io.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "adc.h"
+#include "airframe.h"
+#include "attitude.h"
+#include "background.h"
+#include "buzzer.h"
+#include "control.h"
+#include "eeprom.h"
+#include "i2c.h"
+#include "indicator.h"
+#include "motors.h"
+#include "nav_comms.h"
+#include "pressure_altitude.h"
+#include "sbus.h"
+#include "state.h"
+#include "timing.h"
+#include "uart.h"
+#include "ut_serial_protocol.h"
+#include "vertical_speed.h"
+
+
+// =============================================================================
+// Private data:
+
+#define HOST_BOARD_VERSION (25)
+#define HOST_BATTERY_ADC_VALUE (390)  // ~12.6 V
+#define HOST_ADC_MAX_VALUE (1023)
+
+// Defined in the firmware sources (normally shared with the assembly files).
+extern volatile uint16_t ms_timestamp_, ms_timestamp_high_;
+extern volatile uint16_t samples_[ADC_N_SLOTS];
+extern volatile uint16_t sample_sums_[ADC_N_CHANNELS];
+extern const uint8_t adc_schedule_[ADC_SCHEDULE_LENGTH];
+extern volatile uint8_t sbus_rx_buffer_[2][SBUS_RX_BUFFER_LENGTH];
+extern volatile int8_t sbus_data_ready_;
+
+static uint32_t frame_count_ = 0;
+static uint8_t n_motors_ = 0;
+static uint8_t sbus_buffer_index_ = 0;
+static uint16_t motor_setpoints_[MAX_MOTORS] = { 0 };
+
+
+// =============================================================================
+// Private function declarations:
+
+static uint8_t ADCSlots(enum HostADCChannel channel, uint8_t slots[]);
+static void SetAirframeActuationInverse(void);
+
+
+// =============================================================================
+// Accessors:
+
+uint32_t HostFrameCount(void)
+{
+  return frame_count_;
+}
+
+// -----------------------------------------------------------------------------
+uint16_t HostADCSum(enum HostADCChannel channel)
+{
+  // Scaled to ADC_N_SAMPLES samples and rounded as in ScaledSum() (adc.c).
+  uint8_t slots[ADC_N_SLOTS];
+  const uint8_t n_slots = ADCSlots(channel, slots);
+  uint32_t sum = 0;
+  for (uint8_t i = 0; i < n_slots; i++) sum += samples_[slots[i]];
+  return (uint16_t)((sum * ADC_N_SAMPLES + n_slots / 2) / n_slots);
+}
+
+// -----------------------------------------------------------------------------
+uint16_t HostMotorSetpoint(uint8_t i)
+{
+  return motor_setpoints_[i];
+}
+
+
+// =============================================================================
+// Public functions:
+
+void HostBoardInit(void)
+{
+  frame_count_ = 0;
+  ms_timestamp_ = 0;
+  ms_timestamp_high_ = 0;
+  TCNT1 = 0;
+
+  // Offsets that a calibration at rest with HostSetStationarySensors() would
+  // produce (see ZeroAccelerometers() and ZeroGyros() in adc.c).
+  eeprom.acc_offset[X_BODY_AXIS] = -HOST_ADC_MIDDLE_VALUE * ADC_N_SAMPLES;
+  eeprom.acc_offset[Y_BODY_AXIS] = -HOST_ADC_MIDDLE_VALUE * ADC_N_SAMPLES;
+  eeprom.acc_offset[Z_BODY_AXIS] = -HOST_ADC_MIDDLE_VALUE * ADC_N_SAMPLES
+    + ACCELEROMETER_2_2_SCALE * ADC_N_SAMPLES;
+  eeprom.gyro_offset[X_BODY_AXIS] = -HOST_ADC_MIDDLE_VALUE * ADC_N_SAMPLES;
+  eeprom.gyro_offset[Y_BODY_AXIS] = -HOST_ADC_MIDDLE_VALUE * ADC_N_SAMPLES;
+  eeprom.gyro_offset[Z_BODY_AXIS] = HOST_ADC_MIDDLE_VALUE * ADC_N_SAMPLES;
+
+  HostSetStationarySensors();
+
+  TimingInit();
+  PressureSensorInit();
+  SBusInit();
+
+  LoadGyroOffsets();
+  LoadAccelerometerOffsets();
+  ProcessSensorReadings();
+
+  SetAirframeActuationInverse();  // Also runs ControlInit()
+  ResetAttitude();
+}
+
+// -----------------------------------------------------------------------------
+void HostSetADCChannel(enum HostADCChannel channel, uint16_t value)
+{
+  uint8_t slots[ADC_N_SLOTS];
+  const uint8_t n_slots = ADCSlots(channel, slots);
+  for (uint8_t i = 0; i < n_slots; i++) samples_[slots[i]] = value;
+  sample_sums_[channel] = value * n_slots;
+}
+
+// -----------------------------------------------------------------------------
+void HostSetADCSum(enum HostADCChannel channel, float sum)
+{
+  uint8_t slots[ADC_N_SLOTS];
+  const uint8_t n_slots = ADCSlots(channel, slots);
+  int32_t remaining = (int32_t)floor(sum * n_slots / ADC_N_SAMPLES + 0.5);
+  int32_t total = 0;
+  for (uint8_t i = n_slots; i; i--)
+  {
+    // Divide what remains evenly over the samples that remain.
+    int32_t value = (remaining + (int32_t)(i / 2)) / (int32_t)i;
+    if (remaining < 0) value = 0;
+    if (value > HOST_ADC_MAX_VALUE) value = HOST_ADC_MAX_VALUE;
+    samples_[slots[n_slots - i]] = (uint16_t)value;
+    remaining -= value;
+    total += value;
+  }
+  sample_sums_[channel] = (uint16_t)total;
+}
+
+// -----------------------------------------------------------------------------
+void HostSetSensorOffsets(const int16_t acc_offset[3],
+  const int16_t gyro_offset[3])
+{
+  eeprom_update_block((const void*)acc_offset, (void*)&eeprom.acc_offset[0],
+    sizeof(eeprom.acc_offset));
+  eeprom_update_block((const void*)gyro_offset, (void*)&eeprom.gyro_offset[0],
+    sizeof(eeprom.gyro_offset));
+  LoadGyroOffsets();
+  LoadAccelerometerOffsets();
+}
+
+// -----------------------------------------------------------------------------
+void HostSetStationarySensors(void)
+{
+  HostSetADCChannel(HOST_ADC_ACCEL_X, HOST_ADC_MIDDLE_VALUE);
+  HostSetADCChannel(HOST_ADC_ACCEL_Y, HOST_ADC_MIDDLE_VALUE);
+  HostSetADCChannel(HOST_ADC_ACCEL_Z, HOST_ADC_MIDDLE_VALUE);
+  HostSetADCChannel(HOST_ADC_GYRO_X, HOST_ADC_MIDDLE_VALUE);
+  HostSetADCChannel(HOST_ADC_GYRO_Y, HOST_ADC_MIDDLE_VALUE);
+  HostSetADCChannel(HOST_ADC_GYRO_Z, HOST_ADC_MIDDLE_VALUE);
+  HostSetADCChannel(HOST_ADC_PRESSURE, 3 * 1024 / 4);
+  HostSetADCChannel(HOST_ADC_BATT_V, HOST_BATTERY_ADC_VALUE);
+}
+
+// -----------------------------------------------------------------------------
+void HostSetSBusChannels(const int16_t channels[SBUS_FRAME_N_CHANNELS],
+  uint8_t binary)
+{
+  uint8_t frame[SBUS_FRAME_LENGTH];
+  SBusEncodeFrame(channels, binary, frame);
+
+  // The interrupt handler stores the frame (without the start byte) backwards,
+  // followed by the timestamp of the first byte.
+  sbus_buffer_index_ ^= 1;
+  volatile uint8_t * buffer = sbus_rx_buffer_[sbus_buffer_index_];
+  for (uint8_t n = 1; n <= SBUS_MESSAGE_LENGTH; n++)
+    buffer[SBUS_MESSAGE_LENGTH - n] = frame[n];
+  buffer[SBUS_RX_BUFFER_LENGTH - 2] = (uint8_t)ms_timestamp_;
+  buffer[SBUS_RX_BUFFER_LENGTH - 1] = (uint8_t)(ms_timestamp_ >> 8);
+  sbus_data_ready_ = sbus_buffer_index_;
+}
+
+// -----------------------------------------------------------------------------
+void HostRunFrame(void)
+{
+  HostRunOuterLoop();
+  for (uint8_t i = 0; i < RATE_LOOP_FACTOR; i++) HostRunRateLoop();
+}
+
+// -----------------------------------------------------------------------------
+void HostRunOuterLoop(void)
+{
+  frame_count_++;
+  // The clock of timing.c at the start of the frame, down to TIMER1.
+  const uint64_t us = (uint64_t)frame_count_ * 1000000 / (uint32_t)FS;
+  ms_timestamp_ = (uint16_t)(us / 1000);
+  ms_timestamp_high_ = (uint16_t)(us / 1000 >> 16);
+  TCNT1 = (uint16_t)(us % 1000 * (F_CPU / 1000000UL));
+
+  UpdateSBus();
+  UpdateState();
+
+  ProcessSensorReadings();
+
+  UpdateAttitude();
+  UpdatePressureAltitude();
+  UpdateVerticalSpeed();
+
+  Control();
+
+  if (!(frame_count_ & 0x01)) SendDataToNav();
+
+  // The host has no frame to fit into, so the deferred work is done at once.
+  while (RunBackgroundJobs()) continue;
+}
+
+// -----------------------------------------------------------------------------
+void HostRunRateLoop(void)
+{
+  RateControl();
+}
+
+
+// =============================================================================
+// Private functions:
+
+// This function fills "slots" with the indices of the samples of "channel" in
+// the sample array (see adc_schedule_ in adc.c) and returns their number.
+static uint8_t ADCSlots(enum HostADCChannel channel, uint8_t slots[])
+{
+  uint8_t n_slots = 0;
+  for (uint16_t i = 0; i < ADC_N_SLOTS; i++)
+  {
+    if (adc_schedule_[i & (ADC_SCHEDULE_LENGTH - 1)] == channel)
+      slots[n_slots++] = (uint8_t)i;
+  }
+  return n_slots;
+}
+
+// -----------------------------------------------------------------------------
+static void SetAirframeActuationInverse(void)
+{
+  float b_inv[MAX_MOTORS][4] = { { 0.0 } };
+  SetNMotors(AirframeActuationInverse(b_inv));
+  SetActuationInverse(b_inv);
+}
+
+
+// =============================================================================
+// Stand-ins for main.c:
+
+uint8_t BoardVersion(void)
+{
+  return HOST_BOARD_VERSION;
+}
+
+// -----------------------------------------------------------------------------
+void PreflightInit(void)
+{
+  if (!MotorsInhibited()) return;
+  ResetAttitude();
+  ResetRateLoop();
+}
+
+// -----------------------------------------------------------------------------
+void SensorCalibration(void)
+{
+  if (!MotorsInhibited()) return;
+  ResetAttitude();
+  ResetRateLoop();
+}
+
+
+// =============================================================================
+// Stand-ins for buzzer.c:
+
+void BeepPattern(uint32_t beep_pattern)
+{
+  (void)beep_pattern;
+}
+
+
+// =============================================================================
+// Stand-ins for i2c.c:
+
+uint32_t I2CInterruptCycles(void)
+{
+  return 0;
+}
+
+
+// =============================================================================
+// Stand-ins for motors.c:
+
+uint8_t BLCErrorBits(void)
+{
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+uint8_t NMotors(void)
+{
+  return n_motors_;
+}
+
+// -----------------------------------------------------------------------------
+uint8_t MotorsStarting(void)
+{
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+void SetMotorSetpoint(uint8_t address, uint16_t setpoint)
+{
+  if (address < MAX_MOTORS) motor_setpoints_[address] = setpoint;
+}
+
+// -----------------------------------------------------------------------------
+void SetNMotors(uint8_t n_motors)
+{
+  n_motors_ = n_motors;
+  eeprom_update_byte(&eeprom.n_motors, n_motors);
+}
+
+// -----------------------------------------------------------------------------
+void TxMotorSetpoints(void)
+{
+}
+
+
+// =============================================================================
+// Stand-ins for uart.c and ut_serial_protocol.c:
+
+void UARTPrintf_P(const char * format, ...)
+{
+  va_list arguments;
+  va_start(arguments, format);
+  vfprintf(stderr, format, arguments);
+  va_end(arguments);
+  fputc('\n', stderr);
+}
+
+// -----------------------------------------------------------------------------
+void SendPendingUART(void)
+{
+}
+
+// -----------------------------------------------------------------------------
+void UARTTxByte(uint8_t byte)
+{
+  fputc(byte, stderr);
+}
+
+// -----------------------------------------------------------------------------
+uint8_t UTSerialTx(uint8_t id, const uint8_t * source, uint8_t length)
+{
+  (void)id;
+  (void)source;
+  (void)length;
+  return 1;
+}
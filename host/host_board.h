@@ -0,0 +1,107 @@
+// This file declares the host-side stand-in for the FlightCtrl board. It
+// replaces the parts of the firmware that talk to hardware (main.c, buzzer.c,
+// motors.c, uart.c, ...) with minimal implementations and provides helpers to
+// drive the sensor and receiver inputs and to step the 128 Hz frame of the
+// scheduler and the rate loop (see scheduler.c) on the host.
+
+#ifndef HOST_BOARD_H_
+#define HOST_BOARD_H_
+
+
+#include <inttypes.h>
+
+#include "main.h"
+#include "sbus_frame.h"
+
+
+#define HOST_ADC_MIDDLE_VALUE (1023 / 2)
+
+// ADC sample indices (see adc.c).
+enum HostADCChannel {
+  HOST_ADC_ACCEL_X  = 0,
+  HOST_ADC_ACCEL_Y  = 1,
+  HOST_ADC_GYRO_Z   = 2,
+  HOST_ADC_GYRO_X   = 3,
+  HOST_ADC_GYRO_Y   = 4,
+  HOST_ADC_PRESSURE = 5,
+  HOST_ADC_BATT_V   = 6,
+  HOST_ADC_ACCEL_Z  = 7,
+};
+
+
+// =============================================================================
+// Accessors:
+
+// This function returns the sum of the samples of an ADC channel, as
+// ProcessSensorReadings() will see it.
+uint16_t HostADCSum(enum HostADCChannel channel);
+
+// -----------------------------------------------------------------------------
+// This function returns the number of 128 Hz frames executed since
+// HostBoardInit().
+uint32_t HostFrameCount(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the last setpoint that RateControl() sent to motor
+// "i".
+uint16_t HostMotorSetpoint(uint8_t i);
+
+
+// =============================================================================
+// Public functions:
+
+// This function initializes the flight-control core in the same order as
+// Init() in main.c, loads the actuation inverse for the selected airframe, and
+// sets the sensor offsets so that HostSetStationarySensors() reads as level
+// and motionless.
+void HostBoardInit(void);
+
+// -----------------------------------------------------------------------------
+// This function fills every sample of an ADC channel with "value".
+void HostSetADCChannel(enum HostADCChannel channel, uint16_t value);
+
+// -----------------------------------------------------------------------------
+// This function spreads "sum" over the samples of an ADC channel so that their
+// sum, as ProcessSensorReadings() will see it (see HostADCSum()), is as near to
+// "sum" as the number of samples of the channel allows, as a noisy sensor would
+// be on average. Samples are limited to the range of the 10-bit ADC.
+void HostSetADCSum(enum HostADCChannel channel, float sum);
+
+// -----------------------------------------------------------------------------
+// This function replaces the accelerometer and gyro offsets set by
+// HostBoardInit() (for example, with those of a vehicle whose log is being
+// replayed) and reloads them as at power-up.
+void HostSetSensorOffsets(const int16_t acc_offset[3],
+  const int16_t gyro_offset[3]);
+
+// -----------------------------------------------------------------------------
+// This function sets the ADC samples to the readings of a level, motionless
+// vehicle with a charged battery.
+void HostSetStationarySensors(void);
+
+// -----------------------------------------------------------------------------
+// This function encodes a complete SBus frame into the receive buffer exactly
+// as the USART1 interrupt handler in sbus.S would leave it, and marks it as
+// ready (see SBusEncodeFrame()).
+void HostSetSBusChannels(const int16_t channels[SBUS_FRAME_N_CHANNELS],
+  uint8_t binary);
+
+// -----------------------------------------------------------------------------
+// This function runs a 128 Hz frame: the outer loop (HostRunOuterLoop()) and
+// then RATE_LOOP_FACTOR steps of the rate loop, all with the same ADC samples.
+void HostRunFrame(void);
+
+// -----------------------------------------------------------------------------
+// This function advances the clock (see GetTimestamp() and GetMicros()) by one
+// 128 Hz period and runs the flight-control tasks of a scheduler frame (and the
+// 64 Hz nav update when due). The motor setpoints are not updated until
+// HostRunRateLoop() runs.
+void HostRunOuterLoop(void);
+
+// -----------------------------------------------------------------------------
+// This function runs one step of the rate loop, as the TIMER3 compare
+// interrupt does (see scheduler.c), with the ADC samples as they are.
+void HostRunRateLoop(void);
+
+
+#endif  // HOST_BOARD_H_
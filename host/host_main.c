@@ -0,0 +1,67 @@
+// This program runs the flight-control core on the host. The scripted pilot
+// (see pilot.c) arms the vehicle through the same stick sequence a pilot would
+// use and then flies a pattern of stick steps with stationary sensors. The
+// motor setpoints are printed once per simulated second so that the output can
+// be compared between builds, and the execution rate is reported at the end.
+//
+// Usage: UT_FlightCtrl_host [seconds]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "host_board.h"
+#include "motors.h"
+#include "pilot.h"
+#include "state.h"
+
+
+// =============================================================================
+// Private data:
+
+#define DEFAULT_SECONDS (60)
+
+
+// =============================================================================
+// Public functions:
+
+int main(int argc, char * argv[])
+{
+  uint32_t seconds = DEFAULT_SECONDS;
+  if (argc > 1) seconds = strtoul(argv[1], NULL, 0);
+  const uint32_t n_frames = seconds * (uint32_t)FS;
+
+  HostBoardInit();
+
+  struct timespec start, stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (uint32_t i = 0; i < n_frames; i++)
+  {
+    int16_t channels[SBUS_FRAME_N_CHANNELS];
+    uint8_t binary;
+    PilotSticks((uint64_t)HostFrameCount() * 1000 / (uint32_t)FS, channels,
+      &binary);
+    HostSetSBusChannels(channels, binary);
+    HostRunFrame();
+
+    if ((HostFrameCount() % (uint32_t)FS) == 0)
+    {
+      printf("%6lu s state=0x%02X", (unsigned long)(HostFrameCount()
+        / (uint32_t)FS), State());
+      for (uint8_t j = 0; j < NMotors(); j++)
+        printf(" %4u", HostMotorSetpoint(j));
+      printf("\n");
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  double elapsed = (stop.tv_sec - start.tv_sec)
+    + (stop.tv_nsec - start.tv_nsec) * 1e-9;
+  fflush(stdout);
+  fprintf(stderr, "%lu frames in %.3f s (%.0f frames/s, %.0fx real time)\n",
+    (unsigned long)n_frames, elapsed, n_frames / elapsed,
+    n_frames / elapsed / FS);
+
+  return 0;
+}
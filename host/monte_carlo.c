@@ -0,0 +1,313 @@
+// This program flies many software-in-the-loop flights (see sil.h) with
+// randomly perturbed plants and sensors and summarizes how the controller
+// copes. Each flight draws a mass (applied as a change in control
+// effectiveness), a motor time constant, gyro and accelerometer noise, and a
+// gyro bias from the ranges below. The draws depend only on the seed and the
+// flight number, so any flight can be repeated on its own with -r.
+//
+// The firmware modules keep their state in static variables, so each flight
+// runs in its own forked process. Up to one process per core runs at a time and
+// the results are collected in shared memory. The controller itself keeps all
+// of its state in struct ControlContext, which host/contexts_main.c checks.
+//
+// Usage: UT_FlightCtrl_monte_carlo [-n flights] [-j jobs] [-s seed]
+//          [-t seconds] [-o results.csv] [-r flight]
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sil.h"
+
+
+// =============================================================================
+// Private data:
+
+#define DEFAULT_N_FLIGHTS (1000)
+#define DEFAULT_SECONDS (30)
+
+// Ranges of the random draws (uniform). The noise and bias are kept within what
+// the preflight safety check in state.c accepts.
+#define MIN_MASS_SCALE (0.8)
+#define MAX_MASS_SCALE (1.25)
+#define MIN_MOTOR_LAG_SCALE (0.7)
+#define MAX_MOTOR_LAG_SCALE (1.5)
+#define MAX_GYRO_NOISE (0.02)  // rad/s
+#define MAX_ACCELEROMETER_NOISE (0.2)  // m/s^2
+#define MAX_GYRO_BIAS (0.02)  // rad/s
+
+struct Flight {
+  float mass_scale;
+  struct SILOptions options;
+  struct SILResult result;
+  uint8_t done;
+  uint8_t passed;
+};
+
+
+// =============================================================================
+// Private function declarations:
+
+static void DrawFlight(uint32_t seed, uint32_t index, uint32_t seconds,
+  struct Flight * flight);
+static float Uniform(uint32_t * state, float min, float max);
+static int CompareFloats(const void * a, const void * b);
+static float Percentile(const float * sorted, uint32_t n, float fraction);
+static void PrintFlight(FILE * file, uint32_t index,
+  const struct Flight * flight);
+
+
+// =============================================================================
+// Public functions:
+
+int main(int argc, char * argv[])
+{
+  uint32_t n_flights = DEFAULT_N_FLIGHTS, seed = 1, seconds = DEFAULT_SECONDS;
+  long n_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  const char * results_path = NULL;
+  long repeat = -1;
+
+  int option;
+  while ((option = getopt(argc, argv, "n:j:s:t:o:r:")) != -1)
+  {
+    switch (option)
+    {
+      case 'n': n_flights = strtoul(optarg, NULL, 0); break;
+      case 'j': n_jobs = strtol(optarg, NULL, 0); break;
+      case 's': seed = strtoul(optarg, NULL, 0); break;
+      case 't': seconds = strtoul(optarg, NULL, 0); break;
+      case 'o': results_path = optarg; break;
+      case 'r': repeat = strtol(optarg, NULL, 0); break;
+      default:
+        fprintf(stderr, "Usage: %s [-n flights] [-j jobs] [-s seed] "
+          "[-t seconds] [-o results.csv] [-r flight]\n", argv[0]);
+        return 2;
+    }
+  }
+  if (n_jobs < 1) n_jobs = 1;
+
+  // Repeat a single flight in the foreground.
+  if (repeat >= 0)
+  {
+    struct Flight flight;
+    DrawFlight(seed, (uint32_t)repeat, seconds, &flight);
+    flight.options.progress = stdout;
+    flight.passed = SILRun(&flight.options, &flight.result);
+    flight.done = 1;
+    printf("\n");
+    PrintFlight(stdout, (uint32_t)repeat, &flight);
+    return flight.passed ? 0 : 1;
+  }
+
+  struct Flight * flights = mmap(NULL, n_flights * sizeof(struct Flight),
+    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (flights == MAP_FAILED)
+  {
+    perror("mmap");
+    return 2;
+  }
+  for (uint32_t i = 0; i < n_flights; i++)
+    DrawFlight(seed, i, seconds, &flights[i]);
+
+  struct timespec start, stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  uint32_t next = 0, finished = 0;
+  long running = 0;
+  while (finished < n_flights)
+  {
+    while ((running < n_jobs) && (next < n_flights))
+    {
+      pid_t pid = fork();
+      if (pid < 0)
+      {
+        perror("fork");
+        return 2;
+      }
+      if (pid == 0)
+      {
+        struct Flight * flight = &flights[next];
+        flight->passed = SILRun(&flight->options, &flight->result);
+        flight->done = 1;
+        _exit(0);
+      }
+      running++;
+      next++;
+    }
+
+    int status;
+    if (wait(&status) > 0)
+    {
+      running--;
+      finished++;
+      if ((finished % 100) == 0)
+        fprintf(stderr, "\r%lu / %lu flights", (unsigned long)finished,
+          (unsigned long)n_flights);
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  double elapsed = (stop.tv_sec - start.tv_sec)
+    + (stop.tv_nsec - start.tv_nsec) * 1e-9;
+  fprintf(stderr, "\r%lu flights of %lu s in %.1f s on %ld processes\n",
+    (unsigned long)n_flights, (unsigned long)seconds, elapsed, n_jobs);
+
+  // Per-flight results.
+  if (results_path)
+  {
+    FILE * results = fopen(results_path, "w");
+    if (!results)
+    {
+      perror(results_path);
+      return 2;
+    }
+    fprintf(results, "flight,mass_scale,motor_lag_scale,gyro_noise,"
+      "accelerometer_noise,gyro_bias_x,gyro_bias_y,gyro_bias_z,passed,"
+      "tracking_rms,tracking_max,estimation_rms,estimation_max,tilt_max,"
+      "angular_rate_max,vertical_speed_rms,final_altitude\n");
+    for (uint32_t i = 0; i < n_flights; i++)
+    {
+      const struct Flight * f = &flights[i];
+      fprintf(results, "%lu,%.4f,%.4f,%.5f,%.4f,%.5f,%.5f,%.5f,%u,%.5f,%.5f,"
+        "%.5f,%.5f,%.5f,%.4f,%.4f,%.3f\n", (unsigned long)i, f->mass_scale,
+        f->options.motor_lag_scale, f->options.gyro_noise,
+        f->options.accelerometer_noise, f->options.gyro_bias[0],
+        f->options.gyro_bias[1], f->options.gyro_bias[2], f->passed,
+        f->result.tracking.rms, f->result.tracking.max,
+        f->result.estimation.rms, f->result.estimation.max,
+        f->result.tilt.max, f->result.angular_rate.max,
+        f->result.vertical_speed.rms, f->result.final_altitude);
+    }
+    fclose(results);
+  }
+
+  // Summary.
+  float * tracking = malloc(n_flights * sizeof(float));
+  float * estimation = malloc(n_flights * sizeof(float));
+  uint32_t n_passed = 0, n_completed = 0, worst = 0;
+  for (uint32_t i = 0; i < n_flights; i++)
+  {
+    if (!flights[i].done) continue;
+    tracking[n_completed] = flights[i].result.tracking.rms;
+    estimation[n_completed] = flights[i].result.estimation.rms;
+    n_completed++;
+    n_passed += flights[i].passed;
+    if (flights[i].result.tracking.rms > flights[worst].result.tracking.rms)
+      worst = i;
+  }
+  qsort(tracking, n_completed, sizeof(float), CompareFloats);
+  qsort(estimation, n_completed, sizeof(float), CompareFloats);
+
+  const float kDegrees = 180.0 / M_PI;
+  printf("passed                       %lu / %lu", (unsigned long)n_passed,
+    (unsigned long)n_flights);
+  if (n_completed < n_flights)
+    printf(" (%lu crashed)", (unsigned long)(n_flights - n_completed));
+  printf("\n");
+  printf("                               median      95 %%       max\n");
+  printf("attitude tracking rms (deg) %8.2f  %8.2f  %8.2f\n",
+    Percentile(tracking, n_completed, 0.5) * kDegrees,
+    Percentile(tracking, n_completed, 0.95) * kDegrees,
+    Percentile(tracking, n_completed, 1.0) * kDegrees);
+  printf("attitude estimate rms (deg) %8.2f  %8.2f  %8.2f\n",
+    Percentile(estimation, n_completed, 0.5) * kDegrees,
+    Percentile(estimation, n_completed, 0.95) * kDegrees,
+    Percentile(estimation, n_completed, 1.0) * kDegrees);
+
+  printf("\nworst tracking:\n");
+  PrintFlight(stdout, worst, &flights[worst]);
+  for (uint32_t i = 0, n = 0; (i < n_flights) && (n < 10); i++)
+  {
+    if (flights[i].passed) continue;
+    if (!n++) printf("\nfailed flights:\n");
+    PrintFlight(stdout, i, &flights[i]);
+  }
+
+  free(tracking);
+  free(estimation);
+  munmap(flights, n_flights * sizeof(struct Flight));
+
+  return (n_passed == n_flights) ? 0 : 1;
+}
+
+
+// =============================================================================
+// Private functions:
+
+// This function draws the parameters of flight "index".
+static void DrawFlight(uint32_t seed, uint32_t index, uint32_t seconds,
+  struct Flight * flight)
+{
+  // Mix the seed and index so that neighboring flights are uncorrelated.
+  uint32_t state = (seed * 0x9E3779B9UL) ^ (index * 0x85EBCA6BUL)
+    ^ 0xC2B2AE35UL;
+  if (!state) state = 1;
+
+  memset(flight, 0, sizeof(*flight));
+  SILDefaultOptions(&flight->options);
+  flight->options.seconds = seconds;
+  flight->mass_scale = Uniform(&state, MIN_MASS_SCALE, MAX_MASS_SCALE);
+  flight->options.effectiveness_scale = 1.0 / flight->mass_scale;
+  flight->options.motor_lag_scale = Uniform(&state, MIN_MOTOR_LAG_SCALE,
+    MAX_MOTOR_LAG_SCALE);
+  flight->options.gyro_noise = Uniform(&state, 0.0, MAX_GYRO_NOISE);
+  flight->options.accelerometer_noise = Uniform(&state, 0.0,
+    MAX_ACCELEROMETER_NOISE);
+  for (uint8_t j = 0; j < 3; j++)
+    flight->options.gyro_bias[j] = Uniform(&state, -MAX_GYRO_BIAS,
+      MAX_GYRO_BIAS);
+  flight->options.seed = state;
+}
+
+// -----------------------------------------------------------------------------
+static float Uniform(uint32_t * state, float min, float max)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return min + (max - min) * (float)(*state >> 8) / (float)(1UL << 24);
+}
+
+// -----------------------------------------------------------------------------
+static int CompareFloats(const void * a, const void * b)
+{
+  float difference = *(const float *)a - *(const float *)b;
+  return (difference > 0.0) - (difference < 0.0);
+}
+
+// -----------------------------------------------------------------------------
+static float Percentile(const float * sorted, uint32_t n, float fraction)
+{
+  if (!n) return 0.0;
+  uint32_t i = (uint32_t)(fraction * (float)(n - 1) + 0.5);
+  return sorted[i];
+}
+
+// -----------------------------------------------------------------------------
+static void PrintFlight(FILE * file, uint32_t index,
+  const struct Flight * flight)
+{
+  const float kDegrees = 180.0 / M_PI;
+  fprintf(file, "  flight %lu: mass x%.2f, motor lag x%.2f, gyro noise %.3f "
+    "rad/s, accel noise %.2f m/s^2, gyro bias (%+.3f, %+.3f, %+.3f) rad/s\n",
+    (unsigned long)index, flight->mass_scale, flight->options.motor_lag_scale,
+    flight->options.gyro_noise, flight->options.accelerometer_noise,
+    flight->options.gyro_bias[0], flight->options.gyro_bias[1],
+    flight->options.gyro_bias[2]);
+  if (!flight->done)
+  {
+    fprintf(file, "    did not complete\n");
+    return;
+  }
+  fprintf(file, "    %s: tracking %.2f deg rms, estimate %.2f deg rms, "
+    "max tilt %.1f deg\n", flight->passed ? "passed" : (flight->result
+    .lost_control ? "lost control" : "not flying"), flight->result.tracking.rms
+    * kDegrees, flight->result.estimation.rms * kDegrees,
+    flight->result.tilt.max * kDegrees);
+}
@@ -0,0 +1,76 @@
+#include "pilot.h"
+
+#include "sbus.h"
+
+
+// =============================================================================
+// Private data:
+
+// Default EEPROM channel map (see eeprom.c).
+enum PilotChannels {
+  PILOT_CHANNEL_YAW = 0,
+  PILOT_CHANNEL_THRUST = 1,
+  PILOT_CHANNEL_PITCH = 2,
+  PILOT_CHANNEL_ROLL = 3,
+  PILOT_CHANNEL_NAV = 5,
+  PILOT_CHANNEL_GO_HOME = 6,
+  PILOT_CHANNEL_TAKEOFF = 7,
+};
+
+static int16_t flight_thrust_ = SBUS_MAX / 4;
+
+
+// =============================================================================
+// Public functions:
+
+// This function sets the thrust stick position held during the stick pattern.
+void PilotSetFlightThrust(int16_t thrust)
+{
+  flight_thrust_ = thrust;
+}
+
+// -----------------------------------------------------------------------------
+// This function returns the receiver inputs at time "ms" after power-on.
+void PilotSticks(uint32_t ms, int16_t channels[SBUS_FRAME_N_CHANNELS],
+  uint8_t * binary)
+{
+  for (uint8_t i = 0; i < SBUS_FRAME_N_CHANNELS; i++) channels[i] = 0;
+  channels[PILOT_CHANNEL_THRUST] = -SBUS_MAX;
+  channels[PILOT_CHANNEL_NAV] = -SBUS_MAX;
+  channels[PILOT_CHANNEL_GO_HOME] = -SBUS_MAX;
+  channels[PILOT_CHANNEL_TAKEOFF] = -SBUS_MAX;
+  *binary = 0;
+
+  if (ms < 3000)
+  {
+    // Sticks neutral while the board boots.
+  }
+  else if (ms < 5000)
+  {
+    // Thrust up and yaw left for 1 s: preflight initialization. On the board
+    // this blocks for about 2 s (gyro zeroing, pressure range, and buzzer).
+    channels[PILOT_CHANNEL_THRUST] = SBUS_MAX;
+    channels[PILOT_CHANNEL_YAW] = SBUS_MAX;
+  }
+  else if (ms < 7500)
+  {
+    // Sticks neutral.
+  }
+  else if (ms < PILOT_FLYING_MS)
+  {
+    // On/off switch with thrust down: start the motors after 1 s.
+    *binary = SBUS_FRAME_BINARY_BIT_CHANNEL_17;
+  }
+  else
+  {
+    // Fly a repeating pattern of stick steps, starting with neutral sticks.
+    uint32_t phase = ((ms - PILOT_FLYING_MS) / 1000) % 8;
+    channels[PILOT_CHANNEL_THRUST] = flight_thrust_;
+    channels[PILOT_CHANNEL_PITCH] = (phase == 1) ? SBUS_MAX / 2
+      : (phase == 2) ? -SBUS_MAX / 2 : 0;
+    channels[PILOT_CHANNEL_ROLL] = (phase == 3) ? SBUS_MAX / 2
+      : (phase == 4) ? -SBUS_MAX / 2 : 0;
+    channels[PILOT_CHANNEL_YAW] = (phase == 5) ? SBUS_MAX / 3
+      : (phase == 6) ? -SBUS_MAX / 3 : 0;
+  }
+}
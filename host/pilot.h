@@ -0,0 +1,32 @@
+// This file declares a scripted pilot that produces receiver inputs for the
+// host build and the simulator. The script waits for the board to boot, runs
+// the preflight initialization (thrust up, yaw left), starts the motors (on/off
+// switch with thrust down), and then flies a repeating pattern of stick steps.
+
+#ifndef HOST_PILOT_H_
+#define HOST_PILOT_H_
+
+
+#include <inttypes.h>
+
+#include "sbus_frame.h"
+
+
+// Time (ms from power-on) after which the motors are running.
+#define PILOT_FLYING_MS (10000)
+
+
+// =============================================================================
+// Public functions:
+
+// This function sets the thrust stick position held during the stick pattern
+// (SBUS_MAX / 4 by default).
+void PilotSetFlightThrust(int16_t thrust);
+
+// -----------------------------------------------------------------------------
+// This function returns the receiver inputs at time "ms" after power-on.
+void PilotSticks(uint32_t ms, int16_t channels[SBUS_FRAME_N_CHANNELS],
+  uint8_t * binary);
+
+
+#endif  // HOST_PILOT_H_
@@ -0,0 +1,374 @@
+#include "plant.h"
+
+#include <string.h>
+
+#include "adc.h"
+#include "airframe.h"
+#include "host_board.h"
+#include "main.h"
+
+
+// =============================================================================
+// Private data:
+
+// Pressure reading on the ground and the conversion from the pressure sum to
+// altitude that pressure_altitude.c uses before the range has been set.
+#define PLANT_GROUND_PRESSURE_ADC_VALUE (3 * 1024 / 4)
+#define PLANT_PRESSURE_SUM_TO_ALTITUDE (-0.2)  // m / LSB
+
+// Airframe parameters that are not captured by the actuation inverse. The
+// motor time constants match the motor lag assumed by ControlInit().
+#if defined BI_OCTO
+  #define PLANT_MOTOR_TIME_CONSTANT (0.07)  // s
+  #define PLANT_DRAG_COEFFICIENT (0.3)  // (m/s^2) / (m/s)
+#elif defined BI_QUAD
+  #define PLANT_MOTOR_TIME_CONSTANT (0.07)  // s
+  #define PLANT_DRAG_COEFFICIENT (0.3)  // (m/s^2) / (m/s)
+#elif defined HEXA690
+  #define PLANT_MOTOR_TIME_CONSTANT (0.07)  // s
+  #define PLANT_DRAG_COEFFICIENT (0.3)  // (m/s^2) / (m/s)
+#elif defined QUAD475_12
+  #define PLANT_MOTOR_TIME_CONSTANT (0.07)  // s
+  #define PLANT_DRAG_COEFFICIENT (0.4)  // (m/s^2) / (m/s)
+#elif defined SMALL_QUAD
+  #define PLANT_MOTOR_TIME_CONSTANT (0.1)  // s
+  #define PLANT_DRAG_COEFFICIENT (0.5)  // (m/s^2) / (m/s)
+#else  // Large quad
+  #define PLANT_MOTOR_TIME_CONSTANT (0.07)  // s
+  #define PLANT_DRAG_COEFFICIENT (0.3)  // (m/s^2) / (m/s)
+#endif
+
+static uint8_t n_motors_ = 0, on_ground_ = 1;
+static float actuation_[4][MAX_MOTORS];  // (rad/s^2, m/s^2) / setpoint
+static float motor_time_constant_ = PLANT_MOTOR_TIME_CONSTANT;
+static float motor_[MAX_MOTORS];  // Setpoint after the motor lag
+static float quat_[4], angular_rate_[3];
+static float position_[3], velocity_[3];
+static float specific_force_[3];  // Accelerometer reading (m/s^2, body axes)
+static float gyro_noise_ = 0.0, accelerometer_noise_ = 0.0;
+static float gyro_bias_[3] = { 0.0 };
+static uint32_t random_state_ = 1;
+
+
+// =============================================================================
+// Private function declarations:
+
+static void Actuation(const float b_inv[MAX_MOTORS][4], uint8_t n_motors,
+  float effectiveness_scale, float actuation[4][MAX_MOTORS]);
+static void BodyToWorld(const float quat[4], const float v_b[3],
+  float v_w[3]);
+static void WorldToBody(const float quat[4], const float v_w[3],
+  float v_b[3]);
+static float RandomNormal(void);
+static void RotateQuaternion(float quat[4], const float angular_rate[3],
+  float dt);
+static void SetGyroSums(const float angular_rate[3]);
+
+
+// =============================================================================
+// Accessors:
+
+const float * PlantAngularRateVector(void)
+{
+  return angular_rate_;
+}
+
+// -----------------------------------------------------------------------------
+float PlantHoverSetpoint(void)
+{
+  float thrust_per_setpoint = 0.0;
+  for (uint8_t i = 0; i < n_motors_; i++)
+    thrust_per_setpoint += actuation_[3][i];
+  return -GRAVITY_ACCELERATION / thrust_per_setpoint;
+}
+
+// -----------------------------------------------------------------------------
+uint8_t PlantOnGround(void)
+{
+  return on_ground_;
+}
+
+// -----------------------------------------------------------------------------
+const float * PlantPositionVector(void)
+{
+  return position_;
+}
+
+// -----------------------------------------------------------------------------
+const float * PlantQuat(void)
+{
+  return quat_;
+}
+
+// -----------------------------------------------------------------------------
+const float * PlantVelocityVector(void)
+{
+  return velocity_;
+}
+
+
+// =============================================================================
+// Public functions:
+
+void PlantInit(float effectiveness_scale, float motor_lag_scale)
+{
+  float b_inv[MAX_MOTORS][4] = { { 0.0 } };
+  n_motors_ = AirframeActuationInverse(b_inv);
+  Actuation(b_inv, n_motors_, effectiveness_scale, actuation_);
+  motor_time_constant_ = PLANT_MOTOR_TIME_CONSTANT * motor_lag_scale;
+
+  memset(motor_, 0, sizeof(motor_));
+  quat_[0] = 1.0;
+  quat_[1] = 0.0;
+  quat_[2] = 0.0;
+  quat_[3] = 0.0;
+  memset(angular_rate_, 0, sizeof(angular_rate_));
+  memset(position_, 0, sizeof(position_));
+  memset(velocity_, 0, sizeof(velocity_));
+  specific_force_[X_BODY_AXIS] = 0.0;
+  specific_force_[Y_BODY_AXIS] = 0.0;
+  specific_force_[Z_BODY_AXIS] = -GRAVITY_ACCELERATION;
+  on_ground_ = 1;
+
+  gyro_noise_ = 0.0;
+  accelerometer_noise_ = 0.0;
+  memset(gyro_bias_, 0, sizeof(gyro_bias_));
+  random_state_ = 1;
+}
+
+// -----------------------------------------------------------------------------
+void PlantSetSensorErrors(float gyro_noise, float accelerometer_noise,
+  const float gyro_bias[3], uint32_t seed)
+{
+  gyro_noise_ = gyro_noise;
+  accelerometer_noise_ = accelerometer_noise;
+  for (uint8_t j = 0; j < 3; j++) gyro_bias_[j] = gyro_bias[j];
+  random_state_ = seed ? seed : 1;
+}
+
+// -----------------------------------------------------------------------------
+void PlantUpdate(const uint16_t setpoints[], float dt)
+{
+  // First-order motor response.
+  float k_lag = 1.0 - exp(-dt / motor_time_constant_);
+  for (uint8_t i = 0; i < n_motors_; i++)
+    motor_[i] += ((float)setpoints[i] - motor_[i]) * k_lag;
+
+  float angular_acceleration[3] = { 0.0 }, thrust = 0.0;
+  for (uint8_t i = 0; i < n_motors_; i++)
+  {
+    angular_acceleration[X_BODY_AXIS] += actuation_[0][i] * motor_[i];
+    angular_acceleration[Y_BODY_AXIS] += actuation_[1][i] * motor_[i];
+    angular_acceleration[Z_BODY_AXIS] += actuation_[2][i] * motor_[i];
+    thrust += actuation_[3][i] * motor_[i];
+  }
+
+  // Thrust along the body z axis plus linear drag, rotated to the world frame.
+  float velocity_b[3], force_b[3], acceleration[3];
+  WorldToBody(quat_, velocity_, velocity_b);
+  force_b[X_BODY_AXIS] = -PLANT_DRAG_COEFFICIENT * velocity_b[X_BODY_AXIS];
+  force_b[Y_BODY_AXIS] = -PLANT_DRAG_COEFFICIENT * velocity_b[Y_BODY_AXIS];
+  force_b[Z_BODY_AXIS] = thrust - PLANT_DRAG_COEFFICIENT
+    * velocity_b[Z_BODY_AXIS];
+  BodyToWorld(quat_, force_b, acceleration);
+  acceleration[D_WORLD_AXIS] += GRAVITY_ACCELERATION;
+
+  // The ground holds the vehicle level until the thrust exceeds its weight.
+  on_ground_ = (position_[D_WORLD_AXIS] >= 0.0)
+    && (acceleration[D_WORLD_AXIS] >= 0.0);
+  if (on_ground_)
+  {
+    float norm = sqrt(quat_[0] * quat_[0] + quat_[3] * quat_[3]);
+    quat_[0] = norm > 0.0 ? quat_[0] / norm : 1.0;
+    quat_[1] = 0.0;
+    quat_[2] = 0.0;
+    quat_[3] = norm > 0.0 ? quat_[3] / norm : 0.0;
+    memset(angular_rate_, 0, sizeof(angular_rate_));
+    memset(velocity_, 0, sizeof(velocity_));
+    memset(acceleration, 0, sizeof(acceleration));
+    position_[D_WORLD_AXIS] = 0.0;
+  }
+  else
+  {
+    for (uint8_t j = 0; j < 3; j++)
+    {
+      angular_rate_[j] += angular_acceleration[j] * dt;
+      velocity_[j] += acceleration[j] * dt;
+      position_[j] += velocity_[j] * dt;
+    }
+    RotateQuaternion(quat_, angular_rate_, dt);
+  }
+
+  // The accelerometer measures everything but gravity.
+  acceleration[D_WORLD_AXIS] -= GRAVITY_ACCELERATION;
+  WorldToBody(quat_, acceleration, specific_force_);
+}
+
+// -----------------------------------------------------------------------------
+void PlantSetSensors(void)
+{
+  // Inverse of the conversions in ProcessSensorReadings() given the offsets
+  // set by HostBoardInit().
+  const float kMiddle = HOST_ADC_MIDDLE_VALUE * ADC_N_SAMPLES;
+  const float kAccelerometerScale = (float)(ACCELEROMETER_SCALE
+    * ADC_N_SAMPLES) / GRAVITY_ACCELERATION;
+  const float kAccelerometerZScale = (float)(ACCELEROMETER_2_2_SCALE
+    * ADC_N_SAMPLES) / GRAVITY_ACCELERATION;
+
+  float acceleration[3], angular_rate[3];
+  for (uint8_t j = 0; j < 3; j++)
+  {
+    acceleration[j] = specific_force_[j] + accelerometer_noise_
+      * RandomNormal();
+    angular_rate[j] = angular_rate_[j] + gyro_bias_[j] + gyro_noise_
+      * RandomNormal();
+  }
+
+  HostSetADCSum(HOST_ADC_ACCEL_X, kMiddle - acceleration[X_BODY_AXIS]
+    * kAccelerometerScale);
+  HostSetADCSum(HOST_ADC_ACCEL_Y, kMiddle - acceleration[Y_BODY_AXIS]
+    * kAccelerometerScale);
+  HostSetADCSum(HOST_ADC_ACCEL_Z, kMiddle - (acceleration[Z_BODY_AXIS]
+    + GRAVITY_ACCELERATION) * kAccelerometerZScale);
+  SetGyroSums(angular_rate);
+  HostSetADCSum(HOST_ADC_PRESSURE, PLANT_GROUND_PRESSURE_ADC_VALUE
+    * ADC_N_SAMPLES - position_[D_WORLD_AXIS] / PLANT_PRESSURE_SUM_TO_ALTITUDE);
+}
+
+// -----------------------------------------------------------------------------
+void PlantSetGyros(void)
+{
+  float angular_rate[3];
+  for (uint8_t j = 0; j < 3; j++)
+  {
+    angular_rate[j] = angular_rate_[j] + gyro_bias_[j] + gyro_noise_
+      * RandomNormal();
+  }
+  SetGyroSums(angular_rate);
+}
+
+
+// =============================================================================
+// Private functions:
+
+// This function computes the actuation matrix (angular accelerations and
+// vertical acceleration per unit setpoint) as the pseudo-inverse of the
+// actuation inverse: (B_inv' B_inv)^-1 B_inv'.
+static void Actuation(const float b_inv[MAX_MOTORS][4], uint8_t n_motors,
+  float effectiveness_scale, float actuation[4][MAX_MOTORS])
+{
+  // Form [B_inv' B_inv | B_inv'] and reduce it with Gauss-Jordan elimination.
+  float a[4][4 + MAX_MOTORS] = { { 0.0 } };
+  for (uint8_t j = 0; j < 4; j++)
+  {
+    for (uint8_t k = 0; k < 4; k++)
+      for (uint8_t i = 0; i < n_motors; i++)
+        a[j][k] += b_inv[i][j] * b_inv[i][k];
+    for (uint8_t i = 0; i < n_motors; i++) a[j][4 + i] = b_inv[i][j];
+  }
+
+  for (uint8_t j = 0; j < 4; j++)
+  {
+    uint8_t pivot = j;
+    for (uint8_t k = j + 1; k < 4; k++)
+      if (fabs(a[k][j]) > fabs(a[pivot][j])) pivot = k;
+    for (uint8_t k = 0; k < 4 + MAX_MOTORS; k++)
+    {
+      float temp = a[j][k];
+      a[j][k] = a[pivot][k];
+      a[pivot][k] = temp;
+    }
+
+    float scale = 1.0 / a[j][j];
+    for (uint8_t k = 0; k < 4 + MAX_MOTORS; k++) a[j][k] *= scale;
+    for (uint8_t row = 0; row < 4; row++)
+    {
+      if (row == j) continue;
+      float factor = a[row][j];
+      for (uint8_t k = 0; k < 4 + MAX_MOTORS; k++)
+        a[row][k] -= factor * a[j][k];
+    }
+  }
+
+  for (uint8_t j = 0; j < 4; j++)
+    for (uint8_t i = 0; i < MAX_MOTORS; i++)
+      actuation[j][i] = a[j][4 + i] * effectiveness_scale;
+}
+
+// -----------------------------------------------------------------------------
+static void BodyToWorld(const float quat[4], const float v_b[3], float v_w[3])
+{
+  const float q0 = quat[0], q1 = quat[1], q2 = quat[2], q3 = quat[3];
+  v_w[0] = (1.0 - 2.0 * (q2 * q2 + q3 * q3)) * v_b[0]
+    + 2.0 * (q1 * q2 - q0 * q3) * v_b[1] + 2.0 * (q1 * q3 + q0 * q2) * v_b[2];
+  v_w[1] = 2.0 * (q1 * q2 + q0 * q3) * v_b[0]
+    + (1.0 - 2.0 * (q1 * q1 + q3 * q3)) * v_b[1]
+    + 2.0 * (q2 * q3 - q0 * q1) * v_b[2];
+  v_w[2] = 2.0 * (q1 * q3 - q0 * q2) * v_b[0] + 2.0 * (q2 * q3 + q0 * q1)
+    * v_b[1] + (1.0 - 2.0 * (q1 * q1 + q2 * q2)) * v_b[2];
+}
+
+// -----------------------------------------------------------------------------
+static void WorldToBody(const float quat[4], const float v_w[3], float v_b[3])
+{
+  const float quat_inverse[4] = { quat[0], -quat[1], -quat[2], -quat[3] };
+  BodyToWorld(quat_inverse, v_w, v_b);
+}
+
+// -----------------------------------------------------------------------------
+// This function returns a normally distributed random number (zero mean, unit
+// variance) from a xorshift generator and the Box-Muller transform.
+static float RandomNormal(void)
+{
+  float u[2];
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    random_state_ ^= random_state_ << 13;
+    random_state_ ^= random_state_ >> 17;
+    random_state_ ^= random_state_ << 5;
+    u[i] = ((float)(random_state_ >> 8) + 0.5) / (float)(1UL << 24);
+  }
+  return sqrt(-2.0 * log(u[0])) * cos(2.0 * M_PI * u[1]);
+}
+
+// -----------------------------------------------------------------------------
+// This function rotates the attitude quaternion by the exact rotation that a
+// constant angular rate produces over "dt".
+static void RotateQuaternion(float quat[4], const float angular_rate[3],
+  float dt)
+{
+  float rate = sqrt(angular_rate[0] * angular_rate[0] + angular_rate[1]
+    * angular_rate[1] + angular_rate[2] * angular_rate[2]);
+  if (rate < 1.0e-9) return;
+
+  float half_angle = 0.5 * rate * dt;
+  float s = sin(half_angle) / rate;
+  const float d[4] = { cos(half_angle), angular_rate[0] * s,
+    angular_rate[1] * s, angular_rate[2] * s };
+
+  float result[4];
+  result[0] = quat[0] * d[0] - quat[1] * d[1] - quat[2] * d[2] - quat[3] * d[3];
+  result[1] = quat[0] * d[1] + quat[1] * d[0] + quat[2] * d[3] - quat[3] * d[2];
+  result[2] = quat[0] * d[2] - quat[1] * d[3] + quat[2] * d[0] + quat[3] * d[1];
+  result[3] = quat[0] * d[3] + quat[1] * d[2] - quat[2] * d[1] + quat[3] * d[0];
+
+  float norm = sqrt(result[0] * result[0] + result[1] * result[1] + result[2]
+    * result[2] + result[3] * result[3]);
+  for (uint8_t i = 0; i < 4; i++) quat[i] = result[i] / norm;
+}
+
+// -----------------------------------------------------------------------------
+// This function writes the given gyro readings (rad/s, body axes) into the ADC
+// samples.
+static void SetGyroSums(const float angular_rate[3])
+{
+  const float kMiddle = HOST_ADC_MIDDLE_VALUE * ADC_N_SAMPLES;
+  const float kGyroScale = GYRO_SCALE * ADC_N_SAMPLES;
+
+  HostSetADCSum(HOST_ADC_GYRO_X, kMiddle - angular_rate[X_BODY_AXIS]
+    * kGyroScale);
+  HostSetADCSum(HOST_ADC_GYRO_Y, kMiddle - angular_rate[Y_BODY_AXIS]
+    * kGyroScale);
+  HostSetADCSum(HOST_ADC_GYRO_Z, kMiddle + angular_rate[Z_BODY_AXIS]
+    * kGyroScale);
+}
@@ -0,0 +1,81 @@
+// This file declares a rigid-body model of the multicopter for closed-loop
+// software-in-the-loop runs of the host build. The plant takes the motor
+// setpoints from RateControl(), passes them through a first-order motor lag,
+// and applies the resulting angular and vertical accelerations through the
+// actuation matrix of the airframe selected at build time (the pseudo-inverse
+// of the actuation inverse in airframe.c). The gyro, accelerometer, and
+// pressure readings of the resulting motion are written back into the ADC
+// samples so that the firmware sees the vehicle move.
+//
+// Coordinates follow the firmware: body axes are forward, right, down, the
+// world axes are north, east, down, and the attitude quaternion rotates body
+// vectors into the world frame (see UpdateGravityInBody() in attitude.c).
+
+#ifndef HOST_PLANT_H_
+#define HOST_PLANT_H_
+
+
+#include <inttypes.h>
+
+
+// =============================================================================
+// Accessors:
+
+// This function returns the angular rate of the plant (rad/s, body axes).
+const float * PlantAngularRateVector(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the motor setpoint that holds the plant in a hover.
+float PlantHoverSetpoint(void);
+
+// -----------------------------------------------------------------------------
+// This function returns 1 while the plant is resting on the ground.
+uint8_t PlantOnGround(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the position of the plant relative to the starting
+// point (m, world axes).
+const float * PlantPositionVector(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the attitude quaternion of the plant.
+const float * PlantQuat(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the velocity of the plant (m/s, world axes).
+const float * PlantVelocityVector(void);
+
+
+// =============================================================================
+// Public functions:
+
+// This function places the plant level and motionless on the ground with
+// perfect sensors. The control effectiveness and motor time constant of the
+// model can be scaled from their nominal values (1.0) to check the robustness
+// of the controller to modeling errors.
+void PlantInit(float effectiveness_scale, float motor_lag_scale);
+
+// -----------------------------------------------------------------------------
+// This function adds white noise with the given standard deviations (rad/s and
+// m/s^2, per 128 Hz reading) and a constant bias (rad/s) to the gyro and
+// accelerometer readings. The noise sequence is determined by "seed".
+void PlantSetSensorErrors(float gyro_noise, float accelerometer_noise,
+  const float gyro_bias[3], uint32_t seed);
+
+// -----------------------------------------------------------------------------
+// This function advances the plant by "dt" seconds with the given motor
+// setpoints held constant.
+void PlantUpdate(const uint16_t setpoints[], float dt);
+
+// -----------------------------------------------------------------------------
+// This function writes the sensor readings corresponding to the current state
+// of the plant into the ADC samples (see HostSetADCSum()).
+void PlantSetSensors(void);
+
+// -----------------------------------------------------------------------------
+// This function writes only the gyro readings, for the steps of the rate loop
+// within a frame (the other sensors are read once per frame).
+void PlantSetGyros(void);
+
+
+#endif  // HOST_PLANT_H_
@@ -0,0 +1,213 @@
+// This program replays a binary flight log (see flight_log.h) through the
+// flight-control core on the host. The configuration in the log header (motor
+// count, actuation inverse, and sensor offsets) replaces that of the host
+// build, and then each frame's raw ADC sums, SBus channels, and NaviCtrl
+// packets are fed in before the outer loop of the 128 Hz frame is run, and the
+// gyro sums of each step of the rate loop before that step is run. The motor
+// setpoints that each step produces are compared with those in the log, and a
+// report of the differences is printed. The program exits with a failure
+// status if any setpoint differs by more than the tolerance (-t, default 0).
+// With -c, the logged and replayed setpoints of every step are written to a CSV
+// file.
+//
+// For an exact reproduction, the log must start at power-up and the host must
+// be built for the same airframe (the gains in ControlInit() depend on it).
+//
+// Usage: UT_FlightCtrl_replay [-t tolerance] [-c csv_file] flight_log
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "airframe.h"
+#include "control.h"
+#include "flight_log.h"
+#include "host_board.h"
+#include "motors.h"
+#include "nav_comms.h"
+
+
+// =============================================================================
+// Private data:
+
+#define MAX_REPORTED_DIFFERENCES (10)
+
+struct MotorDifference {
+  uint32_t n_frames;  // Frames in which the setpoint differed
+  uint16_t max;  // Largest absolute difference
+  uint32_t max_frame;
+  uint8_t max_step;
+};
+
+
+// =============================================================================
+// Public functions:
+
+int main(int argc, char * argv[])
+{
+  uint16_t tolerance = 0;
+  const char * csv_path = NULL;
+  int option;
+  while ((option = getopt(argc, argv, "t:c:")) != -1)
+  {
+    switch (option)
+    {
+      case 't': tolerance = (uint16_t)strtoul(optarg, NULL, 0); break;
+      case 'c': csv_path = optarg; break;
+      default:
+        fprintf(stderr, "Usage: %s [-t tolerance] [-c csv_file] "
+          "flight_log\n", argv[0]);
+        return 2;
+    }
+  }
+  if (optind >= argc)
+  {
+    fprintf(stderr, "%s: missing flight_log\n", argv[0]);
+    return 2;
+  }
+  const char * log_path = argv[optind];
+
+  FILE * log = fopen(log_path, "rb");
+  if (!log)
+  {
+    perror(log_path);
+    return 2;
+  }
+  struct FlightLogHeader header;
+  if (FlightLogReadHeader(log, &header))
+  {
+    fprintf(stderr, "%s: not a version %u flight log with %u rate loop steps "
+      "per frame\n", log_path, FLIGHT_LOG_VERSION, RATE_LOOP_FACTOR);
+    return 2;
+  }
+  if (strcmp(header.airframe, AirframeName()))
+  {
+    fprintf(stderr, "warning: log is from a %s build but this is a %s build; "
+      "the gains will differ\n", header.airframe, AirframeName());
+  }
+
+  FILE * csv = NULL;
+  if (csv_path)
+  {
+    csv = fopen(csv_path, "w");
+    if (!csv)
+    {
+      perror(csv_path);
+      return 2;
+    }
+    fprintf(csv, "frame,step,timestamp");
+    for (uint8_t j = 0; j < header.n_motors; j++) fprintf(csv, ",logged%u", j);
+    for (uint8_t j = 0; j < header.n_motors; j++)
+      fprintf(csv, ",replayed%u", j);
+    fprintf(csv, "\n");
+  }
+
+  // Configure the core as the vehicle was configured.
+  HostBoardInit();
+  SetNMotors(header.n_motors);
+  SetActuationInverse(header.actuation_inverse);  // Also runs ControlInit()
+  HostSetSensorOffsets(header.acc_offset, header.gyro_offset);
+
+  struct FlightLogRecord record;
+  struct MotorDifference differences[MAX_MOTORS];
+  memset(differences, 0, sizeof(differences));
+  uint32_t n_frames = 0, n_differing_frames = 0, n_nav_packets = 0;
+  uint8_t n_reported = 0;
+
+  while (FlightLogReadRecord(log, &record))
+  {
+    for (uint8_t j = 0; j < ADC_N_CHANNELS; j++)
+      HostSetADCSum((enum HostADCChannel)j, record.frame.adc_sum[j]);
+    if (record.frame.flags & FLIGHT_LOG_FRAME_SBUS)
+      HostSetSBusChannels(record.sbus.channels, record.sbus.binary);
+    for (uint8_t i = 0; i < record.frame.n_nav_packets; i++)
+      ProcessDataFromNav(record.nav[i].payload);
+    n_nav_packets += record.frame.n_nav_packets;
+
+    HostRunOuterLoop();
+
+    uint8_t differs = 0, motor_differs[MAX_MOTORS] = { 0 };
+    for (uint8_t k = 0; k < RATE_LOOP_FACTOR; k++)
+    {
+      for (uint8_t j = 0; j < FLIGHT_LOG_N_GYRO_CHANNELS; j++)
+        HostSetADCSum((enum HostADCChannel)(j + FLIGHT_LOG_FIRST_GYRO_CHANNEL),
+          record.frame.gyro_sum[k][j]);
+      HostRunRateLoop();
+
+      for (uint8_t j = 0; j < header.n_motors; j++)
+      {
+        const uint16_t logged = record.frame.motor_setpoint[k][j];
+        const uint16_t replayed = HostMotorSetpoint(j);
+        const uint16_t difference = logged > replayed ? logged - replayed
+          : replayed - logged;
+        if (difference <= tolerance) continue;
+
+        differs = 1;
+        motor_differs[j] = 1;
+        if (difference > differences[j].max)
+        {
+          differences[j].max = difference;
+          differences[j].max_frame = n_frames;
+          differences[j].max_step = k;
+        }
+        if (n_reported < MAX_REPORTED_DIFFERENCES)
+        {
+          if (!n_reported) printf("first differences:\n");
+          printf("  frame %6lu step %u (%5u ms): motor %u logged %4u "
+            "replayed %4u\n", (unsigned long)n_frames, k,
+            record.frame.timestamp, j, logged, replayed);
+          n_reported++;
+        }
+      }
+
+      if (csv)
+      {
+        fprintf(csv, "%lu,%u,%u", (unsigned long)n_frames, k,
+          record.frame.timestamp);
+        for (uint8_t j = 0; j < header.n_motors; j++)
+          fprintf(csv, ",%u", record.frame.motor_setpoint[k][j]);
+        for (uint8_t j = 0; j < header.n_motors; j++)
+          fprintf(csv, ",%u", HostMotorSetpoint(j));
+        fprintf(csv, "\n");
+      }
+    }
+    for (uint8_t j = 0; j < header.n_motors; j++)
+      differences[j].n_frames += motor_differs[j];
+    n_differing_frames += differs;
+
+    n_frames++;
+  }
+
+  fclose(log);
+  if (csv) fclose(csv);
+
+  if (n_reported) printf("\n");
+  printf("log                  %s (%s, %u motors)\n", log_path,
+    header.airframe, header.n_motors);
+  printf("frames replayed      %lu (%.1f s), %lu NaviCtrl packets\n",
+    (unsigned long)n_frames, (double)n_frames / FS,
+    (unsigned long)n_nav_packets);
+  printf("frames differing     %lu (tolerance %u)\n",
+    (unsigned long)n_differing_frames, tolerance);
+  if (n_differing_frames)
+  {
+    printf("\nmotor   frames differing   max difference   at frame   "
+      "step\n");
+    for (uint8_t j = 0; j < header.n_motors; j++)
+    {
+      printf("%5u   %16lu   %14u   %8lu   %4u\n", j,
+        (unsigned long)differences[j].n_frames, differences[j].max,
+        (unsigned long)differences[j].max_frame, differences[j].max_step);
+    }
+  }
+
+  if (n_differing_frames)
+  {
+    printf("FAIL\n");
+    return 1;
+  }
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,36 @@
+#include "sbus_frame.h"
+
+#include <string.h>
+
+#include "sbus.h"
+
+
+// =============================================================================
+// Public functions:
+
+// This function encodes a complete SBus frame (start byte, 16 x 11-bit
+// channels, flag byte, and end byte). Channel values are in the units reported
+// by SBusPitch(), etc. (+/- SBUS_MAX). Channels beyond SBUS_FRAME_N_CHANNELS
+// are sent centered.
+void SBusEncodeFrame(const int16_t channels[SBUS_FRAME_N_CHANNELS],
+  uint8_t binary, uint8_t frame[SBUS_FRAME_LENGTH])
+{
+  memset(frame, 0, SBUS_FRAME_LENGTH);
+  frame[0] = SBUS_START_BYTE;
+
+  // Channels are packed LSB first into bytes 1 to 22. UpdateSBus() reports
+  // 1024 - raw.
+  for (uint8_t i = 0; i < 16; i++)
+  {
+    uint16_t raw = 1024;
+    if (i < SBUS_FRAME_N_CHANNELS) raw = (uint16_t)(1024 - channels[i]);
+    for (uint8_t bit = 0; bit < 11; bit++)
+    {
+      uint16_t k = 11 * i + bit;
+      if (raw & (1 << bit)) frame[1 + k / 8] |= 1 << (k % 8);
+    }
+  }
+
+  frame[23] = binary;
+  frame[24] = SBUS_END_BYTE;
+}
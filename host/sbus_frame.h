@@ -0,0 +1,32 @@
+// This file declares an encoder for Futaba SBus frames, used to feed receiver
+// input to the firmware from the host build and from the simulator.
+
+#ifndef HOST_SBUS_FRAME_H_
+#define HOST_SBUS_FRAME_H_
+
+
+#include <inttypes.h>
+
+
+#define SBUS_FRAME_LENGTH (25)  // Including the start byte
+#define SBUS_FRAME_N_CHANNELS (12)  // Channels decoded by sbus.c
+
+// Flag byte bits (channels 16 and 17 in the EEPROM channel map).
+enum SBusFrameBinaryBits {
+  SBUS_FRAME_BINARY_BIT_CHANNEL_16 = 1<<0,
+  SBUS_FRAME_BINARY_BIT_CHANNEL_17 = 1<<1,
+};
+
+
+// =============================================================================
+// Public functions:
+
+// This function encodes a complete SBus frame (start byte, 16 x 11-bit
+// channels, flag byte, and end byte). Channel values are in the units reported
+// by SBusPitch(), etc. (+/- SBUS_MAX). Channels beyond SBUS_FRAME_N_CHANNELS
+// are sent centered.
+void SBusEncodeFrame(const int16_t channels[SBUS_FRAME_N_CHANNELS],
+  uint8_t binary, uint8_t frame[SBUS_FRAME_LENGTH]);
+
+
+#endif  // HOST_SBUS_FRAME_H_
@@ -0,0 +1,254 @@
+#include "sil.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "attitude.h"
+#include "control.h"
+#include "flight_log.h"
+#include "host_board.h"
+#include "motors.h"
+#include "pilot.h"
+#include "plant.h"
+#include "sbus.h"
+#include "state.h"
+#include "vertical_speed.h"
+
+
+// =============================================================================
+// Private data:
+
+#define DEFAULT_SECONDS (40)
+#define PLANT_STEPS_PER_FRAME (8)  // 1024 Hz plant integration
+#define PLANT_STEPS_PER_RATE_STEP (PLANT_STEPS_PER_FRAME / RATE_LOOP_FACTOR)
+
+_Static_assert(PLANT_STEPS_PER_RATE_STEP * RATE_LOOP_FACTOR
+  == PLANT_STEPS_PER_FRAME, "The plant must step evenly within the rate loop");
+
+// Thrust stick to thrust command conversion (see CommandsFromSticks() in
+// control.c).
+#define SIL_MIN_THRUST_CMD (100)
+#define SIL_THRUST_CMD_RANGE (1300)
+
+// Thrust stick above hover (about 3 % more thrust) so that the vehicle climbs
+// slowly while it flies the stick pattern.
+#define CLIMB_THRUST_FRACTION (0.03)
+
+// Limits beyond which the vehicle is considered out of control.
+#define MAX_TILT_ANGLE (60.0 * M_PI / 180.0)  // rad
+#define MAX_ANGULAR_RATE (6.0)  // rad/s
+
+struct Accumulator {
+  uint32_t count;
+  float sum_of_squares;
+  float max;
+};
+
+
+// =============================================================================
+// Private function declarations:
+
+static void LogFrame(FILE * log, const int16_t channels[], uint8_t binary,
+  const uint16_t adc_sum[ADC_N_CHANNELS],
+  const uint16_t gyro_sum[RATE_LOOP_FACTOR][FLIGHT_LOG_N_GYRO_CHANNELS],
+  const uint16_t setpoints[RATE_LOOP_FACTOR][MAX_MOTORS]);
+static float TiltBetween(const float quat_a[4], const float quat_b[4]);
+static void Accumulate(struct Accumulator * accumulator, float value);
+static struct SILStatistic Statistic(const struct Accumulator * accumulator);
+
+
+// =============================================================================
+// Public functions:
+
+void SILDefaultOptions(struct SILOptions * options)
+{
+  memset(options, 0, sizeof(*options));
+  options->seconds = DEFAULT_SECONDS;
+  options->effectiveness_scale = 1.0;
+  options->motor_lag_scale = 1.0;
+  options->seed = 1;
+}
+
+// -----------------------------------------------------------------------------
+uint8_t SILRun(const struct SILOptions * options, struct SILResult * result)
+{
+  FILE * csv = options->csv;
+  if (csv)
+  {
+    fprintf(csv, "t,state,q0,q1,q2,q3,q0_cmd,q1_cmd,q2_cmd,q3_cmd,q0_est,"
+      "q1_est,q2_est,q3_est,p,q,r,altitude,w,w_est");
+    for (uint8_t j = 0; j < MAX_MOTORS; j++) fprintf(csv, ",m%u", j);
+    fprintf(csv, "\n");
+  }
+
+  HostBoardInit();
+  PlantInit(options->effectiveness_scale, options->motor_lag_scale);
+  PlantSetSensorErrors(options->gyro_noise, options->accelerometer_noise,
+    options->gyro_bias, options->seed);
+
+  if (options->log)
+  {
+    struct FlightLogHeader header;
+    FlightLogHostHeader(&header);
+    FlightLogWriteHeader(options->log, &header);
+  }
+
+  result->hover_setpoint = PlantHoverSetpoint();
+  float flight_cmd = result->hover_setpoint * (1.0 + CLIMB_THRUST_FRACTION);
+  PilotSetFlightThrust((int16_t)((flight_cmd - SIL_MIN_THRUST_CMD) * 2.0
+    * SBUS_MAX / SIL_THRUST_CMD_RANGE - SBUS_MAX + 0.5));
+
+  const uint32_t n_frames = options->seconds * (uint32_t)FS;
+  const uint32_t pattern_frame = (PILOT_FLYING_MS / 1000 + 1) * (uint32_t)FS;
+  struct Accumulator tracking = { 0 }, estimation = { 0 };
+  struct Accumulator vertical_speed = { 0 }, tilt = { 0 }, rate = { 0 };
+  result->lost_control = 0;
+
+  for (uint32_t i = 0; i < n_frames; i++)
+  {
+    int16_t channels[SBUS_FRAME_N_CHANNELS];
+    uint8_t binary;
+    PilotSticks((uint64_t)HostFrameCount() * 1000 / (uint32_t)FS, channels,
+      &binary);
+    HostSetSBusChannels(channels, binary);
+    PlantSetSensors();
+    uint16_t adc_sum[ADC_N_CHANNELS];
+    for (uint8_t j = 0; j < ADC_N_CHANNELS; j++)
+      adc_sum[j] = HostADCSum((enum HostADCChannel)j);
+    HostRunOuterLoop();
+
+    // The rate loop sees the plant move within the frame.
+    uint16_t gyro_sum[RATE_LOOP_FACTOR][FLIGHT_LOG_N_GYRO_CHANNELS];
+    uint16_t setpoint_steps[RATE_LOOP_FACTOR][MAX_MOTORS];
+    for (uint8_t k = 0; k < RATE_LOOP_FACTOR; k++)
+    {
+      if (k) PlantSetGyros();
+      for (uint8_t j = 0; j < FLIGHT_LOG_N_GYRO_CHANNELS; j++)
+        gyro_sum[k][j] = HostADCSum((enum HostADCChannel)(j
+          + FLIGHT_LOG_FIRST_GYRO_CHANNEL));
+      HostRunRateLoop();
+
+      for (uint8_t j = 0; j < MAX_MOTORS; j++)
+        setpoint_steps[k][j] = HostMotorSetpoint(j);
+      for (uint8_t j = 0; j < PLANT_STEPS_PER_RATE_STEP; j++)
+        PlantUpdate(setpoint_steps[k], DT / PLANT_STEPS_PER_FRAME);
+    }
+    const uint16_t * setpoints = setpoint_steps[RATE_LOOP_FACTOR - 1];
+    if (options->log)
+    {
+      LogFrame(options->log, channels, binary, adc_sum, gyro_sum,
+        setpoint_steps);
+    }
+
+    const float * quat = PlantQuat();
+    const float * angular_rate = PlantAngularRateVector();
+    float g_b_z = 2.0 * (quat[0] * quat[0] + quat[3] * quat[3]) - 1.0;
+    float tilt_angle = acos(g_b_z > 1.0 ? 1.0 : g_b_z);
+    float rate_norm = sqrt(angular_rate[0] * angular_rate[0] + angular_rate[1]
+      * angular_rate[1] + angular_rate[2] * angular_rate[2]);
+
+    if (HostFrameCount() > pattern_frame)
+    {
+      Accumulate(&tracking, TiltBetween(QuatCommandVector(), quat));
+      Accumulate(&estimation, TiltBetween(Quat(), quat));
+      Accumulate(&vertical_speed, VerticalSpeed()
+        + PlantVelocityVector()[D_WORLD_AXIS]);
+      Accumulate(&tilt, tilt_angle);
+      Accumulate(&rate, rate_norm);
+      if ((tilt_angle > MAX_TILT_ANGLE) || (rate_norm > MAX_ANGULAR_RATE))
+        result->lost_control = 1;
+    }
+
+    if (csv)
+    {
+      const float * quat_cmd = QuatCommandVector(), * quat_est = Quat();
+      fprintf(csv, "%.4f,%u,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,"
+        "%.5f,%.5f,%.5f,%.4f,%.4f,%.4f,%.3f,%.3f,%.3f",
+        HostFrameCount() * DT, State(), quat[0], quat[1], quat[2], quat[3],
+        quat_cmd[0], quat_cmd[1], quat_cmd[2], quat_cmd[3], quat_est[0],
+        quat_est[1], quat_est[2], quat_est[3], angular_rate[0],
+        angular_rate[1], angular_rate[2], -PlantPositionVector()[D_WORLD_AXIS],
+        -PlantVelocityVector()[D_WORLD_AXIS], VerticalSpeed());
+      for (uint8_t j = 0; j < MAX_MOTORS; j++)
+        fprintf(csv, ",%u", setpoints[j]);
+      fprintf(csv, "\n");
+    }
+
+    if (options->progress && ((HostFrameCount() % (uint32_t)FS) == 0))
+    {
+      fprintf(options->progress, "%6lu s state=0x%02X altitude=%6.2f m "
+        "tilt=%5.1f deg", (unsigned long)(HostFrameCount() / (uint32_t)FS),
+        State(), -PlantPositionVector()[D_WORLD_AXIS],
+        tilt_angle * 180.0 / M_PI);
+      for (uint8_t j = 0; j < NMotors(); j++)
+        fprintf(options->progress, " %4u", setpoints[j]);
+      fprintf(options->progress, "\n");
+    }
+  }
+
+  result->tracking = Statistic(&tracking);
+  result->estimation = Statistic(&estimation);
+  result->vertical_speed = Statistic(&vertical_speed);
+  result->tilt = Statistic(&tilt);
+  result->angular_rate = Statistic(&rate);
+  result->final_altitude = -PlantPositionVector()[D_WORLD_AXIS];
+  result->flying = MotorsRunning() && !PlantOnGround();
+
+  return result->flying && !result->lost_control;
+}
+
+
+// =============================================================================
+// Private functions:
+
+// This function appends the inputs and outputs of the frame that just ran to
+// the flight log.
+static void LogFrame(FILE * log, const int16_t channels[], uint8_t binary,
+  const uint16_t adc_sum[ADC_N_CHANNELS],
+  const uint16_t gyro_sum[RATE_LOOP_FACTOR][FLIGHT_LOG_N_GYRO_CHANNELS],
+  const uint16_t setpoints[RATE_LOOP_FACTOR][MAX_MOTORS])
+{
+  struct FlightLogRecord record;
+  memset(&record, 0, sizeof(record));
+  record.frame.timestamp = (uint16_t)((uint64_t)HostFrameCount() * 1000
+    / (uint32_t)FS);
+  record.frame.flags = FLIGHT_LOG_FRAME_SBUS;
+  memcpy(record.frame.adc_sum, adc_sum, sizeof(record.frame.adc_sum));
+  memcpy(record.frame.gyro_sum, gyro_sum, sizeof(record.frame.gyro_sum));
+  memcpy(record.frame.motor_setpoint, setpoints,
+    sizeof(record.frame.motor_setpoint));
+  for (uint8_t j = 0; j < SBUS_FRAME_N_CHANNELS; j++)
+    record.sbus.channels[j] = channels[j];
+  record.sbus.binary = binary;
+  FlightLogWriteRecord(log, &record);
+}
+
+// -----------------------------------------------------------------------------
+// This function returns the angle between the directions of gravity in the
+// body frame for two attitudes, which ignores differences in heading. Heading
+// is not observable without the NaviCtrl, so a gyro bias makes it drift.
+static float TiltBetween(const float quat_a[4], const float quat_b[4])
+{
+  float g_b_a[3], g_b_b[3];
+  UpdateGravityInBody(quat_a, g_b_a);
+  UpdateGravityInBody(quat_b, g_b_b);
+  float dot = g_b_a[0] * g_b_b[0] + g_b_a[1] * g_b_b[1] + g_b_a[2] * g_b_b[2];
+  return acos(dot > 1.0 ? 1.0 : (dot < -1.0 ? -1.0 : dot));
+}
+
+// -----------------------------------------------------------------------------
+static void Accumulate(struct Accumulator * accumulator, float value)
+{
+  accumulator->count++;
+  accumulator->sum_of_squares += value * value;
+  if (fabs(value) > accumulator->max) accumulator->max = fabs(value);
+}
+
+// -----------------------------------------------------------------------------
+static struct SILStatistic Statistic(const struct Accumulator * accumulator)
+{
+  struct SILStatistic statistic = { 0.0, accumulator->max };
+  if (accumulator->count)
+    statistic.rms = sqrt(accumulator->sum_of_squares / accumulator->count);
+  return statistic;
+}
@@ -0,0 +1,63 @@
+// This file declares a closed-loop software-in-the-loop flight: the flight-
+// control core on the host (see host_board.h) flying the plant in plant.c under
+// the scripted pilot in pilot.c. Because the firmware modules keep their state
+// in static variables, SILRun() can be called only once per process; callers
+// that need many flights (see monte_carlo.c) run each in its own process.
+
+#ifndef HOST_SIL_H_
+#define HOST_SIL_H_
+
+
+#include <inttypes.h>
+#include <stdio.h>
+
+
+struct SILOptions {
+  uint32_t seconds;
+  float effectiveness_scale;  // Plant control effectiveness (1 / mass)
+  float motor_lag_scale;  // Plant motor time constant
+  float gyro_noise;  // rad/s
+  float accelerometer_noise;  // m/s^2
+  float gyro_bias[3];  // rad/s
+  uint32_t seed;
+  FILE * csv;  // Log of every frame (optional)
+  FILE * log;  // Binary flight log for replay (optional, see flight_log.h)
+  FILE * progress;  // State once per simulated second (optional)
+};
+
+struct SILStatistic {
+  float rms;
+  float max;
+};
+
+struct SILResult {
+  float hover_setpoint;
+  // Angles between directions of gravity in the body frame (rad): command vs
+  // actual and estimate vs actual.
+  struct SILStatistic tracking;
+  struct SILStatistic estimation;
+  struct SILStatistic vertical_speed;  // m/s
+  struct SILStatistic tilt;  // rad
+  struct SILStatistic angular_rate;  // rad/s
+  float final_altitude;  // m
+  uint8_t flying;
+  uint8_t lost_control;
+};
+
+
+// =============================================================================
+// Public functions:
+
+// This function sets "options" to a 40 s flight of the nominal plant with
+// perfect sensors.
+void SILDefaultOptions(struct SILOptions * options);
+
+// -----------------------------------------------------------------------------
+// This function flies the scripted pilot against the plant and fills in
+// "result". Statistics cover the time after the first step of the stick
+// pattern. It returns 1 if the vehicle kept control and was still flying at
+// the end.
+uint8_t SILRun(const struct SILOptions * options, struct SILResult * result);
+
+
+#endif  // HOST_SIL_H_
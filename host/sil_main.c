@@ -0,0 +1,119 @@
+// This program closes the loop around the flight-control core on the host.
+// The motor setpoints from RateControl() drive the rigid-body plant in
+// plant.c, and the plant's gyro, accelerometer, and pressure readings are fed
+// back into the ADC samples before each frame (the gyro readings before each
+// step of the rate loop). The scripted pilot (see pilot.c) arms the vehicle,
+// lifts off with slightly more than hover thrust, and flies a pattern of pitch,
+// roll, and yaw steps. The program reports how well the vehicle tracked the
+// attitude command and how well the firmware estimated the attitude and
+// vertical speed, and exits with a failure status if the vehicle lost control.
+// The effectiveness (-e) and motor lag (-l) of the plant can be scaled to check
+// the margins of the gain sets in ControlInit(). With -L, the flight is also
+// recorded as a binary flight log for replay_main.c.
+//
+// Usage: UT_FlightCtrl_sil [-t seconds] [-e effectiveness_scale]
+//          [-l motor_lag_scale] [-g gyro_noise] [-a accelerometer_noise]
+//          [-c csv_file] [-L flight_log]
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "main.h"
+#include "sil.h"
+
+
+// =============================================================================
+// Public functions:
+
+int main(int argc, char * argv[])
+{
+  struct SILOptions options;
+  SILDefaultOptions(&options);
+  options.progress = stdout;
+  const char * csv_path = NULL, * log_path = NULL;
+
+  int option;
+  while ((option = getopt(argc, argv, "t:e:l:g:a:c:L:")) != -1)
+  {
+    switch (option)
+    {
+      case 't': options.seconds = strtoul(optarg, NULL, 0); break;
+      case 'e': options.effectiveness_scale = atof(optarg); break;
+      case 'l': options.motor_lag_scale = atof(optarg); break;
+      case 'g': options.gyro_noise = atof(optarg); break;
+      case 'a': options.accelerometer_noise = atof(optarg); break;
+      case 'c': csv_path = optarg; break;
+      case 'L': log_path = optarg; break;
+      default:
+        fprintf(stderr, "Usage: %s [-t seconds] [-e effectiveness_scale] "
+          "[-l motor_lag_scale] [-g gyro_noise] [-a accelerometer_noise] "
+          "[-c csv_file] [-L flight_log]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  if (csv_path)
+  {
+    options.csv = fopen(csv_path, "w");
+    if (!options.csv)
+    {
+      perror(csv_path);
+      return 2;
+    }
+  }
+
+  if (log_path)
+  {
+    options.log = fopen(log_path, "wb");
+    if (!options.log)
+    {
+      perror(log_path);
+      return 2;
+    }
+  }
+
+  struct timespec start, stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  struct SILResult result;
+  uint8_t passed = SILRun(&options, &result);
+
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  if (options.csv) fclose(options.csv);
+  if (options.log) fclose(options.log);
+
+  const float kDegrees = 180.0 / M_PI;
+  printf("\nhover setpoint          %8.1f\n", result.hover_setpoint);
+  printf("plant scale             %8.2f effectiveness, %.2f motor lag\n",
+    options.effectiveness_scale, options.motor_lag_scale);
+  printf("attitude tracking (deg) %8.2f rms %8.2f max\n",
+    result.tracking.rms * kDegrees, result.tracking.max * kDegrees);
+  printf("attitude estimate (deg) %8.2f rms %8.2f max\n",
+    result.estimation.rms * kDegrees, result.estimation.max * kDegrees);
+  printf("vertical speed (m/s)    %8.3f rms %8.3f max\n",
+    result.vertical_speed.rms, result.vertical_speed.max);
+  printf("tilt (deg)              %8.2f rms %8.2f max\n",
+    result.tilt.rms * kDegrees, result.tilt.max * kDegrees);
+  printf("angular rate (rad/s)    %8.2f rms %8.2f max\n",
+    result.angular_rate.rms, result.angular_rate.max);
+  printf("final altitude (m)      %8.2f\n", result.final_altitude);
+
+  const uint32_t n_frames = options.seconds * (uint32_t)FS;
+  double elapsed = (stop.tv_sec - start.tv_sec)
+    + (stop.tv_nsec - start.tv_nsec) * 1e-9;
+  fflush(stdout);
+  fprintf(stderr, "%lu frames in %.3f s (%.0fx real time)\n",
+    (unsigned long)n_frames, elapsed, n_frames / elapsed / FS);
+
+  if (!passed)
+  {
+    printf("FAIL: %s\n", result.lost_control ? "lost control" : "not flying");
+    return 1;
+  }
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,314 @@
+// This program decodes the event trace (see trace.h) from a capture of the
+// FlightCtrl's UART output and prints it as a timeline. The capture may also
+// contain other traffic; only UTokyo protocol messages with a valid CRC and
+// the trace id are used. Each complete read-out of the trace is printed with
+// the time of each event from the start of the first frame in the trace, the
+// frame number, and the time into the frame. An I2C transaction that finishes
+// in a later frame than it started is marked, as is every overrun.
+//
+// With -r, the program instead writes the message that requests a read-out of
+// the trace to stdout, for example:
+//   UT_FlightCtrl_trace -r > /dev/ttyUSB0
+//
+// With -m, the program writes the message that sets the mask of the events
+// that are recorded (bit n for enum TraceEvent n, see TraceSetEventMask()).
+// The I2C events are not recorded by default; to record every event:
+//   UT_FlightCtrl_trace -m 0xFFFF > /dev/ttyUSB0
+//
+// Usage: UT_FlightCtrl_trace [-r | -m mask] [capture_file]
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/crc16.h>
+
+#include "frame_timing.h"
+#include "i2c.h"
+#include "trace.h"
+#include "uart.h"
+#include "ut_serial_protocol.h"
+
+
+// =============================================================================
+// Private data:
+
+#define TICKS_PER_FRAME (F_CPU / FRAME_TIMING_CYCLES_PER_TICK / 128)
+#define US_PER_TICK (1.0e6 * FRAME_TIMING_CYCLES_PER_TICK / F_CPU)
+#define TRACE_DATA_HEADER_LENGTH (3)  // first, count, triggered
+#define TRACE_RECORD_LENGTH (6)
+#define MAX_I2C_ADDRESSES (256)
+
+struct Readout {
+  struct TraceRecord records[256];
+  uint16_t n_received;
+  uint8_t count;
+  uint8_t triggered;
+  uint8_t active;
+};
+
+static const char * kEventNames[] = {
+  [TRACE_EVENT_NONE] = "none",
+  [TRACE_EVENT_I2C_START] = "i2c start",
+  [TRACE_EVENT_I2C_FINISH] = "i2c finish",
+  [TRACE_EVENT_UART_RX] = "uart rx",
+  [TRACE_EVENT_SBUS_FRAME] = "sbus frame",
+  [TRACE_EVENT_NAV_DATA] = "nav data",
+  [TRACE_EVENT_OVERRUN] = "OVERRUN",
+  [TRACE_EVENT_LOAD_SHED] = "load shed",
+  [TRACE_EVENT_FRAME_START] = "frame",
+};
+
+
+// =============================================================================
+// Private function declarations:
+
+static void HandleTraceData(struct Readout * readout, const uint8_t * payload,
+  uint8_t length);
+static void PrintTimeline(const struct Readout * readout);
+static int WriteMessage(uint8_t id, const uint8_t * payload, uint8_t length);
+
+
+// =============================================================================
+// Public functions:
+
+int main(int argc, char * argv[])
+{
+  int option;
+  while ((option = getopt(argc, argv, "rm:")) != -1)
+  {
+    switch (option)
+    {
+      case 'r':
+        return WriteMessage(UT_SERIAL_ID_TRACE, 0, 0);
+      case 'm':
+      {
+        const uint16_t mask = (uint16_t)strtoul(optarg, 0, 0);
+        const uint8_t payload[2] = { mask & 0xFF, mask >> 8 };
+        return WriteMessage(UT_SERIAL_ID_TRACE_MASK, payload, sizeof(payload));
+      }
+      default:
+        fprintf(stderr, "Usage: %s [-r | -m mask] [capture_file]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  FILE * capture = stdin;
+  if (optind < argc)
+  {
+    capture = fopen(argv[optind], "rb");
+    if (!capture)
+    {
+      perror(argv[optind]);
+      return 2;
+    }
+  }
+
+  // Messages are collected byte by byte as the firmware does (see
+  // UTSerialRx()), starting again at each start character that does not lead
+  // to a valid message.
+  static struct Readout readout;
+  uint8_t message[UT_HEADER_LENGTH + 256 + 2];
+  uint16_t n_bytes = 0;
+  uint32_t n_messages = 0, n_bad_crc = 0;
+  int c;
+  while ((c = fgetc(capture)) != EOF)
+  {
+    if (n_bytes == 0)
+    {
+      if (c == UT_START_CHARACTER) message[n_bytes++] = c;
+      continue;
+    }
+    message[n_bytes++] = c;
+    if (n_bytes < UT_HEADER_LENGTH) continue;
+
+    const uint8_t length = message[1];
+    if (n_bytes < UT_HEADER_LENGTH + length + 2) continue;
+
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 1; i < UT_HEADER_LENGTH + length; i++)
+      crc = _crc_ccitt_update(crc, message[i]);
+    if ((message[UT_HEADER_LENGTH + length] == (crc & 0xFF))
+      && (message[UT_HEADER_LENGTH + length + 1] == (crc >> 8)))
+    {
+      n_messages++;
+      if (message[2] == UT_SERIAL_ID_TRACE)
+        HandleTraceData(&readout, &message[UT_HEADER_LENGTH], length);
+      n_bytes = 0;
+    }
+    else
+    {
+      // Resynchronize on the next start character after this one.
+      n_bad_crc++;
+      uint16_t i = 1;
+      while ((i < n_bytes) && (message[i] != UT_START_CHARACTER)) i++;
+      memmove(message, &message[i], n_bytes - i);
+      n_bytes -= i;
+    }
+  }
+  if (capture != stdin) fclose(capture);
+
+  if (readout.active)
+    fprintf(stderr, "warning: capture ends in the middle of a read-out\n");
+  fprintf(stderr, "%lu UT messages decoded, %lu discarded (bad CRC)\n",
+    (unsigned long)n_messages, (unsigned long)n_bad_crc);
+
+  return 0;
+}
+
+
+// =============================================================================
+// Private functions:
+
+// This function adds one message of a read-out and prints the timeline once
+// every record has been received.
+static void HandleTraceData(struct Readout * readout, const uint8_t * payload,
+  uint8_t length)
+{
+  if ((length < TRACE_DATA_HEADER_LENGTH)
+    || ((length - TRACE_DATA_HEADER_LENGTH) % TRACE_RECORD_LENGTH))
+  {
+    fprintf(stderr, "warning: trace message of bad length %u\n", length);
+    return;
+  }
+  const uint8_t first = payload[0], count = payload[1];
+  const uint8_t n_records = (length - TRACE_DATA_HEADER_LENGTH)
+    / TRACE_RECORD_LENGTH;
+
+  if (first == 0)
+  {
+    if (readout->active)
+      fprintf(stderr, "warning: incomplete read-out discarded\n");
+    readout->active = 1;
+    readout->n_received = 0;
+    readout->count = count;
+    readout->triggered = payload[2];
+  }
+  if (!readout->active) return;
+  if ((first != readout->n_received) || (count != readout->count)
+    || (first + n_records > count))
+  {
+    fprintf(stderr, "warning: read-out out of sequence, discarded\n");
+    readout->active = 0;
+    return;
+  }
+
+  const uint8_t * p = &payload[TRACE_DATA_HEADER_LENGTH];
+  for (uint8_t i = 0; i < n_records; i++, p += TRACE_RECORD_LENGTH)
+  {
+    struct TraceRecord * record = &readout->records[first + i];
+    record->event = p[0];
+    record->frame = p[1];
+    record->time = p[2] | (p[3] << 8);
+    record->payload = p[4] | (p[5] << 8);
+  }
+  readout->n_received += n_records;
+
+  if (readout->n_received == readout->count)
+  {
+    PrintTimeline(readout);
+    readout->active = 0;
+  }
+}
+
+// -----------------------------------------------------------------------------
+static void PrintTimeline(const struct Readout * readout)
+{
+  printf("trace of %u records%s\n", readout->count, readout->triggered
+    ? " (stopped after an overrun)" : "");
+  printf("   time (ms)  frame  in frame (us)  event       details\n");
+
+  // The time of the last start of a transaction with each I2C address.
+  uint32_t i2c_start_frame[MAX_I2C_ADDRESSES];
+  uint16_t i2c_start_time[MAX_I2C_ADDRESSES];
+  uint8_t i2c_started[MAX_I2C_ADDRESSES];
+  memset(i2c_started, 0, sizeof(i2c_started));
+
+  uint32_t frame = 0, n_spanning = 0, n_overruns = 0;
+  for (uint16_t i = 0; i < readout->count; i++)
+  {
+    const struct TraceRecord * record = &readout->records[i];
+    if (i) frame += (uint8_t)(record->frame - readout->records[i - 1].frame);
+    const double t = (frame * (double)TICKS_PER_FRAME + record->time)
+      * US_PER_TICK / 1000.0;
+    const char * name = record->event < sizeof(kEventNames)
+      / sizeof(kEventNames[0]) ? kEventNames[record->event] : "unknown";
+    printf("%12.3f  %5lu  %13.1f  %-10s  ", t, (unsigned long)frame,
+      record->time * US_PER_TICK, name);
+
+    const uint8_t address = record->payload >> 8;
+    switch (record->event)
+    {
+      case TRACE_EVENT_I2C_START:
+        printf("address 0x%02X", record->payload & 0xFF);
+        i2c_start_frame[record->payload & 0xFF] = frame;
+        i2c_start_time[record->payload & 0xFF] = record->time;
+        i2c_started[record->payload & 0xFF] = 1;
+        break;
+      case TRACE_EVENT_I2C_FINISH:
+        printf("address 0x%02X", address);
+        if ((record->payload & 0xFF) != I2C_ERROR_NONE)
+          printf(", error %u", record->payload & 0xFF);
+        if (i2c_started[address])
+        {
+          const double duration = ((frame - i2c_start_frame[address])
+            * (double)TICKS_PER_FRAME + record->time
+            - i2c_start_time[address]) * US_PER_TICK;
+          printf(", %.1f us", duration);
+          if (frame != i2c_start_frame[address])
+          {
+            printf("  <-- started in frame %lu",
+              (unsigned long)i2c_start_frame[address]);
+            n_spanning++;
+          }
+          i2c_started[address] = 0;
+        }
+        break;
+      case TRACE_EVENT_UART_RX:
+        printf("%s message", record->payload == UART_RX_MODE_UT_ONGOING
+          ? "UT" : record->payload == UART_RX_MODE_MK_ONGOING ? "MK" : "?");
+        break;
+      case TRACE_EVENT_SBUS_FRAME:
+        printf("first byte at %u ms", record->payload);
+        break;
+      case TRACE_EVENT_NAV_DATA:
+        printf("version %u", record->payload);
+        break;
+      case TRACE_EVENT_OVERRUN:
+        printf("frame ended %.1f us after its tick%s",
+          record->payload * US_PER_TICK, record->payload == 0xFFFF
+          ? " (or later)" : "");
+        n_overruns++;
+        break;
+      case TRACE_EVENT_LOAD_SHED:
+        printf("level %u", record->payload);
+        break;
+      case TRACE_EVENT_FRAME_START:
+        printf("started by %s", record->payload ? "SBus" : "timeout");
+        break;
+      default:
+        printf("payload 0x%04X", record->payload);
+        break;
+    }
+    printf("\n");
+  }
+  printf("%lu overruns, %lu I2C transactions across a frame start\n\n",
+    (unsigned long)n_overruns, (unsigned long)n_spanning);
+}
+
+// -----------------------------------------------------------------------------
+// This function writes a UTokyo protocol message with "id" and "payload" to
+// stdout. The trace id with no payload requests a read-out of the trace.
+static int WriteMessage(uint8_t id, const uint8_t * payload, uint8_t length)
+{
+  uint8_t message[UT_HEADER_LENGTH + 256 + 2] = { UT_START_CHARACTER, length,
+    id, 0 };
+  if (length) memcpy(&message[UT_HEADER_LENGTH], payload, length);
+  uint16_t crc = 0xFFFF;
+  for (uint16_t i = 1; i < UT_HEADER_LENGTH + length; i++)
+    crc = _crc_ccitt_update(crc, message[i]);
+  message[UT_HEADER_LENGTH + length] = crc & 0xFF;
+  message[UT_HEADER_LENGTH + length + 1] = crc >> 8;
+  return fwrite(message, UT_HEADER_LENGTH + length + 2, 1, stdout) != 1;
+}
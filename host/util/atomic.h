@@ -0,0 +1,22 @@
+// This file stands in for <util/atomic.h> in the host build. The host program
+// emulates interrupts synchronously, so an atomic block only has to execute its
+// body exactly once.
+
+#ifndef HOST_UTIL_ATOMIC_H_
+#define HOST_UTIL_ATOMIC_H_
+
+
+#include <inttypes.h>
+
+
+#define ATOMIC_RESTORESTATE (0)
+#define ATOMIC_FORCEON (0)
+#define NONATOMIC_RESTORESTATE (0)
+#define NONATOMIC_FORCEOFF (0)
+
+#define ATOMIC_BLOCK(type) \
+  for (uint8_t atomic_once_ = ((void)(type), 1); atomic_once_; atomic_once_ = 0)
+#define NONATOMIC_BLOCK(type) ATOMIC_BLOCK(type)
+
+
+#endif  // HOST_UTIL_ATOMIC_H_
@@ -0,0 +1,21 @@
+// This file stands in for <util/crc16.h> in the host build. The implementation
+// is the C equivalent given in the avr-libc documentation.
+
+#ifndef HOST_UTIL_CRC16_H_
+#define HOST_UTIL_CRC16_H_
+
+
+#include <inttypes.h>
+
+
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data)
+{
+  data ^= (uint8_t)(crc & 0xFF);
+  data ^= data << 4;
+
+  return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4)
+    ^ ((uint16_t)data << 3));
+}
+
+
+#endif  // HOST_UTIL_CRC16_H_
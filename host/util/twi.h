@@ -0,0 +1,29 @@
+// This file stands in for <util/twi.h> in the host build.
+
+#ifndef HOST_UTIL_TWI_H_
+#define HOST_UTIL_TWI_H_
+
+
+#include <avr/io.h>
+
+
+#define TW_START 0x08
+#define TW_REP_START 0x10
+#define TW_MT_SLA_ACK 0x18
+#define TW_MT_SLA_NACK 0x20
+#define TW_MT_DATA_ACK 0x28
+#define TW_MT_DATA_NACK 0x30
+#define TW_MT_ARB_LOST 0x38
+#define TW_MR_ARB_LOST 0x38
+#define TW_MR_SLA_ACK 0x40
+#define TW_MR_SLA_NACK 0x48
+#define TW_MR_DATA_ACK 0x50
+#define TW_MR_DATA_NACK 0x58
+#define TW_NO_INFO 0xF8
+#define TW_BUS_ERROR 0x00
+#define TW_STATUS (TWSR & 0xF8)
+#define TW_READ 1
+#define TW_WRITE 0
+
+
+#endif  // HOST_UTIL_TWI_H_
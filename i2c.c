@@ -3,8 +3,10 @@
 #include <avr/interrupt.h>
 #include <util/twi.h>
 
+#include "isr_profile.h"
 #include "mcu_pins.h"
 #include "timing.h"
+#include "trace.h"
 
 
 // =============================================================================
@@ -27,6 +29,10 @@ static const uint8_t * volatile tx_source_ptr_ = 0;
 static uint8_t slave_address_ = 0x00;
 static I2CCallback callback_ptr_ = 0;
 
+#ifdef ISR_TIMING
+static volatile uint32_t isr_cycles_ = 0;  // Running total of TWI_vect
+#endif
+
 
 // =============================================================================
 // Private function declarations:
@@ -43,6 +49,16 @@ enum I2CError I2CError(void)
   return i2c_error_;
 }
 
+// -----------------------------------------------------------------------------
+uint32_t I2CInterruptCycles(void)
+{
+#ifdef ISR_TIMING
+  return isr_cycles_;
+#else
+  return 0;
+#endif
+}
+
 
 // =============================================================================
 // Public functions:
@@ -108,6 +124,7 @@ enum I2CError I2CTxThenRxThenCallback(uint8_t slave_address,
   rx_destination_ptr_ = rx_destination_ptr;
   rx_destination_len_ = rx_destination_len;
   callback_ptr_ = callback_ptr;
+  Trace(TRACE_EVENT_I2C_START, slave_address);
   if (tx_source_ptr != 0 && tx_source_len != 0)
   {
     I2CStart(I2C_MODE_TX);
@@ -204,6 +221,7 @@ static void Next(void)
   else
   {
     I2CStop();
+    Trace(TRACE_EVENT_I2C_FINISH, (slave_address_ << 8) | i2c_error_);
     if (callback_ptr_) (*callback_ptr_)();
   }
 }
@@ -301,6 +319,11 @@ static void ProcessRxInterrupt(void)
 // instruction.
 ISR(TWI_vect)
 {
+  ISR_PROFILE_ENTER(ISR_PROFILE_TWI);
+#ifdef ISR_TIMING
+  const uint16_t start = TCNT1;
+#endif
+
   switch (i2c_mode_)
   {
     case I2C_MODE_TX:
@@ -313,4 +336,17 @@ ISR(TWI_vect)
       Next();  // Unexpected interrupt, reset interrupt flag;
       break;
   }
+
+#ifdef ISR_TIMING
+  // TIMER1 counts CPU cycles from 0 to ISR_PROFILE_TIMER1_PERIOD - 1, so the
+  // duration is (end - start) % ISR_PROFILE_TIMER1_PERIOD. The handler is much
+  // shorter than a period, so the modulo only has to add the period back when
+  // TIMER1 has restarted (end < start), which avoids a division.
+  const uint16_t end = TCNT1;
+  uint16_t cycles = end - start;
+  if (end < start) cycles += ISR_PROFILE_TIMER1_PERIOD;
+  isr_cycles_ += cycles;
+#endif
+
+  ISR_PROFILE_EXIT(ISR_PROFILE_TWI);
 }
@@ -5,6 +5,10 @@
 #include <inttypes.h>
 
 
+// The callback of a transaction is called from the TWI interrupt as soon as the
+// transaction has finished, so that it can start the next one without delay.
+// It should do nothing else, and leave any processing of the received data to
+// the main loop (see completion.h).
 typedef void (*I2CCallback)(void);
 
 enum I2CError {
@@ -23,6 +27,14 @@ enum I2CError {
 
 enum I2CError I2CError(void);
 
+// -----------------------------------------------------------------------------
+// Running total (modulo 2^32) of the CPU cycles spent in the TWI interrupt
+// handler, less the interrupt response and the register saves and restores.
+// The handler only keeps this total if ISR_TIMING is defined (see
+// load_meter.h). Otherwise this is 0. It should be read with interrupts
+// disabled.
+uint32_t I2CInterruptCycles(void);
+
 
 // =============================================================================
 // Public functions:
@@ -22,6 +22,7 @@
 // Private data:
 
 uint8_t tx_buffer_[2] = { 0 };
+static volatile uint8_t update_pending_ = 0;
 
 
 // =============================================================================
@@ -60,8 +61,13 @@ void IndicatorInit(void)
 }
 
 // -----------------------------------------------------------------------------
+// This function sends the LED register write prepared by the last call to
+// UpdateIndicator(). It is called at the end of each motor I2C sequence, which
+// runs several times per frame, so the write is only sent once.
 void TxIndicatorUpdate(void)
 {
+  if (!update_pending_) return;
+  update_pending_ = 0;
   I2CTx(PCA9685_ADDRESS, tx_buffer_, 2);
 }
 
@@ -186,6 +192,8 @@ void UpdateIndicator(void)
       PCA9685_led = GREEN;
       break;
   }
+
+  update_pending_ = 1;
 }
 
 
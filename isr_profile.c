@@ -0,0 +1,62 @@
+// This file keeps the execution time statistics of the interrupt handlers (see
+// isr_profile.h). It is only compiled into the program when ISR_PROFILE is
+// defined.
+
+#include "isr_profile.h"
+
+#ifdef ISR_PROFILE
+
+
+#include <util/atomic.h>
+
+#include "timing.h"
+
+
+// =============================================================================
+// Private data:
+
+_Static_assert(ISR_PROFILE_TIMER1_PERIOD == F_CPU / 1000,
+  "ISR_PROFILE_TIMER1_PERIOD does not match the TIMER1 period");
+
+// Written by the markers and ISRProfileExit (isr_profile.S). The markers
+// reference it by name, so it must survive whole-program optimization.
+volatile struct ISRProfile isr_profile_[ISR_PROFILE_COUNT]
+  __attribute__((used, externally_visible));
+
+// The running totals at the last snapshot.
+static uint32_t snapshot_totals_[ISR_PROFILE_COUNT];
+static uint16_t snapshot_timestamp_ = 0;
+
+
+// =============================================================================
+// Public functions:
+
+uint16_t ISRProfileSnapshot(struct ISRProfile * profiles)
+{
+  for (uint8_t i = 0; i < ISR_PROFILE_COUNT; i++)
+  {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      profiles[i].max = isr_profile_[i].max;
+      profiles[i].total = isr_profile_[i].total - snapshot_totals_[i];
+      profiles[i].count = isr_profile_[i].count;
+      snapshot_totals_[i] = isr_profile_[i].total;
+      isr_profile_[i].max = 0;
+      isr_profile_[i].count = 0;
+    }
+    profiles[i].start = 0;
+  }
+
+  const uint16_t window = MillisSinceTimestamp(snapshot_timestamp_);
+  snapshot_timestamp_ = GetTimestamp();
+  return window;
+}
+
+// -----------------------------------------------------------------------------
+uint32_t ISRProfileTotal(uint8_t id)
+{
+  return isr_profile_[id].total;
+}
+
+
+#endif  // ISR_PROFILE
@@ -0,0 +1,150 @@
+#ifndef ISR_PROFILE_H_
+#define ISR_PROFILE_H_
+
+
+// This file defines markers that measure the execution time of each interrupt
+// handler on the vehicle. When the firmware is built with ISR_PROFILE defined,
+// ISR_PROFILE_ENTER records TCNT1 (TIMER1 counts CPU cycles, see timing.c) at
+// the start of a handler and ISR_PROFILE_EXIT accumulates the number of cycles
+// since then, the maximum, and the number of invocations. The results are
+// reported by the ISR profile MK data stream, and the totals are also used by
+// the load meter (see load_meter.h). Otherwise, the markers compile to nothing.
+//
+// The markers are available to both C (as macros) and assembly (as .macro) so
+// that the hand-written handlers are measured the same way. The counts include
+// about 30 cycles of the profiler itself, and exclude the interrupt response,
+// vector jump, and reti (13 cycles) and, for handlers written in C, the
+// register saves and restores generated by the compiler. The counts of
+// TIMER3_COMPA_vect (the rate loop) and TIMER3_CAPT_vect also include any
+// interrupts serviced after they re-enable interrupts, and are only correct for
+// runs shorter than a TIMER1 period (1 ms).
+
+#define ISR_PROFILE_ADC (0)  // ADC_vect (adc.S)
+#define ISR_PROFILE_USART1_RX (1)  // USART1_RX_vect (sbus.S)
+#define ISR_PROFILE_TIMER1_CAPT (2)  // TIMER1_CAPT_vect (timing.S)
+#define ISR_PROFILE_TWI (3)  // TWI_vect (i2c.c)
+#define ISR_PROFILE_SPI_STC (4)  // SPI_STC_vect (spi.c)
+#define ISR_PROFILE_USART0_RX (5)  // USART0_RX_vect (uart.c)
+#define ISR_PROFILE_USART0_UDRE (6)  // USART0_UDRE_vect (uart.c)
+#define ISR_PROFILE_TIMER3_CAPT (7)  // TIMER3_CAPT_vect (scheduler.c)
+#define ISR_PROFILE_TIMER3_COMPA (8)  // TIMER3_COMPA_vect (scheduler.c)
+#define ISR_PROFILE_COUNT (9)
+
+// Size of struct ISRProfile, for indexing from assembly.
+#define ISR_PROFILE_SIZE (12)
+
+// CPU cycles per TIMER1 period (ICR1 + 1), for durations that span a restart.
+#define ISR_PROFILE_TIMER1_PERIOD (20000)
+
+
+#ifdef __ASSEMBLER__
+
+
+#ifdef ISR_PROFILE
+  #include <avr/io.h>  // TCNT1L and TCNT1H are used by the markers
+
+.extern isr_profile_  ; struct ISRProfile[ISR_PROFILE_COUNT]
+.extern ISRProfileExit
+#endif
+
+; This marker must be the first instruction of the handler. It does not modify
+; SREG or any register.
+.macro ISR_PROFILE_ENTER id
+#ifdef ISR_PROFILE
+  push r0
+  lds r0, TCNT1L  ; Reading the lower byte latches the upper byte
+  sts isr_profile_ + \id * ISR_PROFILE_SIZE, r0
+  lds r0, TCNT1H
+  sts isr_profile_ + \id * ISR_PROFILE_SIZE + 1, r0
+  pop r0
+#endif
+.endm
+
+; This marker must be placed immediately before the reti of the handler. It does
+; not modify SREG or any register.
+.macro ISR_PROFILE_EXIT id
+#ifdef ISR_PROFILE
+  push r30
+  push r31
+  ldi r30, lo8(isr_profile_ + \id * ISR_PROFILE_SIZE)
+  ldi r31, hi8(isr_profile_ + \id * ISR_PROFILE_SIZE)
+  call ISRProfileExit
+  pop r31
+  pop r30
+#endif
+.endm
+
+
+#else  // __ASSEMBLER__
+
+
+#include <inttypes.h>
+
+#ifdef ISR_PROFILE
+  #include <avr/io.h>
+#endif
+
+
+struct ISRProfile {
+  uint16_t start;  // TCNT1 at entry
+  uint16_t max;  // cycles
+  uint32_t total;  // cycles (running total modulo 2^32 in isr_profile_)
+  uint32_t count;
+};
+
+_Static_assert(sizeof(struct ISRProfile) == ISR_PROFILE_SIZE,
+  "ISR_PROFILE_SIZE does not match struct ISRProfile");
+
+#ifdef ISR_PROFILE
+
+// This marker must be the first statement of the handler.
+#define ISR_PROFILE_ENTER(id) __asm__ __volatile__ ( \
+  "lds __tmp_reg__, %[tcnt1l]" "\n\t" \
+  "sts isr_profile_ + %[offset], __tmp_reg__" "\n\t" \
+  "lds __tmp_reg__, %[tcnt1h]" "\n\t" \
+  "sts isr_profile_ + %[offset] + 1, __tmp_reg__" "\n\t" \
+  : \
+  : [tcnt1l] "n" (_SFR_MEM_ADDR(TCNT1L)), \
+    [tcnt1h] "n" (_SFR_MEM_ADDR(TCNT1H)), \
+    [offset] "n" ((id) * ISR_PROFILE_SIZE) \
+  : "memory")
+
+// This marker must be the last statement of the handler.
+#define ISR_PROFILE_EXIT(id) __asm__ __volatile__ ( \
+  "push r30" "\n\t" \
+  "push r31" "\n\t" \
+  "ldi r30, lo8(isr_profile_ + %[offset])" "\n\t" \
+  "ldi r31, hi8(isr_profile_ + %[offset])" "\n\t" \
+  "call ISRProfileExit" "\n\t" \
+  "pop r31" "\n\t" \
+  "pop r30" "\n\t" \
+  : \
+  : [offset] "n" ((id) * ISR_PROFILE_SIZE) \
+  : "memory")
+
+#else
+
+#define ISR_PROFILE_ENTER(id)
+#define ISR_PROFILE_EXIT(id)
+
+#endif  // ISR_PROFILE
+
+
+// =============================================================================
+// Public functions:
+
+// This function copies the statistics of every handler accumulated since the
+// last call to "profiles" (ISR_PROFILE_COUNT entries) and clears them. It also
+// returns the number of ms since the last call.
+uint16_t ISRProfileSnapshot(struct ISRProfile * profiles);
+
+// -----------------------------------------------------------------------------
+// This function returns the running total (modulo 2^32) of the cycles spent in
+// the handler "id", which is not cleared by ISRProfileSnapshot(). It should be
+// called with interrupts disabled.
+uint32_t ISRProfileTotal(uint8_t id);
+
+
+#endif  // __ASSEMBLER__
+
+#endif  // ISR_PROFILE_H_
@@ -0,0 +1,171 @@
+#include "load_meter.h"
+
+#include <util/atomic.h>
+
+#include "adc.h"
+#include "frame_timing.h"
+#include "i2c.h"
+#include "isr_profile.h"
+
+
+// =============================================================================
+// Private data:
+
+// TIMER3 ticks spent in each module in the current window. The idle time is
+// not accumulated, but found from the rest when the window is closed.
+static uint32_t sums_[LOAD_MODULE_COUNT];
+static uint32_t elapsed_ = 0;  // TIMER3 ticks since the window began
+
+// The shares of the last complete window.
+static uint32_t window_sums_[LOAD_MODULE_COUNT];
+static uint32_t window_elapsed_ = 0;
+
+// Running total of the rate loop (modulo 2^32), which is the only part that is
+// written from an interrupt handler.
+static volatile uint32_t rate_loop_ticks_ = 0;
+
+// The module at work and the time at which it started.
+static enum LoadModule module_ = LOAD_MODULE_IDLE;
+static uint8_t mark_tick_ = 0, window_tick_ = 0;
+static uint16_t mark_time_ = 0;
+static uint32_t mark_rate_loop_ = 0, window_rate_loop_ = 0;
+
+// LoadMeterInterruptCycles() at the last mark (less the part that did not make
+// a whole tick) and at the start of the window.
+static uint32_t mark_interrupts_ = 0, window_interrupts_ = 0;
+static uint32_t window_adc_ = 0, window_motors_ = 0;  // ADC_vect and TWI_vect
+
+
+// =============================================================================
+// Private function declarations:
+
+static void CloseWindow(uint8_t tick, uint32_t rate_loop, uint32_t interrupts);
+
+
+// =============================================================================
+// Accessors:
+
+uint16_t LoadMeterShare(enum LoadModule module)
+{
+  // Dividing by the length in units of 0.1 % avoids an overflow of the sum.
+  const uint32_t per_mille = window_elapsed_ / 1000;
+  if (!per_mille) return 0;
+  return (uint16_t)(window_sums_[module] / per_mille);
+}
+
+// -----------------------------------------------------------------------------
+uint16_t LoadMeterWindow(void)
+{
+  return (uint16_t)(window_elapsed_ * FRAME_TIMING_CYCLES_PER_TICK
+    / (F_CPU / 1000));
+}
+
+
+// =============================================================================
+// Public functions:
+
+void LoadMeterAddRateLoop(uint16_t ticks, uint32_t interrupt_cycles)
+{
+  const uint32_t interrupt_ticks = interrupt_cycles
+    / FRAME_TIMING_CYCLES_PER_TICK;
+  if (ticks > interrupt_ticks) rate_loop_ticks_ += ticks - interrupt_ticks;
+}
+
+// -----------------------------------------------------------------------------
+// TIMER3_CAPT_vect is left out because its total includes the interrupts that
+// it lets in while it updates the buzzer, which are often a whole run of the
+// rate loop. Being short and at the frame rate, it is counted in the work that
+// it interrupts. Without ISR_TIMING, ADCInterruptCycles() and
+// I2CInterruptCycles() are 0, and the profiles of ADC_vect and TWI_vect (if
+// ISR_PROFILE is defined) are counted instead.
+uint32_t LoadMeterInterruptCycles(void)
+{
+  uint32_t cycles = ADCInterruptCycles() + I2CInterruptCycles();
+#ifdef ISR_PROFILE
+  for (uint8_t i = 0; i < ISR_PROFILE_COUNT; i++)
+  {
+    if ((i == ISR_PROFILE_TIMER3_COMPA) || (i == ISR_PROFILE_TIMER3_CAPT))
+      continue;
+#ifdef ISR_TIMING
+    if ((i == ISR_PROFILE_ADC) || (i == ISR_PROFILE_TWI)) continue;
+#endif
+    cycles += ISRProfileTotal(i);
+  }
+#endif
+  return cycles;
+}
+
+// -----------------------------------------------------------------------------
+void LoadMeterMark(enum LoadModule module)
+{
+  uint16_t time;
+  uint8_t tick;
+  uint32_t rate_loop, interrupts;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    tick = FrameTimingNow(&time);
+    rate_loop = rate_loop_ticks_;
+    interrupts = LoadMeterInterruptCycles();
+  }
+
+  const uint32_t elapsed = (uint32_t)(uint8_t)(tick - mark_tick_)
+    * FRAME_TIMING_TICKS_PER_FRAME + time - mark_time_;
+  const uint32_t interrupt_ticks = (interrupts - mark_interrupts_)
+    / FRAME_TIMING_CYCLES_PER_TICK;
+  const uint32_t interrupted = rate_loop - mark_rate_loop_ + interrupt_ticks;
+  if ((module_ != LOAD_MODULE_IDLE) && (elapsed > interrupted))
+    sums_[module_] += elapsed - interrupted;
+  elapsed_ += elapsed;
+
+  module_ = module;
+  mark_tick_ = tick;
+  mark_time_ = time;
+  mark_rate_loop_ = rate_loop;
+  mark_interrupts_ += interrupt_ticks * FRAME_TIMING_CYCLES_PER_TICK;
+
+  if ((uint8_t)(tick - window_tick_) >= LOAD_METER_WINDOW_FRAMES)
+    CloseWindow(tick, rate_loop, interrupts);
+}
+
+
+// =============================================================================
+// Private functions:
+
+static void CloseWindow(uint8_t tick, uint32_t rate_loop, uint32_t interrupts)
+{
+  sums_[LOAD_MODULE_RATE_LOOP] = rate_loop - window_rate_loop_;
+  uint32_t interrupt_cycles = interrupts - window_interrupts_;
+  uint32_t adc, motors;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    adc = ADCInterruptCycles();
+    motors = I2CInterruptCycles();
+  }
+  const uint32_t adc_cycles = adc - window_adc_;
+  const uint32_t motor_cycles = motors - window_motors_;
+  if (interrupt_cycles > adc_cycles + motor_cycles)
+    interrupt_cycles -= adc_cycles + motor_cycles;
+  else
+    interrupt_cycles = 0;
+  sums_[LOAD_MODULE_ADC] += adc_cycles / FRAME_TIMING_CYCLES_PER_TICK;
+  sums_[LOAD_MODULE_MOTORS] = motor_cycles / FRAME_TIMING_CYCLES_PER_TICK;
+  window_adc_ = adc;
+  window_motors_ = motors;
+  sums_[LOAD_MODULE_INTERRUPTS] = interrupt_cycles
+    / FRAME_TIMING_CYCLES_PER_TICK;
+
+  uint32_t busy = 0;
+  for (uint8_t i = LOAD_MODULE_IDLE + 1; i < LOAD_MODULE_COUNT; i++)
+  {
+    busy += sums_[i];
+    window_sums_[i] = sums_[i];
+    sums_[i] = 0;
+  }
+  window_sums_[LOAD_MODULE_IDLE] = elapsed_ > busy ? elapsed_ - busy : 0;
+  window_elapsed_ = elapsed_;
+
+  elapsed_ = 0;
+  window_tick_ = tick;
+  window_rate_loop_ = rate_loop;
+  window_interrupts_ = interrupts;
+}
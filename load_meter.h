@@ -0,0 +1,88 @@
+#ifndef LOAD_METER_H_
+#define LOAD_METER_H_
+
+
+// This file declares a meter of the CPU load, which gives the share of the
+// time spent in the work of each module over windows of 1 s
+// (LOAD_METER_WINDOW_FRAMES frames). The main loop marks the start of the work
+// of a module with LoadMeterMark() (see RunScheduledTasks() and
+// RunBackgroundJobs()), and the rate loop adds its own duration from its
+// interrupt handler. The time of the rate loop is taken out of the main loop
+// work that it interrupted, so each share is the time spent in that module
+// alone. Whatever is left of the window is idle.
+//
+// The shares of the interrupt handlers need the firmware to be built with
+// ISR_TIMING defined. Only then do the ADC handler (see ADCInterruptCycles())
+// and the TWI handler, which does the I2C transfers to the motors and the LED
+// indicator (see I2CInterruptCycles()), keep running totals of their own
+// cycles, which are counted in the ADC and motors shares. The timing is left
+// out of flight builds because it adds about a third to each run of the ADC
+// handler, the most frequent one (see adc.S). The other handlers (except the
+// frame tick) are only timed when the firmware is built with ISR_PROFILE
+// defined (see isr_profile.h), which is too slow for flight, and make up the
+// interrupts share, along with the ADC and TWI handlers if ISR_TIMING is not
+// defined. Any handler that is not timed is counted in the work that it
+// interrupts, including the idle time. The timed handlers are taken out of the
+// work that they interrupted, including the rate loop. The totals leave out the interrupt
+// response and the register saves and restores, so these shares are a little
+// low.
+//
+// The shares of the last complete window are reported by the load MK data
+// stream.
+
+#include <inttypes.h>
+
+
+#define LOAD_METER_WINDOW_FRAMES (128)
+
+enum LoadModule {
+  LOAD_MODULE_IDLE = 0,  // Also ends the work of the previous module
+  LOAD_MODULE_ADC,  // Sensor processing (and the ADC interrupt, see above)
+  LOAD_MODULE_ATTITUDE,
+  LOAD_MODULE_CONTROL,  // The outer loop
+  LOAD_MODULE_NAV_COMMS,
+  LOAD_MODULE_UART,  // Incoming messages and telemetry
+  LOAD_MODULE_OTHER,  // State, SBus, altitude, indicator, EEPROM, ...
+  LOAD_MODULE_RATE_LOOP,  // The rate loop and the motor setpoints (interrupt)
+  LOAD_MODULE_MOTORS,  // I2C to the motors and LED indicator (interrupt)
+  LOAD_MODULE_INTERRUPTS,  // The other interrupt handlers
+  LOAD_MODULE_COUNT,
+};
+
+
+// =============================================================================
+// Accessors:
+
+// This function returns the share of the last complete window that was spent
+// in "module", in units of 0.1 %.
+uint16_t LoadMeterShare(enum LoadModule module);
+
+// -----------------------------------------------------------------------------
+// This function returns the length of the last complete window in ms.
+uint16_t LoadMeterWindow(void);
+
+
+// =============================================================================
+// Public functions:
+
+// This function adds "ticks" (TIMER3 ticks) to the time of the rate loop, less
+// the time of the interrupts that it serviced, given by the difference in
+// LoadMeterInterruptCycles() over the same run. It should be called from the
+// rate loop interrupt with interrupts disabled.
+void LoadMeterAddRateLoop(uint16_t ticks, uint32_t interrupt_cycles);
+
+// -----------------------------------------------------------------------------
+// This function returns the running total (modulo 2^32) of the CPU cycles spent
+// in the timed interrupt handlers other than the rate loop: the ADC and TWI
+// handlers if ISR_TIMING or ISR_PROFILE is defined, and the others if
+// ISR_PROFILE is defined. It should be called with interrupts disabled.
+uint32_t LoadMeterInterruptCycles(void);
+
+// -----------------------------------------------------------------------------
+// This function ends the work of the previous module and starts that of
+// "module". It closes the window once LOAD_METER_WINDOW_FRAMES frames have
+// passed. It should only be called from the main loop.
+void LoadMeterMark(enum LoadModule module);
+
+
+#endif  // LOAD_METER_H_
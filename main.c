@@ -2,9 +2,12 @@
 
 #include "adc.h"
 #include "attitude.h"
+#include "background.h"
 #include "battery.h"
 #include "buzzer.h"
+#include "completion.h"
 #include "control.h"
+#include "frame_timing.h"
 #include "i2c.h"
 #include "indicator.h"
 #include "led.h"
@@ -15,6 +18,7 @@
 #include "nav_comms.h"
 #include "pressure_altitude.h"
 #include "sbus.h"
+#include "scheduler.h"
 #include "spi.h"
 #include "state.h"
 #include "timing.h"
@@ -27,12 +31,14 @@
   #include "motor_test.h"
 #endif
 
+#ifdef SIM_BENCH
+  #include "benchmarks.h"
+#endif
+
 
 // ============================================================================+
 // Private data:
 
-static volatile uint8_t flag_128hz_ = 0, flag_64hz_ = 0, flag_2hz_ = 0;
-static volatile uint16_t main_overrun_count_ = 0;
 static uint8_t board_version = 0;
 
 
@@ -58,9 +64,14 @@ void PreflightInit(void)
 {
   if (!MotorsInhibited()) return;
   BeepDuration(100);
+  // The rate loop would otherwise filter the raw rates while the gyro offsets
+  // are cleared, and then the step when they are restored.
+  StopRateLoop();
   ZeroGyros();
   ResetPressureSensorRange();
   ResetAttitude();
+  ResetRateLoop();
+  StartRateLoop();
   BeepDuration(500);
   WaitForBuzzerToComplete();
   // Warn if any automatic flight modes are armed.
@@ -80,8 +91,11 @@ void SensorCalibration(void)
 {
   if (!MotorsInhibited()) return;
   BeepDuration(100);
+  StopRateLoop();  // See PreflightInit()
   ZeroAccelerometers();
   ResetAttitude();
+  ResetRateLoop();
+  StartRateLoop();
   BeepDuration(500);
   WaitForBuzzerToComplete();
   ResetOverrun();
@@ -135,6 +149,7 @@ static void Init(void)
   ControlInit();  // Must be run after DetectMotors() to get NMotors()
 
   IndicatorInit();
+  StartRateLoop();  // Must be run after ControlInit() and IndicatorInit()
 
   ResetOverrun();
   GreenLEDOn();
@@ -144,7 +159,7 @@ static void Init(void)
 void ErrorCheck(void)
 {
   // Order from lowest to highest priority.
-  if (main_overrun_count_ > 10) BeepPattern(0x000000AA);
+  if (FrameOverrunCount() > 10) BeepPattern(0x000000AA);
 
   if (BatteryLow()) BeepPattern(0x000000CC);
 
@@ -160,14 +175,19 @@ void ErrorCheck(void)
 // -----------------------------------------------------------------------------
 void ResetOverrun(void)
 {
-  flag_128hz_ = 0;
-  main_overrun_count_ = 0;
+  ResetSchedulerFrame();
+  ResetFrameOverruns();
+  ResetFrameHistograms();
   RedLEDOff();
 }
 
 // -----------------------------------------------------------------------------
 int16_t main(void)
 {
+#ifdef SIM_BENCH
+  RunBenchmarks();  // Does not return
+#endif
+
   Init();
 
 #ifdef MOTOR_TEST
@@ -244,79 +264,14 @@ int16_t main(void)
   // Main loop
   for (;;)  // Preferred over while(1)
   {
-    if (flag_128hz_)
+    RunCompletions();
+    if (RunScheduledTasks())
     {
-      UpdateSBus();
-      UpdateState();
-
-      ProcessSensorReadings();
-
-      UpdateAttitude();
-      UpdatePressureAltitude();
-      UpdateVerticalSpeed();
-
-      Control();
-
-      ErrorCheck();
-
-      ProcessIncomingUART();
-      SendPendingUART();
-
-      if (main_overrun_count_) RedLEDOn();
-
-      flag_128hz_ = 0;
+      if (FrameOverrunCount()) RedLEDOn();
     }
-
-    if (flag_64hz_)
-    {
-      SendDataToNav();
-      flag_64hz_ = 0;
-    }
-
-    if (flag_2hz_)
+    else
     {
-      flag_2hz_ = 0;
+      RunBackgroundJobs();
     }
   }
 }
-
-// -----------------------------------------------------------------------------
-// This function is called upon the interrupt that occurs when TIMER3 reaches
-// the value in ICR3. This should occur at a rate of 128 Hz.
-ISR(TIMER3_CAPT_vect)
-{
-  enum {
-    COUNTER_128HZ = 0xFF >> 7,
-    COUNTER_64HZ = 0xFF >> 6,
-    COUNTER_32HZ = 0xFF >> 5,
-    COUNTER_16HZ = 0xFF >> 4,
-    COUNTER_8HZ = 0xFF >> 3,
-    COUNTER_4HZ = 0xFF >> 2,
-    COUNTER_2HZ = 0xFF >> 1,
-    COUNTER_1HZ = 0xFF >> 0,
-  };
-
-  sei();  // Allow other interrupts to be serviced
-
-  static uint8_t counter = 0;
-  switch ((uint8_t)(counter ^ (counter + 1))) {
-    case COUNTER_1HZ:
-    case COUNTER_2HZ:
-      flag_2hz_ = 1;
-    case COUNTER_4HZ:
-    case COUNTER_8HZ:
-    case COUNTER_16HZ:
-      UpdateBuzzer();
-    case COUNTER_32HZ:
-    case COUNTER_64HZ:
-      flag_64hz_ = 1;
-    case COUNTER_128HZ:
-      if (flag_128hz_)
-        main_overrun_count_++;
-      else
-        flag_128hz_ = 1;
-    default:
-      counter++;
-      break;
-  }
-}
@@ -2,8 +2,15 @@
 #define MAIN_H_
 
 
+// The outer loop (attitude estimation, position control, and the attitude
+// command) runs once per 128 Hz frame. The rate loop (the Kalman filter, the
+// angular rate feedback, and the motor setpoints) runs RATE_LOOP_FACTOR times
+// per frame (see RateControl()).
 #define FS (128.0)
 #define DT (1.0 / FS)
+#define RATE_LOOP_FACTOR (4)  // A power of 2
+#define FS_RATE (FS * RATE_LOOP_FACTOR)
+#define DT_RATE (1.0 / FS_RATE)
 #define GRAVITY_ACCELERATION (9.8)
 
 #define MAX_MOTORS (8)
@@ -30,6 +37,11 @@ uint8_t BoardVersion(void);
 // =============================================================================
 // Public functions:
 
+// This function sounds the buzzer to warn of problems (overruns, low battery,
+// and loss of the SBus signal).
+void ErrorCheck(void);
+
+// -----------------------------------------------------------------------------
 void PreflightInit(void);
 
 // -----------------------------------------------------------------------------
@@ -24,6 +24,20 @@ void HandleMKRx(uint8_t address, uint8_t label, const uint8_t * data_buffer)
     case 'd':  // Request MK debug stream
       SetMKDataStream(MK_STREAM_DEBUG, data_buffer[0]);
       break;
+    case 'f':  // Request frame timing stream
+      SetMKDataStream(MK_STREAM_FRAME_TIMING, data_buffer[0]);
+      break;
+    case 'h':  // Request frame histogram stream
+      SetMKDataStream(MK_STREAM_FRAME_HISTOGRAMS, data_buffer[0]);
+      break;
+    case 'l':  // Request CPU load stream
+      SetMKDataStream(MK_STREAM_LOAD, data_buffer[0]);
+      break;
+#ifdef ISR_PROFILE
+    case 'p':  // Request interrupt handler profile stream
+      SetMKDataStream(MK_STREAM_ISR_PROFILE, data_buffer[0]);
+      break;
+#endif
     case 'v':  // Request firmware version
       SetMKTxRequest(MK_TX_VERSION);
       break;
@@ -3,9 +3,13 @@
 #include "adc.h"
 #include "attitude.h"
 #include "control.h"
+#include "frame_timing.h"
+#include "isr_profile.h"
+#include "load_meter.h"
 #include "mk_serial_protocol.h"
 #include "motors.h"
 #include "sbus.h"
+#include "scheduler.h"
 #include "state.h"
 #include "timing.h"
 #include "union_types.h"
@@ -25,7 +29,13 @@ static uint16_t stream_period_ = 0, stream_timer_ = 0, stream_timeout_ = 0;
 // Private function declarations:
 
 static void SendControlData(void);
+static void SendFrameHistogramData(void);
+static void SendFrameTimingData(void);
+#ifdef ISR_PROFILE
+static void SendISRProfileData(void);
+#endif
 static void SendKalmanData(void);
+static void SendLoadData(void);
 static void SendMotorSetpoints(void);
 static void SendSensorData(void);
 static void SendVersion(void);
@@ -51,9 +61,23 @@ void SendPendingMKSerial(void)
       case MK_STREAM_CONTROL:
         SendControlData();
         break;
+      case MK_STREAM_FRAME_HISTOGRAMS:
+        SendFrameHistogramData();
+        break;
+      case MK_STREAM_FRAME_TIMING:
+        SendFrameTimingData();
+        break;
+#ifdef ISR_PROFILE
+      case MK_STREAM_ISR_PROFILE:
+        SendISRProfileData();
+        break;
+#endif
       case MK_STREAM_KALMAN:
         SendKalmanData();
         break;
+      case MK_STREAM_LOAD:
+        SendLoadData();
+        break;
       case MK_STREAM_MOTOR_SETPOINTS:
         SendMotorSetpoints();
         break;
@@ -77,8 +101,8 @@ void SendPendingMKSerial(void)
 // This function starts the specified data stream at the specified period. Note
 // that this stream has to be renewed periodically by resending the request. If
 // no renewing request is received, then the stream will time out after a while.
-// Also note that the stream output period will be quantized to the main control
-// frequency.
+// Also note that the stream output period will be quantized to the rate of
+// SendPendingUART() (requested at 64 Hz, see scheduler.c).
 void SetMKDataStream(enum MKStream mk_stream, uint16_t period_10ms)
 {
   mk_stream_ = mk_stream;
@@ -134,6 +158,115 @@ static void SendControlData(void)
   MKSerialTx(1, 'I', (uint8_t *)&debug_data, sizeof(debug_data));
 }
 
+// -----------------------------------------------------------------------------
+// This function sends the histograms of the latency and completion time of the
+// 128 Hz frames since the previous transmission (see frame_timing.h), along
+// with the overrun count.
+static void SendFrameHistogramData(void)
+{
+  struct FrameHistogramData {
+    uint16_t timestamp;
+    uint16_t overrun_count;
+    uint16_t latency[FRAME_HISTOGRAM_N_BINS];
+    uint16_t completion[FRAME_HISTOGRAM_N_BINS];
+  } __attribute__((packed)) frame_histogram_data;
+
+  _Static_assert(((sizeof(struct FrameHistogramData) + 2) / 3) * 4 + 6
+    < UART_TX_BUFFER_LENGTH,
+    "FrameHistogramData is too large for the UART TX buffer");
+
+  frame_histogram_data.timestamp = GetTimestamp();
+  frame_histogram_data.overrun_count = FrameOverrunCount();
+  const uint16_t * latency = FrameLatencyHistogram();
+  const uint16_t * completion = FrameCompletionHistogram();
+  for (uint8_t i = FRAME_HISTOGRAM_N_BINS; i--; )
+  {
+    frame_histogram_data.latency[i] = latency[i];
+    frame_histogram_data.completion[i] = completion[i];
+  }
+  ResetFrameHistograms();
+
+  MKSerialTx(1, 'I', (uint8_t *)&frame_histogram_data,
+    sizeof(frame_histogram_data));
+}
+
+// -----------------------------------------------------------------------------
+// This function sends the duration of each main loop stage, and of the whole
+// 128 Hz frame, since the previous transmission (see frame_timing.h), along
+// with the number of times that each task ran over its budget and the load
+// shedding (see scheduler.h).
+static void SendFrameTimingData(void)
+{
+  struct FrameTimingData {
+    uint16_t timestamp;
+    uint16_t n_frames;
+    struct FrameTimingStatistic frame;
+    struct FrameTimingStatistic stage[PROFILE_STAGE_COUNT - 1];
+    uint16_t over_budget[PROFILE_STAGE_COUNT - 1];
+    uint8_t load_shed_level;
+    uint16_t load_shed_count;
+    uint16_t rate_loop_max;  // TIMER3 ticks
+    uint16_t rate_loop_over_budget;
+  } __attribute__((packed)) frame_timing_data;
+
+  _Static_assert(((sizeof(struct FrameTimingData) + 2) / 3) * 4 + 6
+    < UART_TX_BUFFER_LENGTH,
+    "FrameTimingData is too large for the UART TX buffer");
+
+  frame_timing_data.timestamp = GetTimestamp();
+  frame_timing_data.n_frames = FrameTimingCount();
+  frame_timing_data.frame = FrameTiming();
+  // PROFILE_STAGE_IDLE is not timed, so it is skipped.
+  for (uint8_t i = PROFILE_STAGE_COUNT - 1; i--; )
+  {
+    frame_timing_data.stage[i] = FrameTimingStage((enum ProfileStage)(i + 1));
+    frame_timing_data.over_budget[i]
+      = TaskOverBudgetCount((enum ProfileStage)(i + 1));
+  }
+  frame_timing_data.load_shed_level = LoadShedLevel();
+  frame_timing_data.load_shed_count = LoadShedCount();
+  frame_timing_data.rate_loop_max = RateLoopMaxDuration();
+  frame_timing_data.rate_loop_over_budget = RateLoopOverBudgetCount();
+  ResetFrameTiming();
+  ResetTaskOverBudgetCounts();
+
+  MKSerialTx(1, 'I', (uint8_t *)&frame_timing_data, sizeof(frame_timing_data));
+}
+
+// -----------------------------------------------------------------------------
+#ifdef ISR_PROFILE
+// This function sends the execution time statistics of each interrupt handler
+// since the previous transmission (see isr_profile.h).
+static void SendISRProfileData(void)
+{
+  struct ISRProfileData {
+    uint16_t timestamp;
+    uint16_t window;  // ms
+    struct {
+      uint16_t max;  // cycles
+      uint32_t total;  // cycles
+      uint32_t count;
+    } __attribute__((packed)) handler[ISR_PROFILE_COUNT];
+  } __attribute__((packed)) isr_profile_data;
+
+  _Static_assert(((sizeof(struct ISRProfileData) + 2) / 3) * 4 + 6
+    < UART_TX_BUFFER_LENGTH,
+    "ISRProfileData is too large for the UART TX buffer");
+
+  struct ISRProfile profiles[ISR_PROFILE_COUNT];
+  isr_profile_data.window = ISRProfileSnapshot(profiles);
+  for (uint8_t i = ISR_PROFILE_COUNT; i--; )
+  {
+    isr_profile_data.handler[i].max = profiles[i].max;
+    isr_profile_data.handler[i].total = profiles[i].total;
+    isr_profile_data.handler[i].count = profiles[i].count;
+  }
+  isr_profile_data.timestamp = GetTimestamp();
+
+  MKSerialTx(1, 'I', (uint8_t *)&isr_profile_data, sizeof(isr_profile_data));
+}
+#endif
+
 // -----------------------------------------------------------------------------
 static void SendKalmanData(void)
 {
@@ -165,6 +298,28 @@ static void SendKalmanData(void)
   MKSerialTx(1, 'I', (uint8_t *)&kalman_data, sizeof(kalman_data));
 }
 
+// -----------------------------------------------------------------------------
+// This function sends the share of the CPU time taken by each module (and the
+// idle time) in the last complete window of the load meter (see load_meter.h).
+static void SendLoadData(void)
+{
+  struct LoadData {
+    uint16_t timestamp;
+    uint16_t window;  // ms
+    uint16_t share[LOAD_MODULE_COUNT];  // 0.1 %
+  } __attribute__((packed)) load_data;
+
+  _Static_assert(((sizeof(struct LoadData) + 2) / 3) * 4 + 6
+    < UART_TX_BUFFER_LENGTH, "LoadData is too large for the UART TX buffer");
+
+  load_data.timestamp = GetTimestamp();
+  load_data.window = LoadMeterWindow();
+  for (uint8_t i = LOAD_MODULE_COUNT; i--; )
+    load_data.share[i] = LoadMeterShare((enum LoadModule)i);
+
+  MKSerialTx(1, 'I', (uint8_t *)&load_data, sizeof(load_data));
+}
+
 // -----------------------------------------------------------------------------
 static void SendMotorSetpoints(void)
 {
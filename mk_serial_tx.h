@@ -24,7 +24,11 @@ enum MKStream {
   MK_STREAM_NONE = 0,
   MK_STREAM_CONTROL,
   MK_STREAM_DEBUG,
+  MK_STREAM_FRAME_HISTOGRAMS,
+  MK_STREAM_FRAME_TIMING,
+  MK_STREAM_ISR_PROFILE,
   MK_STREAM_KALMAN,
+  MK_STREAM_LOAD,
   MK_STREAM_MOTOR_SETPOINTS,
   MK_STREAM_SENSORS,
 };
@@ -40,8 +44,8 @@ void SendPendingMKSerial(void);
 // This function starts the specified data stream at the specified period. Note
 // that this stream has to be renewed periodically by resending the request. If
 // no renewing request is received, then the stream will time out after a while.
-// Also note that the stream output period will be quantized to the main control
-// frequency.
+// Also note that the stream output period will be quantized to the rate of
+// SendPendingUART() (requested at 64 Hz, see scheduler.c).
 void SetMKDataStream(enum MKStream mk_stream, uint16_t period_10ms);
 
 // -----------------------------------------------------------------------------
@@ -25,10 +25,12 @@
 #include <avr/interrupt.h>
 
 #include "adc.h"
+#include "completion.h"
 #include "led.h"
 #include "mcu_pins.h"
 #include "motors.h"
 #include "sbus.h"
+#include "scheduler.h"
 #include "timing.h"
 #include "uart.h"
 
@@ -55,6 +57,11 @@ void MotorTest(void)
   UpdateSBus();
   if (SBusSwitch(0) != SBUS_SWITCH_UP) return;
 
+  // The test drives the motors from here, so the rate loop must not overwrite
+  // the setpoints or start I2C transactions of its own until it is restarted
+  // at the end.
+  StopRateLoop();
+
   UARTPrintf("");
   UARTPrintf("Motor Test Started");
   UARTPrintf("Waiting for switch 1");
@@ -73,6 +80,7 @@ void MotorTest(void)
 
     SetMotorSetpoint(0, 0);
     TxMotorSetpoints();
+    RunCompletions();
   }
   RedLEDOff();
 
@@ -116,6 +124,7 @@ void MotorTest(void)
   EIMSK = 0x00;
   EXTERNAL_LED_DDR |= EXTERNAL_LED_1_PIN | EXTERNAL_LED_3_PIN;
   TimingInit();
+  StartRateLoop();
   ADCOn();
 }
 
@@ -138,6 +147,10 @@ static void MotorTestStep(uint16_t command, uint16_t duration_ms)
 
   for (;;)
   {
+    // The main loop is not running, so process the motor I2C completions here
+    // before the queue overflows.
+    RunCompletions();
+
     if (new_pulse)
     {
       new_pulse = 0;
@@ -1,7 +1,9 @@
 #include "motors.h"
 
 #include <string.h>
+#include <util/atomic.h>
 
+#include "completion.h"
 #include "eeprom.h"
 #include "i2c.h"
 #include "indicator.h"
@@ -80,14 +82,21 @@ static uint8_t blc_feature_BIT_bits_ = 0x00;
 static uint8_t n_motors_ = 0;
 static uint8_t setpoint_length_ = sizeof(uint8_t);
 static uint8_t comms_in_progress_;  // Address to which communication is ongoing
+static uint8_t status_address_ = 0;  // Motor whose status is read in a sequence
+static volatile uint8_t comms_inhibited_ = 0;  // Set during DetectMotors()
 
 static struct MotorSetpoint setpoints_[MAX_MOTORS] = { { 0 } };
-static volatile struct BLCStatus blc_status_[MAX_MOTORS] = { { 0 } };
+static struct MotorSetpoint tx_setpoints_[MAX_MOTORS];  // Sequence in progress
+static volatile struct BLCStatus rx_blc_status_[MAX_MOTORS];  // I2C target
+static struct BLCStatus blc_status_[MAX_MOTORS] = { { 0 } };  // Last received
+static uint8_t motors_starting_ = 0;  // Bit field
 
 
 // =============================================================================
 // Private function declarations:
 
+static void IdentifyMotors(void);
+static void ProcessBLCStatus(uint8_t address);
 static void TxMotorSetpoint(uint8_t address);
 
 
@@ -123,6 +132,60 @@ void DetectMotors(void)
 {
   if (MotorsRunning()) return;
 
+  // Keep the rate loop from starting another sequence of setpoints (see
+  // TxMotorSetpoints()) and let the one in progress finish.
+  comms_inhibited_ = 1;
+  I2CWaitUntilCompletion(100);
+  IdentifyMotors();
+  comms_inhibited_ = 0;
+}
+
+// -----------------------------------------------------------------------------
+uint8_t MotorsStarting(void)
+{
+  return (motors_starting_ & ((1 << n_motors_) - 1)) != 0;
+}
+
+// -----------------------------------------------------------------------------
+void SetMotorSetpoint(uint8_t address, uint16_t setpoint)
+{
+  if (address >= MAX_MOTORS) return;
+  setpoints_[address].bits_2_to_0 = (uint8_t)setpoint & 0x7;
+  setpoints_[address].bits_11_to_3 = (uint8_t)(setpoint >> 3);
+}
+
+// -----------------------------------------------------------------------------
+void SetNMotors(uint8_t n_motors)
+{
+  if (n_motors > MAX_MOTORS) n_motors = MAX_MOTORS;
+  eeprom_update_byte(&eeprom.n_motors, n_motors);
+  DetectMotors();
+}
+
+// -----------------------------------------------------------------------------
+// This function starts a sequence of I2C transactions that sends the latest
+// setpoints to the motors, unless the previous sequence is still in progress.
+// The status of only one motor (each in turn) is read in a sequence so that
+// the sequence fits in a step of the rate loop. The I2C indicator is updated at
+// the end of the sequence.
+void TxMotorSetpoints(void)
+{
+  if (comms_inhibited_ || !I2CIsIdle()) return;
+
+  memcpy(tx_setpoints_, setpoints_, sizeof(tx_setpoints_));
+  if (++status_address_ >= n_motors_) status_address_ = 0;
+  comms_in_progress_ = n_motors_ - 1;
+  TxMotorSetpoint(comms_in_progress_);
+}
+
+
+// =============================================================================
+// Private functions:
+
+// This function sends a 0 command to each possible controller address and
+// identifies the controllers from their responses.
+static void IdentifyMotors(void)
+{
   // Send a 0 command to each brushless controller address and record any
   // responses.
   uint8_t motors = 0;  // Bit field representing motors present.
@@ -131,7 +194,7 @@ void DetectMotors(void)
   for (uint8_t i = 0; i < MAX_MOTORS; i++)
   {
     I2CTxThenRx(MOTORS_BASE_ADDRESS + (i << 1), &setpoint, sizeof(setpoint),
-      (volatile uint8_t *)&blc_status_[i], sizeof(struct BLCStatus));
+      (volatile uint8_t *)&rx_blc_status_[i], sizeof(struct BLCStatus));
     I2CWaitUntilCompletion(100);
     // I2C will give an error if there is no response.
     if (!I2CError())
@@ -140,11 +203,24 @@ void DetectMotors(void)
 
       // Check that all controllers are the same type.
       if (blc_status_code == BLC_STATUS_UNKNOWN)
-        blc_status_code = blc_status_[i].status_code;
-      else if (blc_status_[i].status_code != blc_status_code)
+        blc_status_code = rx_blc_status_[i].status_code;
+      else if (rx_blc_status_[i].status_code != blc_status_code)
         blc_error_bits_ |= BLC_ERROR_BIT_INCONSISTENT_SETTINGS;
     }
   }
+
+  // Keep the statuses that were received, as ProcessBLCStatus() does for the
+  // statuses read with the setpoints. No transaction is in progress.
+  motors_starting_ = 0;
+  for (uint8_t i = 0; i < MAX_MOTORS; i++)
+  {
+    if (!(motors & (1 << i))) continue;
+    memcpy(&blc_status_[i], (const void *)&rx_blc_status_[i],
+      sizeof(struct BLCStatus));
+    if (blc_status_[i].status_code == BLC_STATUS_STARTING)
+      motors_starting_ |= 1 << i;
+  }
+
   if (blc_error_bits_ & BLC_ERROR_BIT_INCONSISTENT_SETTINGS)
   {
     UARTPrintf("motors: ERROR: inconsistent settings for motor controllers");
@@ -214,43 +290,37 @@ void DetectMotors(void)
 }
 
 // -----------------------------------------------------------------------------
-uint8_t MotorsStarting(void)
-{
-  uint8_t result = 0;
-  for (uint8_t i = n_motors_; i--; )
-    result |= blc_status_[i].status_code == BLC_STATUS_STARTING;
-  return result;
-}
-
-// -----------------------------------------------------------------------------
-void SetMotorSetpoint(uint8_t address, uint16_t setpoint)
+// This function is run from the main loop after the status of the motor at
+// "address" has been received (see TxNextMotorSetpoint()). It keeps a copy of
+// the status that cannot change while it is being read, and updates the
+// information that is derived from it.
+static void ProcessBLCStatus(uint8_t address)
 {
-  if (address >= MAX_MOTORS) return;
-  setpoints_[address].bits_2_to_0 = (uint8_t)setpoint & 0x7;
-  setpoints_[address].bits_11_to_3 = (uint8_t)(setpoint >> 3);
-}
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    // Skip the copy if the status of this motor is being received again. That
+    // transaction will queue its own update.
+    if ((address == status_address_) && (address == comms_in_progress_))
+      return;
+    memcpy(&blc_status_[address], (const void *)&rx_blc_status_[address],
+      sizeof(struct BLCStatus));
+  }
 
-// -----------------------------------------------------------------------------
-void SetNMotors(uint8_t n_motors)
-{
-  if (n_motors > MAX_MOTORS) n_motors = MAX_MOTORS;
-  eeprom_update_byte(&eeprom.n_motors, n_motors);
-  DetectMotors();
+  if (blc_status_[address].status_code == BLC_STATUS_STARTING)
+    motors_starting_ |= 1 << address;
+  else
+    motors_starting_ &= ~(1 << address);
 }
 
 // -----------------------------------------------------------------------------
-void TxMotorSetpoints(void)
-{
-  comms_in_progress_ = n_motors_ - 1;
-  TxMotorSetpoint(comms_in_progress_);
-}
-
-
-// =============================================================================
-// Private functions:
-
+// This function is called from the TWI interrupt at the end of each transaction
+// of the sequence started by TxMotorSetpoints(). It only starts the next
+// transaction, and leaves the received status to ProcessBLCStatus().
 static void TxNextMotorSetpoint(void)
 {
+  if ((comms_in_progress_ == status_address_) && !I2CError())
+    PostCompletion(ProcessBLCStatus, status_address_);
+
   // Update the I2C indicator after the last motor has been updated.
   if (comms_in_progress_--)
     TxMotorSetpoint(comms_in_progress_);
@@ -261,8 +331,13 @@ static void TxNextMotorSetpoint(void)
 // -----------------------------------------------------------------------------
 static void TxMotorSetpoint(uint8_t address)
 {
-  I2CTxThenRxThenCallback(MOTORS_BASE_ADDRESS + (address << 1),
-    (uint8_t *)&setpoints_[address], setpoint_length_,
-    (volatile uint8_t *)&blc_status_[address], sizeof(struct BLCStatus),
-    TxNextMotorSetpoint);
+  if (address == status_address_)
+    I2CTxThenRxThenCallback(MOTORS_BASE_ADDRESS + (address << 1),
+      (uint8_t *)&tx_setpoints_[address], setpoint_length_,
+      (volatile uint8_t *)&rx_blc_status_[address], sizeof(struct BLCStatus),
+      TxNextMotorSetpoint);
+  else
+    I2CTxThenRxThenCallback(MOTORS_BASE_ADDRESS + (address << 1),
+      (uint8_t *)&tx_setpoints_[address], setpoint_length_,
+      (volatile uint8_t *)0, 0, TxNextMotorSetpoint);
 }
@@ -14,6 +14,7 @@
 #include "sbus.h"
 #include "ut_serial_protocol.h"
 #include "timing.h"
+#include "trace.h"
 #include "union_types.h"
 #include "vertical_speed.h"
 
@@ -210,7 +211,7 @@ void ProcessDataFromNav(const uint8_t * data_buffer)
 {
   struct FromNav * from_nav_data_buffer;
   from_nav_data_buffer = (struct FromNav *)data_buffer;
-
+  Trace(TRACE_EVENT_NAV_DATA, from_nav_data_buffer->version);
 
   if(from_nav_data_buffer->version == NAV_COMMS_VERSION){
     // Copy data from data_buffer
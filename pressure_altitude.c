@@ -224,7 +224,7 @@ void ResetPressureSensorRange(void)
   }
 
   // Save the found bias_coarse to EEPROM.
-  eeprom_update_byte(&eeprom.pressure_bias, bias_coarse);
+  DeferredEEPROMUpdateByte(&eeprom.pressure_bias, bias_coarse);
 
   // Search for the optimal fine bias.
   int16_t bias_fine = bias_coarse;
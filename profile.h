@@ -0,0 +1,60 @@
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+
+// This file defines markers that identify the stages of the main loop for the
+// cycle profiler (see sim/profile.c and "make profile"). When the firmware is
+// built with SIM_PROFILE defined, ProfileStage() writes the stage number to
+// GPIOR0, which the simulator watches in order to attribute cycles to stages.
+// Otherwise, ProfileStage() compiles to nothing.
+
+// Data space address of GPIOR0 (I/O address 0x1E).
+#define PROFILE_MARKER_ADDRESS (0x3E)
+
+
+#ifndef __ASSEMBLER__
+
+
+#include <inttypes.h>
+
+#ifdef SIM_PROFILE
+  #include <avr/io.h>
+#endif
+
+
+enum ProfileStage {
+  PROFILE_STAGE_IDLE = 0,
+  PROFILE_STAGE_UPDATE_SBUS,
+  PROFILE_STAGE_UPDATE_STATE,
+  PROFILE_STAGE_PROCESS_SENSOR_READINGS,
+  PROFILE_STAGE_UPDATE_ATTITUDE,
+  PROFILE_STAGE_UPDATE_PRESSURE_ALTITUDE,
+  PROFILE_STAGE_UPDATE_VERTICAL_SPEED,
+  PROFILE_STAGE_CONTROL,
+  PROFILE_STAGE_ERROR_CHECK,
+  PROFILE_STAGE_PROCESS_INCOMING_UART,
+  PROFILE_STAGE_SEND_PENDING_UART,
+  PROFILE_STAGE_SEND_DATA_TO_NAV,
+  PROFILE_STAGE_UPDATE_INDICATOR,
+  PROFILE_STAGE_COUNT,
+};
+
+
+// =============================================================================
+// Public functions:
+
+// This function marks the beginning of a main loop stage (or the return to
+// idle when stage is PROFILE_STAGE_IDLE).
+static inline void ProfileStage(enum ProfileStage stage)
+{
+#ifdef SIM_PROFILE
+  GPIOR0 = stage;
+#else
+  (void)stage;
+#endif
+}
+
+
+#endif  // __ASSEMBLER__
+
+#endif  // PROFILE_H_
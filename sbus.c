@@ -5,6 +5,7 @@
 
 #include "eeprom.h"
 #include "timing.h"
+#include "trace.h"
 
 
 // =============================================================================
@@ -121,6 +122,12 @@ uint8_t SBusStale(void)
   return sbus_error_bits_ & SBUS_ERROR_BIT_STALE;
 }
 
+// -----------------------------------------------------------------------------
+uint8_t SBusNewData(void)
+{
+  return sbus_data_ready_ != SBUS_NO_NEW_DATA;
+}
+
 
 // =============================================================================
 // Public functions:
@@ -184,19 +191,20 @@ void SBusSetChannels(uint8_t pitch, uint8_t roll, uint8_t yaw, uint8_t thrust,
   channel_trim_[1] = trim1;
   channel_trim_[2] = trim2;
   channel_trim_[3] = trim3;
-  eeprom_update_byte(&eeprom.sbus_channel_pitch, pitch);
-  eeprom_update_byte(&eeprom.sbus_channel_roll, roll);
-  eeprom_update_byte(&eeprom.sbus_channel_yaw, yaw);
-  eeprom_update_byte(&eeprom.sbus_channel_thrust, thrust);
-  eeprom_update_byte(&eeprom.sbus_channel_on_off, on_off);
-  eeprom_update_byte(&eeprom.sbus_channel_altitude_control, altitude_control);
-  eeprom_update_byte(&eeprom.sbus_channel_nav_control, nav_control);
-  eeprom_update_byte(&eeprom.sbus_channel_takeoff, takeoff);
-  eeprom_update_byte(&eeprom.sbus_channel_go_home, go_home);
-  eeprom_update_block((const void*)channel_switch_,
-    (void*)&eeprom.sbus_channel_switch[0], sizeof(channel_switch_));
-  eeprom_update_block((const void*)channel_trim_,
-    (void*)&eeprom.sbus_channel_trim[0], sizeof(channel_trim_));
+  DeferredEEPROMUpdateByte(&eeprom.sbus_channel_pitch, pitch);
+  DeferredEEPROMUpdateByte(&eeprom.sbus_channel_roll, roll);
+  DeferredEEPROMUpdateByte(&eeprom.sbus_channel_yaw, yaw);
+  DeferredEEPROMUpdateByte(&eeprom.sbus_channel_thrust, thrust);
+  DeferredEEPROMUpdateByte(&eeprom.sbus_channel_on_off, on_off);
+  DeferredEEPROMUpdateByte(&eeprom.sbus_channel_altitude_control,
+    altitude_control);
+  DeferredEEPROMUpdateByte(&eeprom.sbus_channel_nav_control, nav_control);
+  DeferredEEPROMUpdateByte(&eeprom.sbus_channel_takeoff, takeoff);
+  DeferredEEPROMUpdateByte(&eeprom.sbus_channel_go_home, go_home);
+  DeferredEEPROMUpdate((void*)&eeprom.sbus_channel_switch[0],
+    (const void*)channel_switch_, sizeof(channel_switch_));
+  DeferredEEPROMUpdate((void*)&eeprom.sbus_channel_trim[0],
+    (const void*)channel_trim_, sizeof(channel_trim_));
 }
 
 // -----------------------------------------------------------------------------
@@ -274,6 +282,7 @@ void UpdateSBus(void)
   // Record the timestamp
   ((uint8_t*)&sbus_data_.timestamp)[0] = rx_buffer[SBUS_RX_BUFFER_LENGTH - 2];
   ((uint8_t*)&sbus_data_.timestamp)[1] = rx_buffer[SBUS_RX_BUFFER_LENGTH - 1];
+  Trace(TRACE_EVENT_SBUS_FRAME, sbus_data_.timestamp);
 
   sbus_data_.binary = rx_buffer[SBusByte(23)];
 
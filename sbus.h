@@ -70,6 +70,11 @@ int16_t SBusTrim(uint8_t i);
 // -----------------------------------------------------------------------------
 uint8_t SBusStale(void);
 
+// -----------------------------------------------------------------------------
+// This function returns 1 if an SBus message has been received that has not yet
+// been processed by UpdateSBus().
+uint8_t SBusNewData(void);
+
 
 // =============================================================================
 // Public functions:
@@ -0,0 +1,394 @@
+#include "scheduler.h"
+
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#include "adc.h"
+#include "attitude.h"
+#include "background.h"
+#include "budget_check.h"
+#include "buzzer.h"
+#include "control.h"
+#include "frame_timing.h"
+#include "indicator.h"
+#include "isr_profile.h"
+#include "load_meter.h"
+#include "main.h"
+#include "nav_comms.h"
+#include "pressure_altitude.h"
+#include "sbus.h"
+#include "state.h"
+#include "trace.h"
+#include "uart.h"
+#include "vertical_speed.h"
+
+
+// =============================================================================
+// Private data:
+
+// Converts a budget in microseconds to TIMER3 ticks.
+#define TASK_BUDGET_US(us) \
+  ((uint16_t)((us) * (F_CPU / 1000000UL) / FRAME_TIMING_CYCLES_PER_TICK))
+
+// The rate loop (RateControl() in TIMER3_COMPA_vect) runs RATE_LOOP_FACTOR
+// times per frame with interrupts enabled, and every task below is interrupted
+// by it. Its work is fixed: the only loop is the mixer over the motors, so it
+// is longest on the airframes with 8 motors. Each step, including the
+// interrupts that it lets in, is held to RATE_LOOP_BUDGET_US (see scheduler.h),
+// so the rate loop takes at most 2000 us of the 7812 us frame. A step that
+// takes longer is counted, and the longest step is kept (see
+// RateLoopOverBudgetCount() and RateLoopMaxDuration()). Both are reported by
+// the frame timing stream.
+#define RATE_LOOP_BUDGET TASK_BUDGET_US(RATE_LOOP_BUDGET_US)
+
+struct Task {
+  void (*function)(void);
+  uint8_t period;  // 128 Hz frames (a power of 2)
+  uint8_t phase;  // Frame within the period in which the task runs
+  enum TaskPriority priority;
+  uint16_t budget;  // TIMER3 ticks
+  enum ProfileStage stage;  // Identifies the task for frame timing
+  enum LoadModule module;  // Identifies the task for the load meter
+};
+
+// The frame is 7812 us long, so the budgets add up to less than that. Telemetry
+// and the data for the NaviCtrl share the UART, so they run in alternate frames
+// instead of competing for the Tx buffer in the same one. Telemetry is only
+// requested here and is sent in the slack time of the frame (see background.h).
+// The indicator writes one LED register per frame at the end of the motor I2C
+// sequence (see TxIndicatorUpdate()), so it runs every frame, before Control().
+// The buzzer is not a task (see TIMER3_CAPT_vect), and neither is the rate loop
+// (see TIMER3_COMPA_vect). The tasks are interrupted by the rate loop, so their
+// durations include it.
+static void RequestTelemetry(void);  // Defined below
+
+static const struct Task kTasks[] = {
+  { UpdateSBus, 1, 0, TASK_PRIORITY_CRITICAL, TASK_BUDGET_US(100),
+    PROFILE_STAGE_UPDATE_SBUS, LOAD_MODULE_OTHER },
+  { UpdateState, 1, 0, TASK_PRIORITY_CRITICAL, TASK_BUDGET_US(100),
+    PROFILE_STAGE_UPDATE_STATE, LOAD_MODULE_OTHER },
+  { ProcessSensorReadings, 1, 0, TASK_PRIORITY_CRITICAL, TASK_BUDGET_US(600),
+    PROFILE_STAGE_PROCESS_SENSOR_READINGS, LOAD_MODULE_ADC },
+  { UpdateAttitude, 1, 0, TASK_PRIORITY_CRITICAL, TASK_BUDGET_US(1200),
+    PROFILE_STAGE_UPDATE_ATTITUDE, LOAD_MODULE_ATTITUDE },
+  { UpdatePressureAltitude, 1, 0, TASK_PRIORITY_CRITICAL, TASK_BUDGET_US(300),
+    PROFILE_STAGE_UPDATE_PRESSURE_ALTITUDE, LOAD_MODULE_OTHER },
+  { UpdateVerticalSpeed, 1, 0, TASK_PRIORITY_CRITICAL, TASK_BUDGET_US(300),
+    PROFILE_STAGE_UPDATE_VERTICAL_SPEED, LOAD_MODULE_OTHER },
+  { UpdateIndicator, 1, 0, TASK_PRIORITY_NORMAL, TASK_BUDGET_US(50),
+    PROFILE_STAGE_UPDATE_INDICATOR, LOAD_MODULE_OTHER },
+  { Control, 1, 0, TASK_PRIORITY_CRITICAL, TASK_BUDGET_US(1000),
+    PROFILE_STAGE_CONTROL, LOAD_MODULE_CONTROL },
+  { ErrorCheck, 1, 0, TASK_PRIORITY_NORMAL, TASK_BUDGET_US(50),
+    PROFILE_STAGE_ERROR_CHECK, LOAD_MODULE_OTHER },
+  { ProcessIncomingUART, 1, 0, TASK_PRIORITY_NORMAL, TASK_BUDGET_US(500),
+    PROFILE_STAGE_PROCESS_INCOMING_UART, LOAD_MODULE_UART },
+  { RequestTelemetry, 2, 0, TASK_PRIORITY_LOW, TASK_BUDGET_US(50),
+    PROFILE_STAGE_SEND_PENDING_UART, LOAD_MODULE_UART },
+  { SendDataToNav, 2, 1, TASK_PRIORITY_NORMAL, TASK_BUDGET_US(500),
+    PROFILE_STAGE_SEND_DATA_TO_NAV, LOAD_MODULE_NAV_COMMS },
+};
+
+#define N_TASKS (sizeof(kTasks) / sizeof(kTasks[0]))
+
+// The order in which work is shed. Level n sheds the first n entries, each of
+// which either stops a task (period 0) or runs it at a longer period (which
+// must exceed its phase).
+struct Shed {
+  enum ProfileStage stage;
+  uint8_t period;  // 128 Hz frames (a power of 2, or 0)
+};
+
+static const struct Shed kShedOrder[LOAD_SHED_LEVEL_COUNT - 1] = {
+  { PROFILE_STAGE_SEND_PENDING_UART, 0 },
+  { PROFILE_STAGE_UPDATE_INDICATOR, 0 },
+  { PROFILE_STAGE_SEND_DATA_TO_NAV, 8 },
+};
+
+// The level is raised after SHED_AFTER_OVERRUNS consecutive overruns, and
+// lowered after RESTORE_AFTER_FRAMES consecutive frames that each leave at
+// least RESTORE_SLACK before the next tick.
+#define SHED_AFTER_OVERRUNS (4)
+#define RESTORE_AFTER_FRAMES (128)  // 1 s
+#define RESTORE_SLACK TASK_BUDGET_US(2000)
+
+// The buzzer is updated at 16 Hz, in the tick of each eight with this number.
+#define BUZZER_PHASE (3)
+
+#ifdef EVENT_TRIGGERED_FRAMES
+// The longest that a frame waits for SBus data after its tick, which leaves
+// enough of the frame for the tasks.
+#define SBUS_WAIT_LIMIT TASK_BUDGET_US(3000)
+#endif
+
+static volatile uint8_t frame_pending_ = 0;
+static uint16_t rate_step_ticks_ = 0;  // TIMER3 ticks between rate loop steps
+static uint8_t frame_ = 0;  // Number of frames run (modulo 256)
+static uint16_t over_budget_count_[PROFILE_STAGE_COUNT];
+static enum LoadShedLevel load_shed_level_ = LOAD_SHED_NONE;
+static uint16_t load_shed_count_ = 0;
+static volatile uint16_t rate_loop_max_ = 0;  // TIMER3 ticks
+static volatile uint16_t rate_loop_over_budget_count_ = 0;
+
+
+// =============================================================================
+// Private function declarations:
+
+static void CheckBudget(const struct Task * task, uint16_t duration);
+#ifdef EVENT_TRIGGERED_FRAMES
+static uint8_t FrameTriggered(uint16_t time);
+#endif
+static uint8_t TaskPeriod(const struct Task * task);
+static void UpdateLoadShedding(void);
+
+
+// =============================================================================
+// Accessors:
+
+uint16_t LoadShedCount(void)
+{
+  return load_shed_count_;
+}
+
+// -----------------------------------------------------------------------------
+enum LoadShedLevel LoadShedLevel(void)
+{
+  return load_shed_level_;
+}
+
+// -----------------------------------------------------------------------------
+uint16_t RateLoopMaxDuration(void)
+{
+  uint16_t duration;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { duration = rate_loop_max_; }
+  return duration;
+}
+
+// -----------------------------------------------------------------------------
+uint16_t RateLoopOverBudgetCount(void)
+{
+  uint16_t count;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { count = rate_loop_over_budget_count_; }
+  return count;
+}
+
+// -----------------------------------------------------------------------------
+uint16_t TaskOverBudgetCount(enum ProfileStage stage)
+{
+  return over_budget_count_[stage];
+}
+
+
+// =============================================================================
+// Public functions:
+
+void ResetSchedulerFrame(void)
+{
+  frame_pending_ = 0;
+}
+
+// -----------------------------------------------------------------------------
+void ResetTaskOverBudgetCounts(void)
+{
+  for (uint8_t i = 0; i < PROFILE_STAGE_COUNT; i++) over_budget_count_[i] = 0;
+  load_shed_count_ = 0;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    rate_loop_max_ = 0;
+    rate_loop_over_budget_count_ = 0;
+  }
+}
+
+// -----------------------------------------------------------------------------
+void StartRateLoop(void)
+{
+  rate_step_ticks_ = (ICR3 + 1) / RATE_LOOP_FACTOR;
+  OCR3A = 0;
+  TIFR3 = _BV(OCF3A);  // Clear a stale compare match
+  TIMSK3 |= _BV(OCIE3A);
+}
+
+// -----------------------------------------------------------------------------
+void StopRateLoop(void)
+{
+  // The rate loop also writes TIMSK3, but it cannot run in the middle of this.
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { TIMSK3 &= ~_BV(OCIE3A); }
+}
+
+// -----------------------------------------------------------------------------
+uint8_t RunScheduledTasks(void)
+{
+  if (!frame_pending_) return 0;
+
+  uint16_t time;
+  const uint8_t tick = FrameTimingNow(&time);
+#ifdef EVENT_TRIGGERED_FRAMES
+  // Waiting counts as busy, so that no background job delays the start.
+  if (!FrameTriggered(time)) return 1;
+#endif
+
+  const struct Task * previous = 0;
+  for (const struct Task * task = kTasks; task < &kTasks[N_TASKS]; task++)
+  {
+    const uint8_t period = TaskPeriod(task);
+    if (!period || ((frame_ & (period - 1)) != task->phase)) continue;
+    // The frame has overrun if the next tick has arrived.
+    if ((task->priority >= TASK_PRIORITY_LOW)
+      && (FrameTimingNow(&time) != tick)) continue;
+
+    CheckBudget(previous, FrameTimingMark(task->stage));
+    LoadMeterMark(task->module);
+    (*task->function)();
+    previous = task;
+  }
+  CheckBudget(previous, FrameTimingMark(PROFILE_STAGE_IDLE));
+  LoadMeterMark(LOAD_MODULE_IDLE);
+  UpdateLoadShedding();
+
+  frame_++;
+  frame_pending_ = 0;
+  return 1;
+}
+
+
+// =============================================================================
+// Private functions:
+
+static void CheckBudget(const struct Task * task, uint16_t duration)
+{
+  if (!task || (duration <= task->budget)) return;
+  if (over_budget_count_[task->stage] != 0xFFFF)
+    over_budget_count_[task->stage]++;
+  BudgetViolation(task->stage, duration, task->budget);
+}
+
+// -----------------------------------------------------------------------------
+#ifdef EVENT_TRIGGERED_FRAMES
+// This function returns 1 if the pending frame should start, which is when a
+// fresh SBus message has arrived (the ADC samples for the frame are complete at
+// its tick), or when the frame has waited "time" ticks since its tick for as
+// long as it can.
+static uint8_t FrameTriggered(uint16_t time)
+{
+  const uint8_t new_data = SBusNewData();
+  if (!new_data && (time < SBUS_WAIT_LIMIT)) return 0;
+  Trace(TRACE_EVENT_FRAME_START, new_data);
+  return 1;
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// This function returns the period of "task" at the current load shedding
+// level, or 0 if the task has been shed.
+static uint8_t TaskPeriod(const struct Task * task)
+{
+  for (uint8_t i = 0; i < load_shed_level_; i++)
+    if (kShedOrder[i].stage == task->stage) return kShedOrder[i].period;
+  return task->period;
+}
+
+// -----------------------------------------------------------------------------
+// This function raises or lowers the load shedding level according to the
+// slack of the frame that has just ended.
+static void UpdateLoadShedding(void)
+{
+  static uint8_t overruns = 0, quiet_frames = 0;
+
+  const uint16_t slack = FrameSlack();
+  if (!slack)
+  {
+    quiet_frames = 0;
+    if (++overruns < SHED_AFTER_OVERRUNS) return;
+    overruns = 0;
+    if (load_shed_level_ == LOAD_SHED_LEVEL_COUNT - 1) return;
+    load_shed_level_++;
+    if (load_shed_count_ != 0xFFFF) load_shed_count_++;
+  }
+  else
+  {
+    overruns = 0;
+    if (slack < RESTORE_SLACK)
+    {
+      quiet_frames = 0;
+      return;
+    }
+    if (++quiet_frames < RESTORE_AFTER_FRAMES) return;
+    quiet_frames = 0;
+    if (load_shed_level_ == LOAD_SHED_NONE) return;
+    load_shed_level_--;
+  }
+  Trace(TRACE_EVENT_LOAD_SHED, load_shed_level_);
+}
+
+// -----------------------------------------------------------------------------
+static void RequestTelemetry(void)
+{
+  RequestBackgroundJob(BACKGROUND_JOB_TELEMETRY);
+}
+
+// -----------------------------------------------------------------------------
+// This function is called upon the interrupt that occurs when TIMER3 reaches
+// the value in ICR3. This should occur at a rate of 128 Hz. The buzzer is
+// updated here rather than by a task so that it keeps sounding while the main
+// loop is blocked (for example by PreflightInit()), and the ADC acquisition is
+// kept phase locked to the frame (if ADC_PHASE_LOCKED is defined) in the same
+// way.
+ISR(TIMER3_CAPT_vect)
+{
+  ISR_PROFILE_ENTER(ISR_PROFILE_TIMER3_CAPT);
+
+  // The frame timing and the next ADC trigger depend on the time of the tick,
+  // so they are done first, with interrupts disabled. The buzzer is not time
+  // critical, so the other handlers (the ADC trigger and the SBus USART in
+  // particular) are allowed to run while it is updated, as they always were.
+  FrameTimingTick(!frame_pending_);
+  frame_pending_ = 1;
+  ADCFrameTick();
+
+  sei();
+
+  static uint8_t counter = 0;
+  if ((counter++ & 0x07) == BUZZER_PHASE) UpdateBuzzer();
+
+  ISR_PROFILE_EXIT(ISR_PROFILE_TIMER3_CAPT);
+}
+
+// -----------------------------------------------------------------------------
+// This function is called upon the interrupt that occurs when TIMER3 reaches
+// the value in OCR3A, which is moved on by a step each time so that the rate
+// loop runs RATE_LOOP_FACTOR times per frame, evenly spaced. The rate loop
+// preempts the main loop, but interrupts are re-enabled while it runs so that
+// the other handlers (and the motor I2C sequence that it starts) are not held
+// up. A step that comes due while the previous one is still running runs as
+// soon as that one has finished.
+ISR(TIMER3_COMPA_vect)
+{
+  ISR_PROFILE_ENTER(ISR_PROFILE_TIMER3_COMPA);
+
+  const uint16_t start = TCNT3;
+  const uint32_t interrupts = LoadMeterInterruptCycles();
+
+  static uint8_t step = 0;
+  step = (step + 1) & (RATE_LOOP_FACTOR - 1);
+  OCR3A = step * rate_step_ticks_;
+
+  TIMSK3 &= ~_BV(OCIE3A);
+  sei();
+  RateControl();
+  cli();
+  TIMSK3 |= _BV(OCIE3A);
+
+  // TIMER3 may have restarted while the rate loop ran.
+  const uint16_t now = TCNT3;
+  const uint16_t duration = now >= start ? now - start
+    : now + FRAME_TIMING_TICKS_PER_FRAME - start;
+  if (duration > rate_loop_max_) rate_loop_max_ = duration;
+  if ((duration > RATE_LOOP_BUDGET)
+    && (rate_loop_over_budget_count_ != 0xFFFF))
+  {
+    rate_loop_over_budget_count_++;
+  }
+  LoadMeterAddRateLoop(duration, LoadMeterInterruptCycles() - interrupts);
+
+  ISR_PROFILE_EXIT(ISR_PROFILE_TIMER3_COMPA);
+}
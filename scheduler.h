@@ -0,0 +1,122 @@
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+
+// This file declares the cooperative scheduler of the main loop. The TIMER3
+// interrupt only marks the start of each 128 Hz frame, and RunScheduledTasks()
+// then runs the tasks that are due in that frame from a static table (see
+// scheduler.c). The table gives each task a period in frames, a phase offset
+// within that period, a priority, and an execution budget. Tasks that run less
+// often than every frame are given different phases so that their cost is
+// spread across frames instead of landing in the same one.
+//
+// Tasks run in the order of the table, which follows the flow of data through
+// the frame. The priority decides what is given up when a frame overruns: once
+// the next tick has arrived, low priority tasks are skipped until their next
+// turn. A task that runs longer than its budget is counted (see
+// TaskOverBudgetCount()).
+//
+// When the firmware is built with EVENT_TRIGGERED_FRAMES defined, a frame does
+// not start at its tick, but once a fresh SBus message has also arrived (or
+// after a limited wait), so that the stick inputs reach Control() with less
+// delay. RunScheduledTasks() reports a frame that is waiting as busy.
+//
+// The rate loop is not a task. It preempts the main loop from a TIMER3 compare
+// interrupt RATE_LOOP_FACTOR times per frame (see StartRateLoop()).
+//
+// When frames keep overrunning, non-essential work is shed in a fixed order,
+// one level at a time, until the frames end on time again (see
+// enum LoadShedLevel). The work is restored, again one level at a time, once
+// the frames have had ample slack for a while. Each change of level is
+// recorded in the trace (see trace.h).
+
+#include <inttypes.h>
+
+#include "profile.h"
+
+
+enum TaskPriority {
+  TASK_PRIORITY_CRITICAL = 0,  // The flight-control path
+  TASK_PRIORITY_NORMAL,
+  TASK_PRIORITY_LOW,  // Skipped in a frame that has overrun
+};
+
+// The budget of each step of the rate loop, including the interrupts that it
+// lets in (see TIMER3_COMPA_vect in scheduler.c). This is an allowance of a
+// quarter of the 1953 us step, not a measured cost: "make profile" reports the
+// longest run of TIMER3_COMPA_vect on the simulator and fails (with -e) if it
+// exceeds this budget, and the budget should be set from that report.
+#define RATE_LOOP_BUDGET_US (500)
+
+// Each level also sheds the work of the levels below it.
+enum LoadShedLevel {
+  LOAD_SHED_NONE = 0,
+  LOAD_SHED_TELEMETRY,  // The MK and UT data streams are stopped
+  LOAD_SHED_INDICATOR,  // The LED I2C writes are stopped
+  LOAD_SHED_NAV_RATE,  // The data for the NaviCtrl is sent at 16 Hz
+  LOAD_SHED_LEVEL_COUNT,
+};
+
+
+// =============================================================================
+// Accessors:
+
+// This function returns the number of times that the load shedding level has
+// been raised since the last call to ResetTaskOverBudgetCounts().
+uint16_t LoadShedCount(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the current load shedding level.
+enum LoadShedLevel LoadShedLevel(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the longest step of the rate loop (in TIMER3 ticks)
+// since the last call to ResetTaskOverBudgetCounts().
+uint16_t RateLoopMaxDuration(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the number of steps of the rate loop that have run
+// longer than their budget (see RATE_LOOP_BUDGET in scheduler.c) since the
+// last call to ResetTaskOverBudgetCounts().
+uint16_t RateLoopOverBudgetCount(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the number of times that the task marked by "stage"
+// has run longer than its budget since the last call to
+// ResetTaskOverBudgetCounts().
+uint16_t TaskOverBudgetCount(enum ProfileStage stage);
+
+
+// =============================================================================
+// Public functions:
+
+// This function discards a pending frame, so that the time spent in a blocking
+// operation (such as PreflightInit()) is not counted as an overrun.
+void ResetSchedulerFrame(void);
+
+// -----------------------------------------------------------------------------
+// This function clears the over-budget counts (of the rate loop too), the
+// longest step of the rate loop, and the load shedding count.
+void ResetTaskOverBudgetCounts(void);
+
+// -----------------------------------------------------------------------------
+// This function starts the rate loop (see RateControl()), which runs from the
+// TIMER3 compare interrupt RATE_LOOP_FACTOR times per frame. It should be
+// called once the controller and the I2C devices have been initialized.
+void StartRateLoop(void);
+
+// -----------------------------------------------------------------------------
+// This function stops the rate loop, so that the main loop can drive the motors
+// on its own (see MotorTest()). The motor I2C sequence of the last step may
+// still be in progress, in which case TxMotorSetpoints() skips its turn.
+// StartRateLoop() restarts the rate loop.
+void StopRateLoop(void);
+
+// -----------------------------------------------------------------------------
+// This function runs the tasks that are due if a frame is pending and returns
+// 1, or returns 0 if there was nothing to do (see also EVENT_TRIGGERED_FRAMES
+// above).
+uint8_t RunScheduledTasks(void);
+
+
+#endif  // SCHEDULER_H_
@@ -0,0 +1,414 @@
+// This program runs the math benchmarks in benchmarks.c (firmware built with
+// SIM_BENCH defined) on a simulated ATmega1284P and reports the number of CPU
+// cycles taken by each routine as JSON. Each routine is timed between the
+// markers written to GPIOR1 (see benchmarks.h) for each of the input sets, and
+// the cost of the markers themselves is subtracted. The worst case over the
+// input sets is compared against the thresholds file, and the program exits
+// with a failure status if any routine got slower than its threshold. A
+// routine that has no threshold (such as a new routine that was not added to
+// the file) also fails the run, and so does a file without any entries, so a
+// run that checked nothing never passes. With -u, the thresholds file is
+// rewritten from the measured counts instead, along with the compiler and
+// simulator that measured them (-t, see BENCH_TOOLCHAIN in the makefile).
+//
+// Usage: UT_FlightCtrl_bench [-o results.json] [-T thresholds] [-t toolchain]
+//   [-u] elf
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sim_avr.h>
+#include <sim_elf.h>
+
+#include "benchmarks.h"
+
+
+// =============================================================================
+// Private data:
+
+#define DEFAULT_THRESHOLDS_PATH "sim/bench_thresholds.txt"
+#define MAX_SIMULATED_CYCLES (10UL * F_CPU)  // The benchmarks take < 1 s
+
+// Headroom given to the measured counts when the thresholds are rewritten.
+#define THRESHOLD_MARGIN (0.05)
+#define MIN_THRESHOLD_MARGIN_CYCLES (8)
+
+#define MAX_NAME_LENGTH (64)
+
+struct Statistic {
+  uint64_t count;
+  uint64_t total;
+  uint64_t min;
+  uint64_t max;
+};
+
+static const char * kBenchNames[BENCH_COUNT] = {
+  "(idle)",
+  "(overhead)",
+  "Vector3Add",
+  "Vector3AddToSelf",
+  "Vector3Copy",
+  "Vector3Cross",
+  "Vector3Dot",
+  "Vector3Norm",
+  "Vector3NormSquared",
+  "Vector3Scale",
+  "Vector3ScaleAndAccumulate",
+  "Vector3ScaleSelf",
+  "Vector3Subtract",
+  "Vector3SubtractFromSelf",
+  "VectorAdd",
+  "VectorAddToSelf",
+  "VectorCopy",
+  "VectorScale",
+  "VectorScaleSelf",
+  "VectorSubtract",
+  "VectorSubtractFromSelf",
+  "QuaternionInverse",
+  "QuaternionInvertSelf",
+  "QuaternionInverseMultiply",
+  "QuaternionMultiply",
+  "QuaternionMultiplyInverse",
+  "QuaternionNorm",
+  "QuaternionNormalize",
+  "QuaternionNormalizingFilter",
+  "QuaternionRotateVector",
+  "DirectForm2ZeroB0",
+  "FloatToS16",
+  "FloatToU16",
+  "FloatLimit",
+  "FloatSLimit",
+  "FloatMax",
+  "FloatMin",
+  "Q16ToFloat",
+  "S8Limit",
+  "S16Limit",
+  "S32Limit",
+  "U8Limit",
+  "U16Limit",
+  "U32Limit",
+  "S16RoundRShiftS16",
+  "S8RoundRShiftS16",
+  "S32RoundRShiftS32",
+  "S16RoundRShiftS32",
+  "U16RoundRShiftU16",
+  "U8RoundRShiftU16",
+  "U32RoundRShiftU32",
+  "U16RoundRShiftU32",
+  "S16ScaleToQ16",
+  "WrapToPlusMinusPi",
+  "UpdateQuaternion",
+  "UpdateGravityInBody",
+  "HeadingFromQuaternion",
+  "QuaternionFromGravityAndHeadingCommand",
+  "SensorSumToFloat",
+  "SensorSumToQ16",
+  "ProcessSensorReadings",
+};
+
+static enum BenchId bench_ = BENCH_IDLE;
+static avr_cycle_count_t bench_start_ = 0;
+static uint8_t done_ = 0;
+static struct Statistic stats_[BENCH_COUNT];
+
+// Thresholds (cycles) read from the file, or 0 if the routine is not listed.
+static uint64_t thresholds_[BENCH_COUNT];
+static unsigned n_thresholds_ = 0;
+
+// Description of the compiler and simulator that measured the counts.
+static const char * toolchain_ = "unknown toolchain";
+
+
+// =============================================================================
+// Private functions:
+
+static void AddSample(struct Statistic * statistic, uint64_t sample)
+{
+  if (!statistic->count || (sample < statistic->min)) statistic->min = sample;
+  if (sample > statistic->max) statistic->max = sample;
+  statistic->total += sample;
+  statistic->count++;
+}
+
+// -----------------------------------------------------------------------------
+// This function is called when the firmware writes a benchmark marker.
+static void BenchMarker(struct avr_t * avr, avr_io_addr_t addr, uint8_t v,
+  void * param)
+{
+  (void)param;
+  avr->data[addr] = v;
+
+  if (v == BENCH_DONE)
+  {
+    done_ = 1;
+  }
+  else if (v == BENCH_IDLE)
+  {
+    if (bench_ != BENCH_IDLE) AddSample(&stats_[bench_], avr->cycle
+      - bench_start_);
+    bench_ = BENCH_IDLE;
+  }
+  else if (v < BENCH_COUNT)
+  {
+    bench_ = (enum BenchId)v;
+    bench_start_ = avr->cycle;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// This function returns the number of the benchmark called "name", or
+// BENCH_IDLE if there is no such benchmark.
+static enum BenchId FindBench(const char * name)
+{
+  for (uint8_t i = BENCH_OVERHEAD + 1; i < BENCH_COUNT; i++)
+    if (!strcmp(name, kBenchNames[i])) return (enum BenchId)i;
+  return BENCH_IDLE;
+}
+
+// -----------------------------------------------------------------------------
+// This function reads lines of "name cycles" from the thresholds file. Blank
+// lines and lines starting with '#' are ignored. It returns 0 on success.
+static int ReadThresholds(const char * path)
+{
+  FILE * file = fopen(path, "r");
+  if (!file)
+  {
+    perror(path);
+    return 1;
+  }
+
+  char line[256];
+  unsigned line_number = 0;
+  while (fgets(line, sizeof(line), file))
+  {
+    line_number++;
+    char name[MAX_NAME_LENGTH];
+    unsigned long cycles;
+    if ((line[0] == '#') || (sscanf(line, "%63s", name) != 1)) continue;
+    if (sscanf(line, "%63s %lu", name, &cycles) != 2)
+    {
+      fprintf(stderr, "%s:%u: expected \"name cycles\"\n", path, line_number);
+      continue;
+    }
+    enum BenchId id = FindBench(name);
+    if (id == BENCH_IDLE)
+    {
+      fprintf(stderr, "%s:%u: unknown routine %s\n", path, line_number, name);
+      continue;
+    }
+    if (!thresholds_[id]) n_thresholds_++;
+    thresholds_[id] = cycles;
+  }
+
+  fclose(file);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+// This function rewrites the thresholds file from the measured worst cases
+// plus a margin. It returns 0 on success.
+static int WriteThresholds(const char * path, uint64_t overhead)
+{
+  FILE * file = fopen(path, "w");
+  if (!file)
+  {
+    perror(path);
+    return 1;
+  }
+
+  fprintf(file, "# Maximum CPU cycles for each routine benchmarked by "
+    "\"make bench\" (see\n# sim/bench.c). Regenerate with "
+    "\"make bench BENCH_ARGS=-u\" after an intended\n# change in cost. Each "
+    "threshold is the worst case over the input sets in\n# benchmarks.c "
+    "plus %.0f %% (at least %u cycles).\n# Measured with %s.\n",
+    THRESHOLD_MARGIN * 100.0, MIN_THRESHOLD_MARGIN_CYCLES, toolchain_);
+  for (uint8_t i = BENCH_OVERHEAD + 1; i < BENCH_COUNT; i++)
+  {
+    if (!stats_[i].count) continue;
+    uint64_t max = stats_[i].max - overhead;
+    uint64_t margin = (uint64_t)(max * THRESHOLD_MARGIN + 0.5);
+    if (margin < MIN_THRESHOLD_MARGIN_CYCLES)
+      margin = MIN_THRESHOLD_MARGIN_CYCLES;
+    fprintf(file, "%-40s %lu\n", kBenchNames[i], (unsigned long)(max
+      + margin));
+  }
+
+  fclose(file);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+// This function writes the results as JSON and returns the number of routines
+// that exceeded their thresholds.
+static unsigned WriteResults(FILE * file, const char * elf, uint64_t overhead)
+{
+  unsigned n_regressed = 0;
+
+  fprintf(file, "{\n");
+  fprintf(file, "  \"elf\": \"%s\",\n", elf);
+  fprintf(file, "  \"mcu\": \"atmega1284p\",\n");
+  fprintf(file, "  \"f_cpu\": %lu,\n", (unsigned long)F_CPU);
+  fprintf(file, "  \"toolchain\": \"%s\",\n", toolchain_);
+  fprintf(file, "  \"input_sets\": %u,\n", BENCH_N_INPUTS);
+  fprintf(file, "  \"marker_overhead\": %lu,\n", (unsigned long)overhead);
+  fprintf(file, "  \"benchmarks\": [");
+  const char * separator = "\n";
+  for (uint8_t i = BENCH_OVERHEAD + 1; i < BENCH_COUNT; i++)
+  {
+    const struct Statistic * s = &stats_[i];
+    if (!s->count) continue;
+    const uint64_t max = s->max - overhead;
+    const uint8_t regressed = thresholds_[i] && (max > thresholds_[i]);
+    n_regressed += regressed;
+
+    fprintf(file, "%s    { \"name\": \"%s\", \"min\": %lu, \"mean\": %.1f, "
+      "\"max\": %lu, ", separator, kBenchNames[i],
+      (unsigned long)(s->min - overhead),
+      (double)s->total / s->count - overhead, (unsigned long)max);
+    if (thresholds_[i])
+    {
+      fprintf(file, "\"threshold\": %lu, \"regressed\": %s }",
+        (unsigned long)thresholds_[i], regressed ? "true" : "false");
+    }
+    else
+    {
+      fprintf(file, "\"threshold\": null, \"regressed\": false }");
+    }
+    separator = ",\n";
+  }
+  fprintf(file, "\n  ]\n}\n");
+
+  return n_regressed;
+}
+
+
+// =============================================================================
+// Public functions:
+
+int main(int argc, char * argv[])
+{
+  const char * results_path = NULL;
+  const char * thresholds_path = DEFAULT_THRESHOLDS_PATH;
+  uint8_t update = 0;
+  int option;
+  while ((option = getopt(argc, argv, "o:T:t:u")) != -1)
+  {
+    switch (option)
+    {
+      case 'o': results_path = optarg; break;
+      case 'T': thresholds_path = optarg; break;
+      case 't': toolchain_ = optarg; break;
+      case 'u': update = 1; break;
+      default:
+        fprintf(stderr, "Usage: %s [-o results.json] [-T thresholds] "
+          "[-t toolchain] [-u] firmware.elf\n", argv[0]);
+        return 2;
+    }
+  }
+  if (optind >= argc)
+  {
+    fprintf(stderr, "%s: missing firmware.elf\n", argv[0]);
+    return 2;
+  }
+  const char * elf = argv[optind];
+
+  if (!update && ReadThresholds(thresholds_path)) return 2;
+
+  elf_firmware_t firmware;
+  memset(&firmware, 0, sizeof(firmware));
+  if (elf_read_firmware(elf, &firmware))
+  {
+    fprintf(stderr, "%s: unable to load %s\n", argv[0], elf);
+    return 2;
+  }
+
+  avr_t * avr = avr_make_mcu_by_name("atmega1284p");
+  if (!avr)
+  {
+    fprintf(stderr, "%s: simavr does not support atmega1284p\n", argv[0]);
+    return 2;
+  }
+  avr_init(avr);
+  avr->log = LOG_WARNING;
+  firmware.frequency = F_CPU;
+  avr_load_firmware(avr, &firmware);
+
+  avr_register_io_write(avr, BENCH_MARKER_ADDRESS, BenchMarker, NULL);
+
+  int state = cpu_Running;
+  while (!done_ && (avr->cycle < MAX_SIMULATED_CYCLES)
+    && (state != cpu_Done) && (state != cpu_Crashed))
+  {
+    state = avr_run(avr);
+  }
+  avr_terminate(avr);
+
+  if (!done_)
+  {
+    fprintf(stderr, "%s: benchmarks did not finish (was %s built with "
+      "SIM_BENCH?)\n", argv[0], elf);
+    return 2;
+  }
+
+  const uint64_t overhead = stats_[BENCH_OVERHEAD].min;
+  for (uint8_t i = BENCH_OVERHEAD + 1; i < BENCH_COUNT; i++)
+  {
+    if (stats_[i].count != BENCH_N_INPUTS)
+    {
+      fprintf(stderr, "%s: %s ran %lu times (expected %u)\n", argv[0],
+        kBenchNames[i], (unsigned long)stats_[i].count, BENCH_N_INPUTS);
+      return 2;
+    }
+  }
+
+  if (update) return WriteThresholds(thresholds_path, overhead) ? 2 : 0;
+
+  FILE * results = stdout;
+  if (results_path)
+  {
+    results = fopen(results_path, "w");
+    if (!results)
+    {
+      perror(results_path);
+      return 2;
+    }
+  }
+  unsigned n_regressed = WriteResults(results, elf, overhead);
+  if (results != stdout) fclose(results);
+
+  unsigned n_unchecked = 0;
+  for (uint8_t i = BENCH_OVERHEAD + 1; i < BENCH_COUNT; i++)
+  {
+    const uint64_t max = stats_[i].max - overhead;
+    if (!thresholds_[i])
+    {
+      if (n_thresholds_)
+      {
+        fprintf(stderr, "%s: no threshold in %s\n", kBenchNames[i],
+          thresholds_path);
+      }
+      n_unchecked++;
+    }
+    else if (max > thresholds_[i])
+    {
+      fprintf(stderr, "%s: %lu cycles exceeds the threshold of %lu\n",
+        kBenchNames[i], (unsigned long)max, (unsigned long)thresholds_[i]);
+    }
+  }
+  if (!n_thresholds_)
+  {
+    fprintf(stderr, "%s: FAILED: %s has no thresholds, so nothing was "
+      "checked. Generate it with \"make bench BENCH_ARGS=-u\" and commit "
+      "it.\n", argv[0], thresholds_path);
+  }
+  else if (n_unchecked)
+  {
+    fprintf(stderr, "%s: FAILED: %u of %u routines have no threshold. Add "
+      "them to %s (see -u).\n", argv[0], n_unchecked,
+      (unsigned)(BENCH_COUNT - BENCH_OVERHEAD - 1), thresholds_path);
+  }
+
+  return (n_regressed || n_unchecked) ? 1 : 0;
+}
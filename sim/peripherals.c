@@ -0,0 +1,265 @@
+#include "peripherals.h"
+
+#include <stddef.h>
+
+#include <avr_adc.h>
+#include <avr_eeprom.h>
+#include <avr_twi.h>
+#include <avr_uart.h>
+#include <sim_cycle_timers.h>
+#include <sim_io.h>
+#include <sim_irq.h>
+
+#include "adc.h"
+#include "airframe.h"
+#include "eeprom.h"
+#include "pilot.h"
+#include "sbus_frame.h"
+
+
+// =============================================================================
+// Private data:
+
+#define ADC_REFERENCE_MV (5000)
+#define ADC_MIDDLE_VALUE (1023 / 2)
+#define SBUS_FRAME_PERIOD_US (14000)
+#define SBUS_BYTE_PERIOD_US (120)  // 12 bits at 100 kbaud
+#define BLC_BASE_ADDRESS (0x52)
+
+// Physical ADC channels (the firmware's sample indices are offset by 2 because
+// of the free-running ADC pipeline, see adc.S).
+enum SimADCChannel {
+  SIM_ADC_GYRO_Z   = 0,
+  SIM_ADC_GYRO_X   = 1,
+  SIM_ADC_GYRO_Y   = 2,
+  SIM_ADC_PRESSURE = 3,
+  SIM_ADC_BATT_V   = 4,
+  SIM_ADC_ACCEL_Z  = 5,
+  SIM_ADC_ACCEL_X  = 6,
+  SIM_ADC_ACCEL_Y  = 7,
+};
+
+// Reply of a BLCtrl V2 (see struct BLCStatus in motors.c).
+static const uint8_t kBLCStatus[9] = {
+  0,  // current
+  250,  // status_code (BLC_STATUS_V2_READY)
+  30,  // temperature
+  0,  // speed
+  0,  // extra
+  126,  // voltage
+  0,  // i2c_errors
+  2,  // version_major
+  0,  // version_minor
+};
+
+static const char * kBLCIRQNames[2] = { "8<blc.in", "8>blc.out" };
+
+static avr_t * avr_ = NULL;
+static avr_irq_t * blc_irq_ = NULL;
+static uint8_t n_motors_ = 0;
+static uint8_t blc_selected_ = 0, blc_index_ = 0;
+static uint8_t blc_rx_[MAX_MOTORS][2];
+static uint16_t blc_setpoint_[MAX_MOTORS];
+static uint8_t sbus_frame_[SBUS_FRAME_LENGTH], sbus_byte_ = 0;
+static uint32_t sbus_frames_ = 0;
+
+
+// =============================================================================
+// Private function declarations:
+
+static void BLCHook(struct avr_irq_t * irq, uint32_t value, void * param);
+static void ConfigureEEPROM(void);
+static uint32_t ADCMillivolts(uint16_t adc_value);
+static avr_cycle_count_t SBusByteTimer(struct avr_t * avr,
+  avr_cycle_count_t when, void * param);
+static avr_cycle_count_t SBusFrameTimer(struct avr_t * avr,
+  avr_cycle_count_t when, void * param);
+
+
+// =============================================================================
+// Accessors:
+
+uint16_t SimMotorSetpoint(uint8_t i)
+{
+  return blc_setpoint_[i];
+}
+
+// -----------------------------------------------------------------------------
+uint32_t SimSBusFrames(void)
+{
+  return sbus_frames_;
+}
+
+
+// =============================================================================
+// Public functions:
+
+void SimPeripheralsInit(avr_t * avr, uint8_t n_motors)
+{
+  avr_ = avr;
+  ConfigureEEPROM();
+  if (n_motors) n_motors_ = n_motors > MAX_MOTORS ? MAX_MOTORS : n_motors;
+
+  // Analog inputs (AREF is connected to 5 V on the FlightCtrl).
+  avr->aref = ADC_REFERENCE_MV;
+  avr->avcc = ADC_REFERENCE_MV;
+  const uint32_t kMiddle = ADCMillivolts(ADC_MIDDLE_VALUE);
+  const struct { uint8_t channel; uint32_t mv; } kInputs[] = {
+    { SIM_ADC_GYRO_Z, kMiddle },
+    { SIM_ADC_GYRO_X, kMiddle },
+    { SIM_ADC_GYRO_Y, kMiddle },
+    { SIM_ADC_PRESSURE, ADCMillivolts(3 * 1024 / 4) },
+    { SIM_ADC_BATT_V, ADCMillivolts(390) },  // ~12.6 V
+    { SIM_ADC_ACCEL_Z, kMiddle },
+    { SIM_ADC_ACCEL_X, kMiddle },
+    { SIM_ADC_ACCEL_Y, kMiddle },
+  };
+  for (size_t i = 0; i < sizeof(kInputs) / sizeof(kInputs[0]); i++)
+  {
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ,
+      ADC_IRQ_ADC0 + kInputs[i].channel), kInputs[i].mv);
+  }
+
+  // Keep the MK telemetry on USART0 from being echoed to stdout.
+  uint32_t flags = 0;
+  avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+  flags &= ~AVR_UART_FLAG_STDIO;
+  avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+
+  // SBus receiver on USART1.
+  avr_cycle_timer_register_usec(avr, SBUS_FRAME_PERIOD_US, SBusFrameTimer,
+    NULL);
+
+  // BLCtrls on the I2C bus.
+  blc_irq_ = avr_alloc_irq(&avr->irq_pool, 0, 2, kBLCIRQNames);
+  avr_irq_register_notify(blc_irq_ + TWI_IRQ_OUTPUT, BLCHook, NULL);
+  avr_connect_irq(blc_irq_ + TWI_IRQ_INPUT,
+    avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT));
+  avr_connect_irq(avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT),
+    blc_irq_ + TWI_IRQ_OUTPUT);
+}
+
+
+// =============================================================================
+// Private functions:
+
+// This function converts an ADC reading to the corresponding input voltage.
+static uint32_t ADCMillivolts(uint16_t adc_value)
+{
+  return ((uint32_t)adc_value * ADC_REFERENCE_MV + 512) / 1024;
+}
+
+// -----------------------------------------------------------------------------
+// This function writes the settings that would normally have been stored in the
+// EEPROM of a configured board: the airframe, sensor offsets matching the
+// analog inputs above, and a pressure sensor bias in the middle of its range.
+// The layout of struct EEPROM is the same on the host because all of its
+// members are naturally aligned.
+static void ConfigureEEPROM(void)
+{
+  struct EEPROM image;
+  avr_eeprom_desc_t desc = {
+    .ee = (uint8_t *)&image,
+    .offset = 0,
+    .size = sizeof(image),
+  };
+  avr_ioctl(avr_, AVR_IOCTL_EEPROM_GET, &desc);  // Copies into image
+
+  image.n_motors = AirframeActuationInverse(image.actuation_inverse);
+  n_motors_ = image.n_motors;
+  image.acc_offset[X_BODY_AXIS] = -ADC_MIDDLE_VALUE * ADC_N_SAMPLES;
+  image.acc_offset[Y_BODY_AXIS] = -ADC_MIDDLE_VALUE * ADC_N_SAMPLES;
+  image.acc_offset[Z_BODY_AXIS] = -ADC_MIDDLE_VALUE * ADC_N_SAMPLES
+    + ACCELEROMETER_2_2_SCALE * ADC_N_SAMPLES;
+  image.gyro_offset[X_BODY_AXIS] = -ADC_MIDDLE_VALUE * ADC_N_SAMPLES;
+  image.gyro_offset[Y_BODY_AXIS] = -ADC_MIDDLE_VALUE * ADC_N_SAMPLES;
+  image.gyro_offset[Z_BODY_AXIS] = ADC_MIDDLE_VALUE * ADC_N_SAMPLES;
+  image.pressure_bias = 128;
+
+  avr_ioctl(avr_, AVR_IOCTL_EEPROM_SET, &desc);
+}
+
+// -----------------------------------------------------------------------------
+// This function starts the transmission of the next SBus frame.
+static avr_cycle_count_t SBusFrameTimer(struct avr_t * avr,
+  avr_cycle_count_t when, void * param)
+{
+  (void)param;
+
+  int16_t channels[SBUS_FRAME_N_CHANNELS];
+  uint8_t binary;
+  PilotSticks((uint32_t)(when * 1000 / avr->frequency), channels, &binary);
+  SBusEncodeFrame(channels, binary, sbus_frame_);
+  sbus_byte_ = 0;
+  sbus_frames_++;
+  avr_cycle_timer_register(avr, 1, SBusByteTimer, NULL);
+
+  return when + avr_usec_to_cycles(avr, SBUS_FRAME_PERIOD_US);
+}
+
+// -----------------------------------------------------------------------------
+// This function sends one byte of the current SBus frame to USART1.
+static avr_cycle_count_t SBusByteTimer(struct avr_t * avr,
+  avr_cycle_count_t when, void * param)
+{
+  (void)param;
+
+  avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('1'),
+    UART_IRQ_INPUT), sbus_frame_[sbus_byte_++]);
+  if (sbus_byte_ >= SBUS_FRAME_LENGTH) return 0;
+
+  return when + avr_usec_to_cycles(avr, SBUS_BYTE_PERIOD_US);
+}
+
+// -----------------------------------------------------------------------------
+// This function responds to I2C traffic addressed to the BLCtrls. Writes are
+// recorded as motor setpoints and reads return a fixed status message.
+static void BLCHook(struct avr_irq_t * irq, uint32_t value, void * param)
+{
+  (void)irq;
+  (void)param;
+
+  avr_twi_msg_irq_t v;
+  v.u.v = value;
+
+  if (v.u.twi.msg & TWI_COND_STOP) blc_selected_ = 0;
+
+  if (v.u.twi.msg & TWI_COND_START)
+  {
+    blc_selected_ = 0;
+    blc_index_ = 0;
+    uint8_t address = v.u.twi.addr & 0xFE;
+    if ((address >= BLC_BASE_ADDRESS)
+      && (address < BLC_BASE_ADDRESS + 2 * n_motors_))
+    {
+      blc_selected_ = v.u.twi.addr;
+      avr_raise_irq(blc_irq_ + TWI_IRQ_INPUT,
+        avr_twi_irq_msg(TWI_COND_ACK, blc_selected_, 1));
+    }
+  }
+
+  if (!blc_selected_) return;
+  uint8_t motor = ((blc_selected_ & 0xFE) - BLC_BASE_ADDRESS) >> 1;
+
+  if (v.u.twi.msg & TWI_COND_WRITE)
+  {
+    avr_raise_irq(blc_irq_ + TWI_IRQ_INPUT,
+      avr_twi_irq_msg(TWI_COND_ACK, blc_selected_, 1));
+    if (blc_index_ < 2) blc_rx_[motor][blc_index_] = v.u.twi.data;
+    blc_index_++;
+    // Setpoints are either 8-bit or 11-bit (bits 11 to 3, then 2 to 0).
+    if (blc_index_ == 1)
+      blc_setpoint_[motor] = blc_rx_[motor][0];
+    else if (blc_index_ == 2)
+      blc_setpoint_[motor] = ((uint16_t)blc_rx_[motor][0] << 3)
+        | (blc_rx_[motor][1] & 0x07);
+  }
+
+  if (v.u.twi.msg & TWI_COND_READ)
+  {
+    uint8_t data = kBLCStatus[blc_index_ % sizeof(kBLCStatus)];
+    avr_raise_irq(blc_irq_ + TWI_IRQ_INPUT,
+      avr_twi_irq_msg(TWI_COND_READ, blc_selected_, data));
+    blc_index_++;
+  }
+}
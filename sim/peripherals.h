@@ -0,0 +1,38 @@
+// This file declares scripted stand-ins for the hardware attached to the
+// ATmega1284P on the FlightCtrl board, for use with simavr. They provide:
+//   - constant analog inputs for a level, motionless vehicle,
+//   - SBus frames from the scripted pilot (see host/pilot.c) on USART1,
+//   - BLCtrl motor controllers on the I2C bus, and
+//   - an EEPROM image configured for the airframe selected at build time.
+
+#ifndef SIM_PERIPHERALS_H_
+#define SIM_PERIPHERALS_H_
+
+
+#include <inttypes.h>
+
+#include <sim_avr.h>
+
+
+// =============================================================================
+// Accessors:
+
+// This function returns the last setpoint received by BLCtrl "i".
+uint16_t SimMotorSetpoint(uint8_t i);
+
+// -----------------------------------------------------------------------------
+// This function returns the number of SBus frames sent.
+uint32_t SimSBusFrames(void);
+
+
+// =============================================================================
+// Public functions:
+
+// This function attaches all of the stand-ins to "avr". It must be called after
+// the firmware has been loaded (so that the EEPROM image can be modified).
+// "n_motors" BLCtrls will respond on the I2C bus (0 selects the number of
+// motors of the airframe).
+void SimPeripheralsInit(avr_t * avr, uint8_t n_motors);
+
+
+#endif  // SIM_PERIPHERALS_H_
@@ -0,0 +1,412 @@
+// This program runs the firmware (built with SIM_PROFILE defined) on a
+// simulated ATmega1284P and reports the number of CPU cycles spent in each
+// stage of the 128 Hz main loop and in each interrupt handler. Stages are
+// identified by the markers written to GPIOR0 (see profile.h). Interrupt
+// handlers are timed from vector entry to reti, excluding time spent in nested
+// handlers. Stage times include interrupts that occurred during the stage; the
+// interrupt share is reported separately.
+//
+// The firmware is also built with BUDGET_CHECK defined, so each run of a task
+// over its execution budget is written to GPIOR2 along with its inputs (see
+// budget_check.h). The longest run of the rate loop (TIMER3_COMPA_vect, less
+// the handlers nested in it) is also checked against RATE_LOOP_BUDGET_US (see
+// scheduler.h). The violations are reported, and with -e the program exits
+// with a failure status if there were any.
+//
+// Usage: UT_FlightCtrl_profile [-w warmup_s] [-t duration_s] [-m n_motors] [-e]
+//   elf
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <sim_interrupts.h>
+#include <sim_io.h>
+#include <sim_irq.h>
+#include <sim_cycle_timers.h>
+
+#include "budget_check.h"
+#include "frame_timing.h"
+#include "main.h"
+#include "peripherals.h"
+#include "pilot.h"
+#include "profile.h"
+#include "scheduler.h"
+
+
+// =============================================================================
+// Private data:
+
+#define FRAME_BUDGET_CYCLES (F_CPU / 128)  // 156,250
+#define N_VECTORS (35)
+#define MAX_ISR_NESTING (8)
+#define DEFAULT_WARMUP_S (PILOT_FLYING_MS / 1000 + 2)
+#define DEFAULT_DURATION_S (10)
+#define MAX_PRINTED_VIOLATIONS (10)
+#define TIMER3_COMPA_VECTOR (32)  // The rate loop
+
+struct Statistic {
+  uint64_t count;
+  uint64_t total;
+  uint64_t min;
+  uint64_t max;
+};
+
+static const char * kStageNames[PROFILE_STAGE_COUNT] = {
+  "(idle)",
+  "UpdateSBus",
+  "UpdateState",
+  "ProcessSensorReadings",
+  "UpdateAttitude",
+  "UpdatePressureAltitude",
+  "UpdateVerticalSpeed",
+  "Control",
+  "ErrorCheck",
+  "ProcessIncomingUART",
+  "SendPendingUART",
+  "SendDataToNav",
+  "UpdateIndicator",
+};
+
+static const char * kVectorNames[N_VECTORS] = {
+  "RESET", "INT0", "INT1", "INT2", "PCINT0", "PCINT1", "PCINT2", "PCINT3",
+  "WDT", "TIMER2_COMPA", "TIMER2_COMPB", "TIMER2_OVF", "TIMER1_CAPT",
+  "TIMER1_COMPA", "TIMER1_COMPB", "TIMER1_OVF", "TIMER0_COMPA",
+  "TIMER0_COMPB", "TIMER0_OVF", "SPI_STC", "USART0_RX", "USART0_UDRE",
+  "USART0_TX", "ANALOG_COMP", "ADC", "EE_READY", "TWI", "SPM_READY",
+  "USART1_RX", "USART1_UDRE", "USART1_TX", "TIMER3_CAPT", "TIMER3_COMPA",
+  "TIMER3_COMPB", "TIMER3_OVF",
+};
+
+static avr_t * avr_ = NULL;
+static uint8_t measuring_ = 0;
+
+// Main loop stage tracking.
+static enum ProfileStage stage_ = PROFILE_STAGE_IDLE;
+static avr_cycle_count_t stage_start_ = 0, frame_start_ = 0;
+static uint64_t stage_isr_start_ = 0, frame_isr_start_ = 0;
+static struct Statistic stage_stats_[PROFILE_STAGE_COUNT];
+static uint64_t stage_isr_cycles_[PROFILE_STAGE_COUNT];
+static struct Statistic frame_stats_;
+static uint64_t frame_isr_cycles_ = 0;
+
+// Interrupt handler tracking.
+static struct IsrFrame {
+  uint8_t vector;
+  avr_cycle_count_t entry;
+  uint64_t nested;
+} isr_stack_[MAX_ISR_NESTING];
+static uint8_t isr_depth_ = 0;
+static uint64_t isr_cycles_ = 0;  // Total in outermost handlers
+static struct Statistic isr_stats_[N_VECTORS];
+
+// Budget violations.
+static union {
+  struct BudgetViolationRecord record;
+  uint8_t bytes[sizeof(struct BudgetViolationRecord)];
+} violation_;
+static uint8_t violation_length_ = 0;  // Bytes of violation_ received
+static uint64_t violation_count_[PROFILE_STAGE_COUNT];
+static struct BudgetViolationRecord printed_violations_[MAX_PRINTED_VIOLATIONS];
+static uint8_t n_printed_violations_ = 0;
+
+
+// =============================================================================
+// Private functions:
+
+static void AddSample(struct Statistic * statistic, uint64_t sample)
+{
+  if (!statistic->count || (sample < statistic->min)) statistic->min = sample;
+  if (sample > statistic->max) statistic->max = sample;
+  statistic->total += sample;
+  statistic->count++;
+}
+
+// -----------------------------------------------------------------------------
+static double Mean(const struct Statistic * statistic)
+{
+  return statistic->count ? (double)statistic->total / statistic->count : 0.0;
+}
+
+// -----------------------------------------------------------------------------
+// This function is called when the firmware writes a stage marker.
+static void StageMarker(struct avr_t * avr, avr_io_addr_t addr, uint8_t v,
+  void * param)
+{
+  (void)param;
+  avr->data[addr] = v;
+  if (v >= PROFILE_STAGE_COUNT) return;
+
+  const avr_cycle_count_t now = avr->cycle;
+  if (measuring_ && (stage_ != PROFILE_STAGE_IDLE))
+  {
+    AddSample(&stage_stats_[stage_], now - stage_start_);
+    stage_isr_cycles_[stage_] += isr_cycles_ - stage_isr_start_;
+  }
+
+  // A frame runs from the first task after idle to the return to idle.
+  if ((v != PROFILE_STAGE_IDLE) && (stage_ == PROFILE_STAGE_IDLE))
+  {
+    frame_start_ = now;
+    frame_isr_start_ = isr_cycles_;
+  }
+  else if ((v == PROFILE_STAGE_IDLE) && (stage_ != PROFILE_STAGE_IDLE)
+    && measuring_)
+  {
+    AddSample(&frame_stats_, now - frame_start_);
+    frame_isr_cycles_ += isr_cycles_ - frame_isr_start_;
+  }
+
+  stage_ = (enum ProfileStage)v;
+  stage_start_ = now;
+  stage_isr_start_ = isr_cycles_;
+}
+
+// -----------------------------------------------------------------------------
+// This function is called when the firmware writes a byte of a budget
+// violation record.
+static void BudgetViolationMarker(struct avr_t * avr, avr_io_addr_t addr,
+  uint8_t v, void * param)
+{
+  (void)param;
+  avr->data[addr] = v;
+  violation_.bytes[violation_length_++] = v;
+  if (violation_length_ < sizeof(violation_.bytes)) return;
+  violation_length_ = 0;
+
+  const struct BudgetViolationRecord * record = &violation_.record;
+  if (!measuring_ || (record->stage >= PROFILE_STAGE_COUNT)) return;
+  violation_count_[record->stage]++;
+  if (n_printed_violations_ < MAX_PRINTED_VIOLATIONS)
+    printed_violations_[n_printed_violations_++] = *record;
+}
+
+// -----------------------------------------------------------------------------
+// This function is called when an interrupt handler is entered (value = 1) or
+// returns (value = 0).
+static void VectorRunning(struct avr_irq_t * irq, uint32_t value, void * param)
+{
+  (void)irq;
+  const uint8_t vector = (uint8_t)(uintptr_t)param;
+  const avr_cycle_count_t now = avr_->cycle;
+
+  if (value)
+  {
+    if (isr_depth_ < MAX_ISR_NESTING)
+    {
+      isr_stack_[isr_depth_].vector = vector;
+      isr_stack_[isr_depth_].entry = now;
+      isr_stack_[isr_depth_].nested = 0;
+    }
+    isr_depth_++;
+    return;
+  }
+
+  if (!isr_depth_) return;  // Profiling started inside of a handler
+  isr_depth_--;
+  if (isr_depth_ >= MAX_ISR_NESTING) return;
+
+  struct IsrFrame * frame = &isr_stack_[isr_depth_];
+  const uint64_t inclusive = now - frame->entry;
+  if (measuring_) AddSample(&isr_stats_[frame->vector], inclusive
+    - frame->nested);
+  if (isr_depth_) isr_stack_[isr_depth_ - 1].nested += inclusive;
+  else isr_cycles_ += inclusive;
+}
+
+// -----------------------------------------------------------------------------
+static avr_cycle_count_t StartMeasuring(struct avr_t * avr,
+  avr_cycle_count_t when, void * param)
+{
+  (void)avr;
+  (void)when;
+  (void)param;
+  measuring_ = 1;
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+// This function prints the budget violations and returns their number.
+static uint64_t PrintViolations(void)
+{
+  uint64_t total = 0;
+  for (uint8_t i = 0; i < PROFILE_STAGE_COUNT; i++)
+    total += violation_count_[i];
+  printf("\nBudget violations: %lu\n", (unsigned long)total);
+  if (!total) return 0;
+
+  for (uint8_t i = 1; i < PROFILE_STAGE_COUNT; i++)
+  {
+    if (!violation_count_[i]) continue;
+    printf("%-24s %7lu\n", kStageNames[i], (unsigned long)violation_count_[i]);
+  }
+
+  printf("\n%-24s %5s %9s %9s %5s %4s %4s %4s %4s %4s %4s %4s\n", "First",
+    "frame", "cycles", "budget", "state", "ctrl", "nav", "navs", "sbus",
+    "shed", "adc", "cmpl");
+  for (uint8_t i = 0; i < n_printed_violations_; i++)
+  {
+    const struct BudgetViolationRecord * r = &printed_violations_[i];
+    printf("%-24s %5u %9lu %9lu  0x%02X %4u 0x%02X 0x%02X 0x%02X %4u %4u "
+      "%4u\n", kStageNames[r->stage], r->frame,
+      (unsigned long)r->duration * FRAME_TIMING_CYCLES_PER_TICK,
+      (unsigned long)r->budget * FRAME_TIMING_CYCLES_PER_TICK,
+      r->state, r->control_mode, r->nav_mode, r->nav_status,
+      r->sbus_error_bits, r->load_shed_level, r->adc_state,
+      r->completion_overflow_count);
+  }
+  return total;
+}
+
+// -----------------------------------------------------------------------------
+// This function prints the longest run of the rate loop against its budget and
+// returns 1 if it was over the budget (or did not run), or 0 otherwise.
+static int CheckRateLoop(void)
+{
+  const struct Statistic * s = &isr_stats_[TIMER3_COMPA_VECTOR];
+  const uint64_t kBudget = (uint64_t)RATE_LOOP_BUDGET_US * (F_CPU / 1000000);
+  if (!s->count)
+  {
+    printf("\nRate loop: did not run\n");
+    return 1;
+  }
+  printf("\nRate loop: %lu cycles (%.0f us) at most, budget %lu cycles "
+    "(%u us)\n", (unsigned long)s->max, s->max * 1e6 / F_CPU,
+    (unsigned long)kBudget, RATE_LOOP_BUDGET_US);
+  return s->max > kBudget;
+}
+
+// -----------------------------------------------------------------------------
+static void PrintReport(const char * elf, double duration)
+{
+  const double kCycles = duration * F_CPU;
+
+  printf("Profile of %s over %.1f s (%.0f MHz, frame budget %lu cycles)\n\n",
+    elf, duration, F_CPU / 1e6, (unsigned long)FRAME_BUDGET_CYCLES);
+
+  printf("%-24s %7s %9s %9s %9s %9s %8s\n", "Stage", "count", "mean", "min",
+    "max", "ISR mean", "% budget");
+  for (uint8_t i = 1; i < PROFILE_STAGE_COUNT; i++)
+  {
+    const struct Statistic * s = &stage_stats_[i];
+    if (!s->count) continue;
+    printf("%-24s %7lu %9.0f %9lu %9lu %9.0f %8.2f\n", kStageNames[i],
+      (unsigned long)s->count, Mean(s), (unsigned long)s->min,
+      (unsigned long)s->max, (double)stage_isr_cycles_[i] / s->count,
+      100.0 * Mean(s) / FRAME_BUDGET_CYCLES);
+  }
+  if (frame_stats_.count)
+  {
+    printf("%-24s %7lu %9.0f %9lu %9lu %9.0f %8.2f\n", "Frame total",
+      (unsigned long)frame_stats_.count, Mean(&frame_stats_),
+      (unsigned long)frame_stats_.min, (unsigned long)frame_stats_.max,
+      (double)frame_isr_cycles_ / frame_stats_.count,
+      100.0 * Mean(&frame_stats_) / FRAME_BUDGET_CYCLES);
+  }
+
+  printf("\n%-24s %7s %9s %9s %9s %9s %8s\n", "Interrupt", "count", "mean",
+    "min", "max", "per s", "% CPU");
+  for (uint8_t i = 1; i < N_VECTORS; i++)
+  {
+    const struct Statistic * s = &isr_stats_[i];
+    if (!s->count) continue;
+    printf("%-24s %7lu %9.1f %9lu %9lu %9.0f %8.2f\n", kVectorNames[i],
+      (unsigned long)s->count, Mean(s), (unsigned long)s->min,
+      (unsigned long)s->max, s->count / duration, 100.0 * s->total / kCycles);
+  }
+
+  printf("\nSBus frames: %lu, motor setpoints:", (unsigned long)SimSBusFrames());
+  for (uint8_t i = 0; i < MAX_MOTORS; i++) printf(" %u", SimMotorSetpoint(i));
+  printf("\n");
+}
+
+
+// =============================================================================
+// Public functions:
+
+int main(int argc, char * argv[])
+{
+  double warmup = DEFAULT_WARMUP_S, duration = DEFAULT_DURATION_S;
+  int n_motors = 0;  // Number of motors of the airframe
+  int enforce_budgets = 0;
+  int option;
+  while ((option = getopt(argc, argv, "w:t:m:e")) != -1)
+  {
+    switch (option)
+    {
+      case 'w': warmup = atof(optarg); break;
+      case 't': duration = atof(optarg); break;
+      case 'm': n_motors = atoi(optarg); break;
+      case 'e': enforce_budgets = 1; break;
+      default:
+        fprintf(stderr, "Usage: %s [-w warmup_s] [-t duration_s] "
+          "[-m n_motors] [-e] firmware.elf\n", argv[0]);
+        return 1;
+    }
+  }
+  if (optind >= argc)
+  {
+    fprintf(stderr, "%s: missing firmware.elf\n", argv[0]);
+    return 1;
+  }
+  const char * elf = argv[optind];
+
+  elf_firmware_t firmware;
+  memset(&firmware, 0, sizeof(firmware));
+  if (elf_read_firmware(elf, &firmware))
+  {
+    fprintf(stderr, "%s: unable to load %s\n", argv[0], elf);
+    return 1;
+  }
+
+  avr_ = avr_make_mcu_by_name("atmega1284p");
+  if (!avr_)
+  {
+    fprintf(stderr, "%s: simavr does not support atmega1284p\n", argv[0]);
+    return 1;
+  }
+  avr_init(avr_);
+  avr_->log = LOG_WARNING;
+  firmware.frequency = F_CPU;
+  avr_load_firmware(avr_, &firmware);
+
+  SimPeripheralsInit(avr_, (uint8_t)n_motors);
+
+  avr_register_io_write(avr_, PROFILE_MARKER_ADDRESS, StageMarker, NULL);
+  avr_register_io_write(avr_, BUDGET_CHECK_MARKER_ADDRESS,
+    BudgetViolationMarker, NULL);
+  for (uint8_t i = 1; i < N_VECTORS; i++)
+  {
+    avr_irq_t * irq = avr_get_interrupt_irq(avr_, i);
+    if (irq)
+    {
+      avr_irq_register_notify(irq + AVR_INT_IRQ_RUNNING, VectorRunning,
+        (void *)(uintptr_t)i);
+    }
+  }
+  avr_cycle_timer_register_usec(avr_, (uint32_t)(warmup * 1e6),
+    StartMeasuring, NULL);
+
+  const avr_cycle_count_t end = (avr_cycle_count_t)((warmup + duration)
+    * F_CPU);
+  int state = cpu_Running;
+  while ((avr_->cycle < end) && (state != cpu_Done) && (state != cpu_Crashed))
+    state = avr_run(avr_);
+
+  if (state == cpu_Crashed)
+  {
+    fprintf(stderr, "%s: firmware crashed at cycle %lu\n", argv[0],
+      (unsigned long)avr_->cycle);
+    return 1;
+  }
+
+  PrintReport(elf, duration);
+  uint64_t violations = PrintViolations();
+  violations += CheckRateLoop();
+  avr_terminate(avr_);
+
+  return enforce_budgets && violations ? 1 : 0;
+}
@@ -4,6 +4,7 @@
 #include <avr/io.h>
 
 #include "adc.h"
+#include "isr_profile.h"
 #include "mcu_pins.h"
 #include "timing.h"
 
@@ -17,6 +18,7 @@ static const uint8_t * volatile tx_ptr_ = 0;
 
 static uint8_t tx_buffer_[SPI_TX_BUFFER_LENGTH], tx_overflow_counter_ = 0;
 static SPICallback callback_ptr_ = 0;
+static uint8_t rx_length_ = 0;  // Of the transfer in progress
 static volatile uint8_t temp = 0;
 
 // =============================================================================
@@ -71,6 +73,7 @@ void SPIExchangeThenCallback(uint8_t tx_length, volatile uint8_t * rx_buffer,
   rx_bytes_remaining_ = rx_buffer_length;
 
   callback_ptr_ = callback_ptr;
+  rx_length_ = rx_buffer_length;
 
   if (tx_length != 0)
   {
@@ -134,10 +137,12 @@ static inline void SPITxByte(uint8_t byte)
 // -----------------------------------------------------------------------------
 // Transmission (byte) complete interrupt. Note, this is a very high frequency
 // interrupt (around 150kHz), so SPI transmission should be avoided until after
-// high-priority processing is finished. Also, make sure that any callback is
-// very brief.
+// high-priority processing is finished. The callback is only queued here, and
+// runs later from the main loop.
 ISR(SPI_STC_vect)
 {
+  ISR_PROFILE_ENTER(ISR_PROFILE_SPI_STC);
+
   DeselectSlave();
 
   if (rx_bytes_remaining_ != 0)
@@ -165,6 +170,8 @@ ISR(SPI_STC_vect)
   else
   {
     SPCR &= ~_BV(SPIE);  // Disable this interrupt
-    if (callback_ptr_) (*callback_ptr_)();
+    if (callback_ptr_) PostCompletion(callback_ptr_, rx_length_);
   }
+
+  ISR_PROFILE_EXIT(ISR_PROFILE_SPI_STC);
 }
@@ -4,10 +4,14 @@
 
 #include <inttypes.h>
 
+#include "completion.h"
+
 
 #define SPI_TX_BUFFER_LENGTH (150)
 
-typedef void (*SPICallback)(void);
+// The callback of a transfer is run from the main loop once the transfer has
+// finished (see completion.h), with the number of bytes received as argument.
+typedef CompletionHandler SPICallback;
 
 
 // =============================================================================
@@ -12,15 +12,24 @@
 #define F_ICR1 1000
 #define F_ICR3 128
 
-// The following is not declared static so that it will be visible to timing.S.
+#define TIMER1_TICKS_PER_MS (F_CPU / TIMER1_DIVIDER / F_ICR1)
+// TIMER1 ticks are converted to us by multiplying by this and shifting right by
+// 18 bits, which is cheaper than a division and is exact to within 1 us.
+#define MICROS_PER_TICK_Q18 \
+  ((uint16_t)((1UL << 18) * TIMER1_DIVIDER / (F_CPU / 1000000UL)))
+
+// The following are not declared static so that they will be visible to
+// timing.S. Together they form a 32-bit ms count.
 volatile uint16_t ms_timestamp_ = 0;
+volatile uint16_t ms_timestamp_high_ = 0;
 
 
 // =============================================================================
 // Public functions:
 
 // This function initializes TIMER1 and TIMER3. These timers trigger interrupts
-// at 1 kHz and 128 Hz respectively. TIMER1 also updates a 16-bit ms timestamp.
+// at 1 kHz and 128 Hz respectively. TIMER1 also updates a 32-bit ms count, of
+// which the lower 16 bits are the ms timestamp.
 void TimingInit(void)
 {
   // Waveform generation mode bits:
@@ -129,6 +138,58 @@ uint16_t MillisSinceTimestamp(uint16_t t)
   return ms_timestamp - t;
 }
 
+// -----------------------------------------------------------------------------
+// This function returns the time since TimingInit() in us, from the ms count
+// and TIMER1 (which counts CPU cycles). The result wraps around every 71.6
+// minutes, so it should only be used to measure intervals (see the functions
+// below). It takes about 100 cycles and may be called from an interrupt.
+uint32_t GetMicros(void)
+{
+  uint16_t ms_low, ms_high, ticks;
+  uint8_t tick_pending;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    ticks = TCNT1;
+    tick_pending = TIFR1 & _BV(ICF1);
+    ms_low = ms_timestamp_;
+    ms_high = ms_timestamp_high_;
+  }
+  uint32_t ms = ((uint32_t)ms_high << 16) | ms_low;
+  // TIMER1 may have wrapped around while interrupts were disabled, in which
+  // case the ms count is one behind. If TCNT1 was read before the wrap, it
+  // is still near the top.
+  if (tick_pending && (ticks < TIMER1_TICKS_PER_MS / 2)) ms++;
+  return ms * 1000
+    + (uint16_t)(((uint32_t)ticks * MICROS_PER_TICK_Q18) >> 18);
+}
+
+// -----------------------------------------------------------------------------
+// This function returns a time corresponding to "t" us in the future, which can
+// be checked with MicrosInPast() as a deadline. This function works for
+// durations up to 2^31 - 1 us (about 35 minutes).
+uint32_t GetMicrosFromNow(uint32_t t)
+{
+  return GetMicros() + t;
+}
+
+// -----------------------------------------------------------------------------
+// This function compares time "t" (from GetMicros()) to the current time and
+// returns TRUE if it is in the past. This function works for durations up to
+// 2^31 - 1 us (about 35 minutes).
+uint8_t MicrosInPast(uint32_t t)
+{
+  return (int32_t)(t - GetMicros()) < 0;
+}
+
+// -----------------------------------------------------------------------------
+// This function returns the number of us that have elapsed since time "t" (from
+// GetMicros()). This function works for time periods up to 2^32 - 1 us (about
+// 71 minutes).
+uint32_t MicrosSince(uint32_t t)
+{
+  return GetMicros() - t;
+}
+
 // -----------------------------------------------------------------------------
 // This function delays execution of the program for "t" ms. Functions triggered
 // by interrupts will still execute during this period. This function works for
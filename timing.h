@@ -9,7 +9,8 @@
 // Public functions:
 
 // This function initializes TIMER1 and TIMER3. These timers trigger interrupts
-// at 1 kHz and 128 Hz respectively. TIMER1 also updates a 16-bit ms timestamp.
+// at 1 kHz and 128 Hz respectively. TIMER1 also updates a 32-bit ms count, of
+// which the lower 16 bits are the ms timestamp.
 void TimingInit(void);
 
 // -----------------------------------------------------------------------------
@@ -33,6 +34,31 @@ uint8_t TimestampInPast(uint16_t t);
 // has occurred. This function works for time periods up to 65535 ms.
 uint16_t MillisSinceTimestamp(uint16_t t);
 
+// -----------------------------------------------------------------------------
+// This function returns the time since TimingInit() in us, from the ms count
+// and TIMER1 (which counts CPU cycles). The result wraps around every 71.6
+// minutes, so it should only be used to measure intervals (see the functions
+// below). It takes about 100 cycles and may be called from an interrupt.
+uint32_t GetMicros(void);
+
+// -----------------------------------------------------------------------------
+// This function returns a time corresponding to "t" us in the future, which can
+// be checked with MicrosInPast() as a deadline. This function works for
+// durations up to 2^31 - 1 us (about 35 minutes).
+uint32_t GetMicrosFromNow(uint32_t t);
+
+// -----------------------------------------------------------------------------
+// This function compares time "t" (from GetMicros()) to the current time and
+// returns TRUE if it is in the past. This function works for durations up to
+// 2^31 - 1 us (about 35 minutes).
+uint8_t MicrosInPast(uint32_t t);
+
+// -----------------------------------------------------------------------------
+// This function returns the number of us that have elapsed since time "t" (from
+// GetMicros()). This function works for time periods up to 2^32 - 1 us (about
+// 71 minutes).
+uint32_t MicrosSince(uint32_t t);
+
 // -----------------------------------------------------------------------------
 // This function delays execution of the program for "t" ms. Functions triggered
 // by interrupts will still execute during this period. This function works for
@@ -0,0 +1,105 @@
+#include "trace.h"
+
+#include <util/atomic.h>
+
+#include "frame_timing.h"
+
+
+// =============================================================================
+// Private data:
+
+static struct TraceRecord records_[TRACE_N_RECORDS];
+static volatile uint8_t head_ = 0, count_ = 0;
+static volatile uint8_t recording_ = 1, armed_ = 1, triggered_ = 0;
+static volatile uint8_t post_trigger_remaining_ = 0;
+static volatile uint16_t event_mask_ = TRACE_DEFAULT_EVENT_MASK;
+
+
+// =============================================================================
+// Accessors:
+
+uint8_t TraceCount(void)
+{
+  return count_;
+}
+
+// -----------------------------------------------------------------------------
+uint16_t TraceEventMask(void)
+{
+  return event_mask_;
+}
+
+// -----------------------------------------------------------------------------
+struct TraceRecord TraceRecord(uint8_t i)
+{
+  return records_[(uint8_t)(head_ - count_ + i) % TRACE_N_RECORDS];
+}
+
+// -----------------------------------------------------------------------------
+uint8_t TraceTriggered(void)
+{
+  return triggered_;
+}
+
+
+// =============================================================================
+// Public functions:
+
+void Trace(enum TraceEvent event, uint16_t payload)
+{
+  if (!recording_ || !(event_mask_ & TRACE_EVENT_BIT(event))) return;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    uint16_t time;
+    struct TraceRecord * record = &records_[head_];
+    record->event = event;
+    record->frame = FrameTimingNow(&time);
+    record->time = time;
+    record->payload = payload;
+    head_ = (head_ + 1) % TRACE_N_RECORDS;
+    if (count_ < TRACE_N_RECORDS) count_++;
+
+    if (post_trigger_remaining_)
+    {
+      if (--post_trigger_remaining_ == 0)
+      {
+        recording_ = 0;
+        triggered_ = 1;
+      }
+    }
+    else if (armed_ && (event == TRACE_EVENT_OVERRUN))
+    {
+      // Keep the half of the buffer before the overrun and fill the other half.
+      armed_ = 0;
+      post_trigger_remaining_ = TRACE_N_RECORDS / 2;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+void TraceResume(void)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    post_trigger_remaining_ = 0;
+    triggered_ = 0;
+    armed_ = 1;
+    recording_ = 1;
+  }
+}
+
+// -----------------------------------------------------------------------------
+void TraceSetEventMask(uint16_t mask)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    event_mask_ = mask | TRACE_EVENT_BIT(TRACE_EVENT_OVERRUN);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void TraceStop(void)
+{
+  recording_ = 0;
+}
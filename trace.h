@@ -0,0 +1,95 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+
+// This file declares an in-RAM trace of events that are useful for finding
+// stalls in the processing pipeline, such as an I2C transaction that is still
+// running when the next frame starts. Each record holds the event, the time
+// (the 128 Hz frame number and the TIMER3 ticks into that frame, see
+// FrameTimingNow()), and a 16-bit payload whose meaning depends on the event.
+// The most recent TRACE_N_RECORDS records are kept.
+//
+// An overrun triggers the trace: recording continues for another half of the
+// buffer and then stops, so the records around the overrun are kept until they
+// have been read out (see SendPendingUTSerial()). The host decodes them into a
+// timeline with host/trace_main.c.
+//
+// Only the events in the event mask are recorded (see TraceSetEventMask()).
+// The I2C events are left out by default because the motor sequences alone
+// would otherwise fill the buffer in about 60 ms and push out everything else.
+// Overruns are always recorded, since they trigger the trace.
+
+#include <inttypes.h>
+
+
+#define TRACE_N_RECORDS_POWER_OF_2 (6)
+#define TRACE_N_RECORDS (1 << TRACE_N_RECORDS_POWER_OF_2)  // 64
+
+enum TraceEvent {
+  TRACE_EVENT_NONE = 0,
+  TRACE_EVENT_I2C_START,  // Payload: slave address
+  TRACE_EVENT_I2C_FINISH,  // Payload: slave address << 8 | enum I2CError
+  TRACE_EVENT_UART_RX,  // Payload: enum UARTRxMode of the finished message
+  TRACE_EVENT_SBUS_FRAME,  // Payload: ms timestamp of the first byte
+  TRACE_EVENT_NAV_DATA,  // Payload: version of the data
+  TRACE_EVENT_OVERRUN,  // Payload: TIMER3 ticks from the tick to frame end
+  TRACE_EVENT_LOAD_SHED,  // Payload: new enum LoadShedLevel
+  TRACE_EVENT_FRAME_START,  // Payload: 1 if started by SBus, 0 if by timeout
+};
+
+#define TRACE_EVENT_BIT(event) (1U << (event))
+#define TRACE_DEFAULT_EVENT_MASK (0xFFFF & ~(TRACE_EVENT_BIT(TRACE_EVENT_NONE) \
+  | TRACE_EVENT_BIT(TRACE_EVENT_I2C_START) \
+  | TRACE_EVENT_BIT(TRACE_EVENT_I2C_FINISH)))
+
+struct TraceRecord {
+  uint8_t event;  // enum TraceEvent
+  uint8_t frame;  // Number of the 128 Hz tick (modulo 256)
+  uint16_t time;  // TIMER3 ticks since the 128 Hz tick
+  uint16_t payload;
+} __attribute__((packed));
+
+
+// =============================================================================
+// Accessors:
+
+// This function returns the number of records held (up to TRACE_N_RECORDS).
+uint8_t TraceCount(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the mask of the events that are recorded (bit n set for
+// enum TraceEvent n, see TRACE_EVENT_BIT()).
+uint16_t TraceEventMask(void);
+
+// -----------------------------------------------------------------------------
+// This function returns the i-th oldest record. It should only be called while
+// recording is stopped (see TraceStop()).
+struct TraceRecord TraceRecord(uint8_t i);
+
+// -----------------------------------------------------------------------------
+// This function returns 1 if recording was stopped by an overrun.
+uint8_t TraceTriggered(void);
+
+
+// =============================================================================
+// Public functions:
+
+// This function records an event. It may be called from an interrupt handler.
+void Trace(enum TraceEvent event, uint16_t payload);
+
+// -----------------------------------------------------------------------------
+// This function resumes recording after TraceStop() or a trigger, and re-arms
+// the trigger.
+void TraceResume(void);
+
+// -----------------------------------------------------------------------------
+// This function sets the mask of the events that are recorded (see
+// TRACE_EVENT_BIT()). TRACE_EVENT_OVERRUN is always added to the mask.
+void TraceSetEventMask(uint16_t mask);
+
+// -----------------------------------------------------------------------------
+// This function stops recording so that the records can be read out.
+void TraceStop(void);
+
+
+#endif  // TRACE_H_
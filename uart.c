@@ -43,12 +43,15 @@
 #include <avr/interrupt.h>
 #include <avr/io.h>
 
+#include "isr_profile.h"
 #include "mcu_pins.h"
 #include "mk_serial_protocol.h"
 #include "mk_serial_tx.h"
 #include "state.h"
 #include "timing.h"
+#include "trace.h"
 #include "ut_serial_protocol.h"
+#include "ut_serial_tx.h"
 
 
 // =============================================================================
@@ -110,6 +113,7 @@ void ProcessIncomingUART(void)
     rx_buffer_tail = (rx_buffer_tail + 1) % UART_RX_BUFFER_LENGTH;
 
     // Add other Rx protocols here.
+    const enum UARTRxMode mode_pv = mode;
     switch (mode)
     {
       case UART_RX_MODE_UT_ONGOING:
@@ -124,6 +128,8 @@ void ProcessIncomingUART(void)
         else if (rx_buffer_[rx_buffer_tail] == MK_START_CHARACTER)
           mode = UART_RX_MODE_MK_ONGOING;
     }
+    if ((mode == UART_RX_MODE_IDLE) && (mode_pv != UART_RX_MODE_IDLE))
+      Trace(TRACE_EVENT_UART_RX, mode_pv);
   }
 }
 
@@ -146,6 +152,7 @@ void SendPendingUART(void)
 {
   // Add other Tx protocols here.
   SendPendingMKSerial();
+  SendPendingUTSerial();
 }
 
 // -----------------------------------------------------------------------------
@@ -247,6 +254,8 @@ static void Printf(const char *format, va_list arglist)
 // indicating that the transmitter is ready to load another byte.
 ISR(USART0_UDRE_vect)
 {
+  ISR_PROFILE_ENTER(ISR_PROFILE_USART0_UDRE);
+
   if (tx_bytes_remaining_)
   {
     UDR0 = *(tx_ptr_++);
@@ -256,11 +265,15 @@ ISR(USART0_UDRE_vect)
   {
     UCSR0B &= ~_BV(UDRIE0);  // Disable this interrupt
   }
+
+  ISR_PROFILE_EXIT(ISR_PROFILE_USART0_UDRE);
 }
 
 // -----------------------------------------------------------------------------
 ISR(USART0_RX_vect)
 {
+  ISR_PROFILE_ENTER(ISR_PROFILE_USART0_RX);
   rx_buffer_head_ = (rx_buffer_head_ + 1) % UART_RX_BUFFER_LENGTH;
   rx_buffer_[rx_buffer_head_] = UDR0;
+  ISR_PROFILE_EXIT(ISR_PROFILE_USART0_RX);
 }
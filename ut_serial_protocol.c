@@ -64,13 +64,14 @@ enum UARTRxMode UTSerialRx(uint8_t byte, uint8_t * data_buffer)
 // This function encodes data into a message using the UTokyo protocol. The
 // message must contain at least a destination address and a label. If no
 // additional data is necessary, then the source pointer and length can both be
-// set to zero.
-void UTSerialTx(uint8_t id, const uint8_t * source, uint8_t length)
+// set to zero. The return value is 1 if the message was queued and 0 if the
+// UART Tx buffer was not available.
+uint8_t UTSerialTx(uint8_t id, const uint8_t * source, uint8_t length)
 {
-  if ((length + 1 + UT_HEADER_LENGTH + 2) > UART_TX_BUFFER_LENGTH) return;
+  if ((length + 1 + UT_HEADER_LENGTH + 2) > UART_TX_BUFFER_LENGTH) return 0;
 
   uint8_t * tx_buffer = RequestUARTTxBuffer();
-  if (!tx_buffer) return;
+  if (!tx_buffer) return 0;
   uint8_t * tx_ptr = tx_buffer;
 
   // Copy the start character to the TX buffer;
@@ -97,4 +98,5 @@ void UTSerialTx(uint8_t id, const uint8_t * source, uint8_t length)
   *tx_ptr = crc.bytes[1];
 
   UARTTxBuffer(length + UT_HEADER_LENGTH + 2);
+  return 1;
 }
@@ -12,7 +12,9 @@
 
 enum UTSerialID {
   UT_SERIAL_ID_BEEP_PATTERN = 0,
-  UT_SERIAL_ID_NAV
+  UT_SERIAL_ID_NAV,
+  UT_SERIAL_ID_TRACE,
+  UT_SERIAL_ID_TRACE_MASK,
 };
 
 
@@ -29,8 +31,9 @@ enum UARTRxMode UTSerialRx(uint8_t byte, uint8_t * data_buffer);
 // This function encodes data into a message using the UTokyo protocol. The
 // message must contain at least a destination address and a label. If no
 // additional data is necessary, then the source pointer and length can both be
-// set to zero.
-void UTSerialTx(uint8_t id, const uint8_t * source, uint8_t length);
+// set to zero. The return value is 1 if the message was queued and 0 if the
+// UART Tx buffer was not available.
+uint8_t UTSerialTx(uint8_t id, const uint8_t * source, uint8_t length);
 
 
 #endif  // UT_SERIAL_PROTOCOL_H_
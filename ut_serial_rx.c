@@ -2,6 +2,8 @@
 
 #include "buzzer.h"
 #include "nav_comms.h"
+#include "trace.h"
+#include "ut_serial_tx.h"
 #include "ut_serial_protocol.h"
 
 
@@ -20,6 +22,12 @@ void HandleUTRx(uint8_t id, const uint8_t * data_buffer)
     case UT_SERIAL_ID_NAV:
       ProcessDataFromNav(data_buffer);
       break;
+    case UT_SERIAL_ID_TRACE:
+      SetUTTxRequest(UT_TX_TRACE);
+      break;
+    case UT_SERIAL_ID_TRACE_MASK:
+      TraceSetEventMask(((uint16_t *)data_buffer)[0]);
+      break;
     default:
       break;
   }
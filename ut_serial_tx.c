@@ -4,13 +4,36 @@
 #include "nav_comms.h"
 #include "pressure_altitude.h"
 #include "timing.h"
+#include "trace.h"
 #include "ut_serial_protocol.h"
 #include "vertical_speed.h"
 
 
+// =============================================================================
+// Private data:
+
+static uint8_t tx_request_ = 0x00;
+
+// Index of the next trace record to send while the trace is being read out.
+static uint8_t trace_index_ = 0, trace_readout_ = 0;
+
+
+// =============================================================================
+// Private function declarations:
+
+static void SendTrace(void);
+
+
 // =============================================================================
 // Public functions:
 
+// This function sends data that has been requested.
+void SendPendingUTSerial(void)
+{
+  if (tx_request_ & UT_TX_TRACE) SendTrace();
+}
+
+// -----------------------------------------------------------------------------
 void SendVerticalData(void)
 {
   struct VerticalData {
@@ -37,3 +60,63 @@ void SendVerticalData(void)
 
   UTSerialTx(1, (uint8_t *)&vertical_data, sizeof(vertical_data));
 }
+
+// -----------------------------------------------------------------------------
+// This function sets a one-time request for data.
+void SetUTTxRequest(enum UTTxBits tx_request)
+{
+  tx_request_ |= tx_request;
+}
+
+
+// =============================================================================
+// Private functions:
+
+// This function sends the next part of the trace (see trace.h), oldest records
+// first. Recording is stopped until every record has been sent, which takes a
+// few frames.
+static void SendTrace(void)
+{
+  enum { TRACE_RECORDS_PER_MESSAGE = 30 };
+
+  struct TraceData {
+    uint8_t first;  // Index of records[0] in the trace
+    uint8_t count;  // Number of records in the trace
+    uint8_t triggered;  // Recording was stopped by an overrun
+    struct TraceRecord records[TRACE_RECORDS_PER_MESSAGE];
+  } __attribute__((packed)) trace_data;
+
+  _Static_assert(UT_HEADER_LENGTH + sizeof(struct TraceData) + 2
+    < UART_TX_BUFFER_LENGTH,
+    "TraceData is too large for the UART TX buffer");
+
+  if (!trace_readout_)
+  {
+    TraceStop();
+    trace_index_ = 0;
+    trace_readout_ = 1;
+  }
+
+  const uint8_t count = TraceCount();
+  uint8_t n_records = count - trace_index_;
+  if (n_records > TRACE_RECORDS_PER_MESSAGE)
+    n_records = TRACE_RECORDS_PER_MESSAGE;
+
+  trace_data.first = trace_index_;
+  trace_data.count = count;
+  trace_data.triggered = TraceTriggered();
+  for (uint8_t i = 0; i < n_records; i++)
+    trace_data.records[i] = TraceRecord(trace_index_ + i);
+
+  // Try again next time if the UART is busy.
+  if (!UTSerialTx(UT_SERIAL_ID_TRACE, (uint8_t *)&trace_data,
+    sizeof(trace_data) - sizeof(trace_data.records)
+    + n_records * sizeof(struct TraceRecord))) return;
+
+  trace_index_ += n_records;
+  if (trace_index_ < count) return;
+
+  tx_request_ &= ~UT_TX_TRACE;
+  trace_readout_ = 0;
+  TraceResume();
+}
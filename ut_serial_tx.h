@@ -5,10 +5,23 @@
 #include <inttypes.h>
 
 
+enum UTTxBits {
+  UT_TX_TRACE = 1<<0,
+};
+
+
 // =============================================================================
 // Public functions:
 
+// This function sends data that has been requested.
+void SendPendingUTSerial(void);
+
+// -----------------------------------------------------------------------------
 void SendVerticalData(void);
 
+// -----------------------------------------------------------------------------
+// This function sets a one-time request for data.
+void SetUTTxRequest(enum UTTxBits tx_request);
+
 
 #endif  // UT_SERIAL_TX_H_